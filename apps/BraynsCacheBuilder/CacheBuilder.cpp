@@ -0,0 +1,485 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CacheBuilder.h"
+
+#include <brayns/common/log.h>
+#include <brayns/common/geometry/Bricking.h>
+#include <brayns/common/scene/Scene.h>
+#include <brayns/io/MorphologyLoader.h>
+#include <brayns/io/SceneCache.h>
+
+#include <servus/uri.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+const std::string PARAM_SHARDS = "shards";
+const std::string PARAM_SAVE_MORPHOLOGY_STORE = "save-morphology-store";
+const std::string PARAM_EXTRACT_SIMULATION_CACHE = "extract-simulation-cache";
+const size_t DEFAULT_NB_SHARDS = 4;
+}
+
+namespace brayns
+{
+
+namespace
+{
+/** Scene holding the primitives created by the loaders, without any
+ *  rendering engine */
+class CacheBuilderScene : public Scene
+{
+public:
+    CacheBuilderScene(
+        SceneParameters& sceneParameters,
+        GeometryParameters& geometryParameters )
+        : Scene( Renderers(), sceneParameters, geometryParameters )
+    {
+    }
+
+    void commit() final {}
+    void buildGeometry() final {}
+    void commitLights() final {}
+    void commitMaterials( const bool ) final {}
+    void commitSimulationData() final {}
+    void commitTransferFunctionData() final {}
+    void commitLevelsOfDetail( const Camera& ) final {}
+
+protected:
+    void _buildGeometryBatch( GeometryBatch& ) final {}
+    void _removeGeometryBatch( GeometryBatch& ) final {}
+};
+
+void _closePipes( std::vector< int >& fds )
+{
+    for( int& fd: fds )
+    {
+        if( fd != -1 )
+            ::close( fd );
+        fd = -1;
+    }
+}
+
+bool _readSimulationOffset( const int fd, size_t& simulationOffset )
+{
+    return ::read( fd, &simulationOffset, sizeof( simulationOffset )) ==
+           ssize_t( sizeof( simulationOffset ));
+}
+
+bool _writeSimulationOffset( const int fd, const size_t simulationOffset )
+{
+    return ::write( fd, &simulationOffset, sizeof( simulationOffset )) ==
+           ssize_t( sizeof( simulationOffset ));
+}
+
+template< typename T >
+void _appendPrimitives( const SceneCacheSection& section,
+                        std::vector< T >& primitives )
+{
+    const T* begin = reinterpret_cast< const T* >( section.data );
+    primitives.insert( primitives.end(), begin,
+                       begin + section.size / sizeof( T ));
+}
+}
+
+CacheBuilderParameters::CacheBuilderParameters()
+    : AbstractParameters( "Cache builder" )
+    , _shards( DEFAULT_NB_SHARDS )
+{
+    _parameters.add_options()
+        ( PARAM_SHARDS.c_str(), po::value< size_t >(),
+            "Number of worker processes loading the circuit target" )
+        ( PARAM_SAVE_MORPHOLOGY_STORE.c_str(), po::value< std::string >(),
+            "Convert the morphologies of the circuit target to a binary "
+            "morphology store" )
+        ( PARAM_EXTRACT_SIMULATION_CACHE.c_str(), po::value< std::string >(),
+            "Extract the frames between the start and end simulation times "
+            "and the cells of the circuit target from the simulation cache "
+            "file to a new simulation cache file" );
+}
+
+bool CacheBuilderParameters::_parse( const po::variables_map& vm )
+{
+    if( vm.count( PARAM_SHARDS ))
+        _shards = std::max( size_t( 1 ), vm[PARAM_SHARDS].as< size_t >( ));
+    if( vm.count( PARAM_SAVE_MORPHOLOGY_STORE ))
+        _saveMorphologyStore =
+            vm[PARAM_SAVE_MORPHOLOGY_STORE].as< std::string >( );
+    if( vm.count( PARAM_EXTRACT_SIMULATION_CACHE ))
+        _extractSimulationCache =
+            vm[PARAM_EXTRACT_SIMULATION_CACHE].as< std::string >( );
+    return true;
+}
+
+void CacheBuilderParameters::print( )
+{
+    AbstractParameters::print( );
+    BRAYNS_INFO << "Shards                     : " << _shards << std::endl;
+    BRAYNS_INFO << "Save morphology store      : " << _saveMorphologyStore
+                << std::endl;
+    BRAYNS_INFO << "Extract simulation cache   : " << _extractSimulationCache
+                << std::endl;
+}
+
+CacheBuilder::CacheBuilder( int argc, const char **argv )
+{
+    _parametersManager.registerParameters( &_cacheBuilderParameters );
+    _parametersManager.parse( argc, argv );
+
+    // Instances are not saved to cache files
+    GeometryParameters& geometryParameters =
+        _parametersManager.getGeometryParameters();
+    if( geometryParameters.getMorphologyInstancing( ))
+    {
+        BRAYNS_WARN << "Morphology instancing is ignored by the cache builder"
+                    << std::endl;
+        _parametersManager.set( "morphology-instancing", "false" );
+    }
+    _parametersManager.print( );
+}
+
+bool CacheBuilder::build()
+{
+    const GeometryParameters& geometryParameters =
+        _parametersManager.getGeometryParameters();
+    const std::string& morphologyStore =
+        _cacheBuilderParameters.getSaveMorphologyStore();
+    const std::string& simulationCache =
+        _cacheBuilderParameters.getExtractSimulationCache();
+    const bool buildCache = !geometryParameters.getSaveCacheFile().empty();
+    if( !buildCache && morphologyStore.empty() && simulationCache.empty( ))
+    {
+        BRAYNS_ERROR << "A cache file, a morphology store or a simulation "
+                     << "cache to save is required" << std::endl;
+        return false;
+    }
+
+    if( ( buildCache || !morphologyStore.empty( )) &&
+        geometryParameters.getCircuitConfiguration().empty( ))
+    {
+        BRAYNS_ERROR << "A circuit configuration is required" << std::endl;
+        return false;
+    }
+
+    if( !simulationCache.empty() &&
+        geometryParameters.getSimulationCacheFile().empty( ))
+    {
+        BRAYNS_ERROR << "A simulation cache file to extract from is required"
+                     << std::endl;
+        return false;
+    }
+
+    if( !geometryParameters.getReport().empty( ))
+    {
+        BRAYNS_ERROR << "Compartment reports are not supported by the cache "
+                     << "builder" << std::endl;
+        return false;
+    }
+
+    // The morphology store is converted first, so that the workers building
+    // the cache file read it instead of the morphology files
+    if( !morphologyStore.empty( ))
+    {
+        if( !_convertMorphologies( ))
+            return false;
+        if( buildCache )
+            _parametersManager.set( "morphology-store", morphologyStore );
+    }
+
+    if( buildCache && !_buildCache( ))
+        return false;
+
+    return simulationCache.empty() || _extractSimulationCache();
+}
+
+bool CacheBuilder::_buildCache()
+{
+    // The simulation offsets of the cells of a shard follow the cells of the
+    // preceding shards. Every worker receives the offset following the
+    // preceding shards from the previous worker once its own cells are
+    // loaded, and passes the offset following its shard to the next worker
+    const size_t nbShards = _cacheBuilderParameters.getShards();
+    std::vector< int > simulationOffsetPipes( 2 * nbShards, -1 );
+    for( size_t shard = 1; shard < nbShards; ++shard )
+    {
+        if( ::pipe( &simulationOffsetPipes[2 * shard] ) == -1 )
+        {
+            BRAYNS_ERROR << "Failed to create pipe for shard " << shard
+                         << std::endl;
+            _closePipes( simulationOffsetPipes );
+            return false;
+        }
+    }
+
+    // Workers are forked before any thread is created, and every worker then
+    // loads its shard with all threads of the node
+    std::vector< pid_t > workers;
+    for( size_t shard = 0; shard < nbShards; ++shard )
+    {
+        const pid_t pid = ::fork();
+        if( pid == 0 )
+        {
+            const int input = simulationOffsetPipes[2 * shard];
+            const int output = shard + 1 < nbShards ?
+                simulationOffsetPipes[2 * ( shard + 1 ) + 1] : -1;
+            for( const int fd: simulationOffsetPipes )
+                if( fd != input && fd != output && fd != -1 )
+                    ::close( fd );
+            ::_exit( _buildShard( shard, nbShards, input, output ) ? 0 : 1 );
+        }
+        if( pid == -1 )
+        {
+            BRAYNS_ERROR << "Failed to start worker for shard " << shard
+                         << std::endl;
+            break;
+        }
+        workers.push_back( pid );
+    }
+    _closePipes( simulationOffsetPipes );
+
+    bool success = workers.size() == nbShards;
+    for( size_t shard = 0; shard < workers.size(); ++shard )
+    {
+        int status = 0;
+        if( ::waitpid( workers[shard], &status, 0 ) == -1 ||
+            !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+        {
+            BRAYNS_ERROR << "Worker of shard " << shard << " failed"
+                         << std::endl;
+            success = false;
+        }
+    }
+
+    if( success )
+        success = _mergeShards( nbShards );
+
+    for( size_t shard = 0; shard < nbShards; ++shard )
+        std::remove( _getShardFilename( shard ).c_str( ));
+    return success;
+}
+
+bool CacheBuilder::_convertMorphologies()
+{
+    // The conversion runs in its own process, so that the shard workers are
+    // still forked from a process without any thread
+    const pid_t pid = ::fork();
+    if( pid == 0 )
+    {
+        const GeometryParameters& geometryParameters =
+            _parametersManager.getGeometryParameters();
+        MorphologyLoader morphologyLoader( geometryParameters );
+        ::_exit( morphologyLoader.saveMorphologyStore(
+            servus::URI( geometryParameters.getCircuitConfiguration( )),
+            geometryParameters.getTarget(),
+            _cacheBuilderParameters.getSaveMorphologyStore( )) ? 0 : 1 );
+    }
+
+    int status = 0;
+    if( pid == -1 || ::waitpid( pid, &status, 0 ) == -1 ||
+        !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+    {
+        BRAYNS_ERROR << "Failed to convert morphologies" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CacheBuilder::_extractSimulationCache()
+{
+    const GeometryParameters& geometryParameters =
+        _parametersManager.getGeometryParameters();
+    MorphologyLoader morphologyLoader( geometryParameters );
+    if( !morphologyLoader.saveSimulationSubset(
+            servus::URI( geometryParameters.getCircuitConfiguration( )),
+            geometryParameters.getTarget(),
+            _cacheBuilderParameters.getExtractSimulationCache( )))
+    {
+        BRAYNS_ERROR << "Failed to extract simulation cache" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CacheBuilder::_buildShard(
+    const size_t shard,
+    const size_t nbShards,
+    const int simulationOffsetInput,
+    const int simulationOffsetOutput )
+{
+    GeometryParameters& geometryParameters =
+        _parametersManager.getGeometryParameters();
+    CacheBuilderScene scene( _parametersManager.getSceneParameters(),
+                             geometryParameters );
+
+    MorphologyLoader morphologyLoader( geometryParameters );
+    const servus::URI uri( geometryParameters.getCircuitConfiguration( ));
+    bool received = true;
+    size_t simulationOffset = 1;
+    if( !morphologyLoader.importCircuitShard(
+            uri, geometryParameters.getTarget(), shard, nbShards,
+            [&]
+            {
+                size_t firstSimulationOffset = 1;
+                if( simulationOffsetInput != -1 )
+                    received = _readSimulationOffset(
+                        simulationOffsetInput, firstSimulationOffset );
+                return firstSimulationOffset;
+            },
+            simulationOffset, scene ))
+    {
+        return false;
+    }
+
+    if( !received )
+    {
+        BRAYNS_ERROR << "Shard " << shard << " did not receive the simulation "
+                     << "offset of the preceding shards" << std::endl;
+        return false;
+    }
+
+    // The next worker is released before this shard is saved
+    if( simulationOffsetOutput != -1 &&
+        !_writeSimulationOffset( simulationOffsetOutput, simulationOffset ))
+    {
+        BRAYNS_ERROR << "Shard " << shard << " failed to send its simulation "
+                     << "offset" << std::endl;
+        return false;
+    }
+
+    // Shards are sorted once merged, so every shard is saved as a single
+    // timestamp range per material
+    TimestampIndicesMap timestampSpheresIndices;
+    TimestampIndicesMap timestampCylindersIndices;
+    TimestampIndicesMap timestampConesIndices;
+    for( size_t materialId = 0; materialId < NB_MAX_MATERIALS; ++materialId )
+    {
+        timestampSpheresIndices[materialId][0] =
+            scene.getSpheres()[materialId].size();
+        timestampCylindersIndices[materialId][0] =
+            scene.getCylinders()[materialId].size();
+        timestampConesIndices[materialId][0] =
+            scene.getCones()[materialId].size();
+    }
+
+    const SceneCacheContainer container =
+    {
+        scene.getSpheres(), scene.getCylinders(), scene.getCones(),
+        timestampSpheresIndices,
+        timestampCylindersIndices,
+        timestampConesIndices
+    };
+    return SceneCache::save( _getShardFilename( shard ), container,
+                             NB_MAX_MATERIALS, scene.getWorldBounds(), false );
+}
+
+bool CacheBuilder::_mergeShards( const size_t nbShards )
+{
+    const GeometryParameters& geometryParameters =
+        _parametersManager.getGeometryParameters();
+
+    SpheresMap spheres;
+    CylindersMap cylinders;
+    ConesMap cones;
+    TimestampIndicesMap timestampSpheresIndices;
+    TimestampIndicesMap timestampCylindersIndices;
+    TimestampIndicesMap timestampConesIndices;
+
+    // Entries of all materials are created beforehand, so that materials can
+    // then be sorted in parallel
+    for( size_t materialId = 0; materialId < NB_MAX_MATERIALS; ++materialId )
+    {
+        spheres[materialId].clear();
+        cylinders[materialId].clear();
+        cones[materialId].clear();
+        timestampSpheresIndices[materialId].clear();
+        timestampCylindersIndices[materialId].clear();
+        timestampConesIndices[materialId].clear();
+    }
+
+    Boxf bounds;
+    for( size_t shard = 0; shard < nbShards; ++shard )
+    {
+        const std::string& filename = _getShardFilename( shard );
+        std::ifstream file( filename, std::ios::in | std::ios::binary );
+        const std::vector< char > buffer(
+            ( std::istreambuf_iterator< char >( file )),
+            std::istreambuf_iterator< char >( ));
+
+        SceneCacheMaterials materials;
+        Boxf shardBounds;
+        if( !SceneCache::parse( buffer.data(), buffer.data() + buffer.size(),
+                                NB_MAX_MATERIALS, materials, shardBounds ) ||
+            materials.size() != NB_MAX_MATERIALS )
+        {
+            BRAYNS_ERROR << "Corrupted shard " << filename << std::endl;
+            return false;
+        }
+
+        bounds.merge( shardBounds );
+        for( size_t materialId = 0; materialId < NB_MAX_MATERIALS;
+             ++materialId )
+        {
+            _appendPrimitives( materials[materialId].spheres,
+                               spheres[materialId] );
+            _appendPrimitives( materials[materialId].cylinders,
+                               cylinders[materialId] );
+            _appendPrimitives( materials[materialId].cones,
+                               cones[materialId] );
+        }
+    }
+
+    BRAYNS_INFO << "Sorting primitives of " << nbShards << " shards"
+                << std::endl;
+    const bool timeBuckets = geometryParameters.getGenerateMultipleModels();
+    #pragma omp parallel for schedule( dynamic )
+    for( size_t materialId = 0; materialId < NB_MAX_MATERIALS; ++materialId )
+    {
+        sortPrimitives( spheres[materialId], timeBuckets,
+                        timestampSpheresIndices[materialId] );
+        sortPrimitives( cylinders[materialId], timeBuckets,
+                        timestampCylindersIndices[materialId] );
+        sortPrimitives( cones[materialId], timeBuckets,
+                        timestampConesIndices[materialId] );
+    }
+
+    const SceneCacheContainer container =
+    {
+        spheres, cylinders, cones,
+        timestampSpheresIndices,
+        timestampCylindersIndices,
+        timestampConesIndices
+    };
+    return SceneCache::save( geometryParameters.getSaveCacheFile(), container,
+                             NB_MAX_MATERIALS, bounds,
+                             geometryParameters.getCompressCache( ));
+}
+
+std::string CacheBuilder::_getShardFilename( const size_t shard )
+{
+    return _parametersManager.getGeometryParameters().getSaveCacheFile() +
+           ".shard" + std::to_string( shard );
+}
+
+}
@@ -0,0 +1,103 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CACHEBUILDER_H
+#define CACHEBUILDER_H
+
+#include <brayns/common/types.h>
+#include <brayns/parameters/AbstractParameters.h>
+#include <brayns/parameters/ParametersManager.h>
+
+namespace brayns
+{
+
+/** Parameters specific to the cache builder */
+class CacheBuilderParameters final : public AbstractParameters
+{
+public:
+    CacheBuilderParameters();
+
+    /** @copydoc AbstractParameters::print */
+    void print( ) final;
+
+    /** Number of shards the circuit target is split into. Every shard is
+        loaded by its own worker process */
+    size_t getShards( ) const { return _shards; }
+
+    /** Morphology store to convert the morphologies of the circuit target to.
+        Empty if no store is converted */
+    const std::string& getSaveMorphologyStore( ) const
+    {
+        return _saveMorphologyStore;
+    }
+
+    /** Simulation cache file to extract the frames of the simulation time
+        window and the cells of the circuit target to. Empty if no simulation
+        cache is extracted */
+    const std::string& getExtractSimulationCache( ) const
+    {
+        return _extractSimulationCache;
+    }
+
+protected:
+
+    bool _parse( const po::variables_map& vm ) final;
+
+    size_t _shards;
+    std::string _saveMorphologyStore;
+    std::string _extractSimulationCache;
+};
+
+/** Builds the cache file of a circuit without any rendering engine. The
+ *  circuit target is split into shards of consecutive GIDs, loaded in
+ *  parallel by worker processes, and merged into a single cache file.
+ */
+class CacheBuilder
+{
+public:
+
+    CacheBuilder( int argc, const char **argv );
+
+    /** Loads the circuit given by the geometry parameters and saves it to the
+     *  cache file given by --save-cache-file, and/or converts its
+     *  morphologies to the store given by --save-morphology-store, and/or
+     *  extracts a subset of --simulation-cache-file to the file given by
+     *  --extract-simulation-cache
+     *
+     * @return True if the cache file was successfully built, false otherwise
+     */
+    bool build();
+
+private:
+
+    bool _convertMorphologies();
+    bool _buildCache();
+    bool _extractSimulationCache();
+    bool _buildShard( size_t shard, size_t nbShards,
+                      int simulationOffsetInput, int simulationOffsetOutput );
+    bool _mergeShards( size_t nbShards );
+    std::string _getShardFilename( size_t shard );
+
+    ParametersManager _parametersManager;
+    CacheBuilderParameters _cacheBuilderParameters;
+};
+
+}
+#endif // CACHEBUILDER_H
@@ -39,12 +39,19 @@
 #include <boost/filesystem.hpp>
 #include <servus/uri.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 namespace brayns
 {
 
 struct Brayns::Impl
 {
     Impl( int argc, const char **argv )
+        : _sceneLoaded( false )
+        , _sceneLoadFailed( false )
+        , _defaultEpsilon( false )
     {
         BRAYNS_INFO << "Parsing command line options" << std::endl;
         _parametersManager.reset( new ParametersManager( ));
@@ -59,33 +66,33 @@ struct Brayns::Impl
         if( !_engine )
             throw std::runtime_error( "Unsupported engine: " + engineName );
 
-        // set HDRI skybox if applicable
-        const std::string& hdri =
-            _parametersManager->getRenderingParameters().getHDRI();
         ScenePtr scene = _engine->getScene();
-        if( !hdri.empty() )
-            scene->getMaterial(MATERIAL_SKYBOX)->setTexture(TT_DIFFUSE, hdri);
-
-        // Default sun light
-        DirectionalLightPtr sunLight( new DirectionalLight(
-            DEFAULT_SUN_DIRECTION, DEFAULT_SUN_COLOR, DEFAULT_SUN_INTENSITY ));
-        scene->addLight( sunLight );
+        _setupScene( *scene );
 
         // Build geometry
-        loadData( );
+        loadData( _parametersManager->getGeometryParameters(),
+                  _parametersManager->getSceneParameters(), scene, true );
+        scene->commitSimulationData( );
         scene->buildEnvironment( );
         scene->buildGeometry( );
 
-        if( scene->isEmpty() )
-            _buildDefaultScene();
+        // When loading in the background, the scene is empty until the first
+        // batch is committed. The default camera and epsilon are then set
+        // according to the bounds of that batch
+        const bool loadingInBackground = _loadingThread.joinable();
+        if( scene->isEmpty() && !loadingInBackground )
+            _buildDefaultScene( *scene );
 
         scene->commit( );
 
-        // Set default camera according to scene bounding box
-        _setDefaultCamera( );
+        if( !loadingInBackground )
+        {
+            // Set default camera according to scene bounding box
+            _setDefaultCamera( );
 
-        // Set default epsilon according to scene bounding box
-        _setDefaultEpsilon( );
+            // Set default epsilon according to scene bounding box
+            _setDefaultEpsilon( );
+        }
 
         // Commit changes to the rendering engine
         _engine->commit();
@@ -93,27 +100,50 @@ struct Brayns::Impl
 
     ~Impl( )
     {
+        if( _loadingThread.joinable( ))
+        {
+            _engine->getScene()->cancelLoading();
+            _loadingThread.join();
+        }
+        if( _sceneLoadingThread.joinable( ))
+        {
+            _nextScene->cancelLoading();
+            _sceneLoadingThread.join();
+        }
     }
 
-    void loadData()
+    /**
+        Loads the data specified by the geometry parameters into the scene.
+        This method does not call the rendering engine, and can therefore run
+        in a background thread
+        @param geometryParameters Data sources and how they are loaded
+        @param sceneParameters Transfer function applied to the simulation
+        @param scene Scene receiving the data
+        @param progressive Allows the circuit to be loaded in batches that are
+               rendered as soon as they are loaded
+    */
+    void loadData(
+        const GeometryParameters& geometryParameters,
+        const SceneParameters& sceneParameters,
+        ScenePtr scene,
+        const bool progressive )
     {
-        GeometryParameters& geometryParameters =
-            _parametersManager->getGeometryParameters();
         if(!geometryParameters.getMorphologyFolder().empty())
-            _loadMorphologyFolder();
+            _loadMorphologyFolder( geometryParameters, *scene );
 
         if(!geometryParameters.getPDBFile().empty())
-            _loadPDBFile();
+            _loadPDBFile( geometryParameters, *scene );
 
         if(!geometryParameters.getMeshFolder().empty())
-            _loadMeshFolder();
+            _loadMeshFolder( geometryParameters, *scene );
 
         if(!geometryParameters.getReport().empty())
-            _loadCompartmentReport();
+            _loadCompartmentReport(
+                geometryParameters, sceneParameters, *scene );
 
         if(!geometryParameters.getCircuitConfiguration().empty() &&
             geometryParameters.getLoadCacheFile().empty())
-            _loadCircuitConfiguration();
+            _loadCircuitConfiguration( geometryParameters, scene, progressive );
     }
 
     void render( const RenderInput& renderInput,
@@ -132,6 +162,8 @@ struct Brayns::Impl
         _extensionPluginFactory->execute( );
 #endif
 
+        _commitSceneChanges();
+
         ScenePtr scene = _engine->getScene();
         CameraPtr camera = _engine->getCamera();
         FrameBufferPtr frameBuffer = _engine->getFrameBuffer();
@@ -150,6 +182,7 @@ struct Brayns::Impl
         }
 
         camera->commit();
+        scene->commitLevelsOfDetail( *camera );
         _render( );
 
         uint8_t* colorBuffer = frameBuffer->getColorBuffer( );
@@ -166,6 +199,8 @@ struct Brayns::Impl
 
     void render()
     {
+        _commitSceneChanges();
+
         ScenePtr scene = _engine->getScene();
         CameraPtr camera = _engine->getCamera();
         FrameBufferPtr frameBuffer = _engine->getFrameBuffer();
@@ -191,6 +226,7 @@ struct Brayns::Impl
         }
 
         camera->commit();
+        scene->commitLevelsOfDetail( *camera );
         _render( );
 
         _engine->postRender();
@@ -264,6 +300,156 @@ struct Brayns::Impl
     }
 
 private:
+    /**
+        Sets up the lights and the skybox of a new scene
+    */
+    void _setupScene( Scene& scene )
+    {
+        // set HDRI skybox if applicable
+        const std::string& hdri =
+            _parametersManager->getRenderingParameters().getHDRI();
+        if( !hdri.empty() )
+            scene.getMaterial(MATERIAL_SKYBOX)->setTexture(TT_DIFFUSE, hdri);
+
+        // Default sun light
+        DirectionalLightPtr sunLight( new DirectionalLight(
+            DEFAULT_SUN_DIRECTION, DEFAULT_SUN_COLOR, DEFAULT_SUN_INTENSITY ));
+        scene.addLight( sunLight );
+    }
+
+    /**
+        Applies the scene modifications requested since the previous frame:
+        starts loading a new scene, replaces the current scene with the one
+        that finished loading, and adds the batches loaded in the background
+    */
+    void _commitSceneChanges()
+    {
+        if( _engine->isSceneLoadRequested( ))
+            _loadSceneInBackground();
+        _swapScene();
+        _commitGeometryBatches();
+    }
+
+    /**
+        Loads the data specified by the geometry parameters into a new scene,
+        in a background thread. The current scene is rendered until the new
+        one is loaded
+    */
+    void _loadSceneInBackground()
+    {
+        _engine->setSceneLoadRequested( false );
+        if( _sceneLoadingThread.joinable( ))
+        {
+            BRAYNS_WARN << "A scene is already being loaded, the request is "
+                        << "ignored" << std::endl;
+            return;
+        }
+
+        BRAYNS_INFO << "Loading new scene" << std::endl;
+        _engine->setSceneLoading( true );
+        _nextScene = _engine->createScene( *_parametersManager );
+        _setupScene( *_nextScene );
+        _engine->getScene()->setLoadingProgress( 0.f );
+
+        // The loading thread works on its own copy of the parameters, so that
+        // they can be modified while the scene is being loaded
+        const GeometryParameters geometryParameters =
+            _parametersManager->getGeometryParameters();
+        const SceneParameters sceneParameters =
+            _parametersManager->getSceneParameters();
+        ScenePtr scene = _nextScene;
+        _sceneLoadingThread = std::thread(
+            [this, geometryParameters, sceneParameters, scene]
+            {
+                // Loading errors are reported by _swapScene, which then keeps
+                // the current scene
+                try
+                {
+                    loadData( geometryParameters, sceneParameters, scene,
+                              false );
+                }
+                catch( const std::exception& e )
+                {
+                    BRAYNS_ERROR << "Failed to load scene: " << e.what()
+                                 << std::endl;
+                    _sceneLoadFailed = true;
+                }
+                _sceneLoaded = true;
+            });
+    }
+
+    /**
+        Replaces the current scene with the one loaded in the background. The
+        geometry of the new scene is built by the rendering engine, which is
+        not thread safe, between two frames. The previous scene is released
+        once the renderers use the new one
+    */
+    void _swapScene()
+    {
+        if( !_sceneLoaded )
+            return;
+
+        _sceneLoadingThread.join();
+        _sceneLoaded = false;
+        _engine->setSceneLoading( false );
+
+        if( _sceneLoadFailed )
+        {
+            _sceneLoadFailed = false;
+            _nextScene.reset();
+            _engine->getScene()->setLoadingProgress( 1.f );
+            BRAYNS_WARN << "The current scene is kept" << std::endl;
+            return;
+        }
+
+        // Batches still being loaded belong to the previous scene
+        if( _loadingThread.joinable( ))
+        {
+            _engine->getScene()->cancelLoading();
+            _loadingThread.join();
+        }
+
+        ScenePtr scene = _nextScene;
+        _nextScene.reset();
+        scene->commitSimulationData();
+        scene->buildEnvironment();
+        scene->buildGeometry();
+        if( scene->isEmpty( ))
+            _buildDefaultScene( *scene );
+        scene->commit();
+
+        _engine->setScene( scene );
+        _setDefaultCamera();
+        if( _defaultEpsilon )
+            _parametersManager->getRenderingParameters().setEpsilon( 0.f );
+        _setDefaultEpsilon();
+
+        _engine->getFrameBuffer()->clear();
+        _engine->commit();
+        BRAYNS_INFO << "Scene replaced" << std::endl;
+    }
+
+    /**
+        Adds the batches loaded in the background to the scene. Batches are
+        committed between two frames, all at once, so that the rendering
+        engine rebuilds its acceleration structures at most once per frame
+    */
+    void _commitGeometryBatches()
+    {
+        ScenePtr scene = _engine->getScene();
+        const bool firstBatch = scene->getWorldBounds().isEmpty();
+        if( !scene->commitGeometryBatches( ))
+            return;
+
+        if( firstBatch )
+        {
+            _setDefaultCamera( );
+            _setDefaultEpsilon( );
+        }
+        _engine->getFrameBuffer()->clear();
+        _engine->commit();
+    }
+
     void _render( )
     {
 
@@ -302,6 +488,7 @@ private:
             epsilon = worldBoundsSize.length() / 1e6f;
             BRAYNS_INFO << "Default epsilon: " << epsilon << std::endl;
             _parametersManager->getRenderingParameters().setEpsilon( epsilon );
+            _defaultEpsilon = true;
         }
     }
 
@@ -309,16 +496,16 @@ private:
         Loads data from SWC and H5 files located in the folder specified in the
         geometry parameters (command line parameter --morphology-folder)
     */
-    void _loadMorphologyFolder()
+    void _loadMorphologyFolder(
+        const GeometryParameters& geometryParameters,
+        Scene& scene )
     {
-        GeometryParameters& geometryParameters =
-            _parametersManager->getGeometryParameters();
         const boost::filesystem::path& folder =
             geometryParameters.getMorphologyFolder( );
         BRAYNS_INFO << "Loading morphologies from " << folder << std::endl;
         MorphologyLoader morphologyLoader( geometryParameters );
 
-        size_t fileIndex = 0;
+        strings filenames;
         boost::filesystem::directory_iterator endIter;
         if( boost::filesystem::exists(folder) &&
             boost::filesystem::is_directory(folder))
@@ -331,46 +518,42 @@ private:
                     boost::filesystem::path fileExtension =
                         dirIter->path( ).extension( );
                     if( fileExtension==".swc" || fileExtension==".h5" )
-                    {
-                        const std::string& filename = dirIter->path( ).string( );
-                        servus::URI uri( filename );
-                        if( !morphologyLoader.importMorphology(
-                            uri, fileIndex++, *_engine->getScene()))
-                        {
-                            BRAYNS_ERROR << "Failed to import " <<
-                                filename << std::endl;
-                        }
-                    }
+                        filenames.push_back( dirIter->path( ).string( ));
                 }
             }
         }
+
+        // Sorted so that morphologies keep their index, and hence their
+        // color, whatever the order of the directory entries
+        std::sort( filenames.begin(), filenames.end( ));
+        const std::vector< servus::URI > uris( filenames.begin(),
+                                               filenames.end( ));
+        morphologyLoader.importMorphologies( uris, scene );
     }
 
     /**
         Loads data from a PDB file (command line parameter --pdb-file)
     */
-    void _loadPDBFile()
+    void _loadPDBFile(
+        const GeometryParameters& geometryParameters,
+        Scene& scene )
     {
         // Load PDB File
-        GeometryParameters& geometryParameters =
-            _parametersManager->getGeometryParameters();
         BRAYNS_INFO << "Loading PDB file " << geometryParameters.getPDBFile()
                     << std::endl;
         ProteinLoader proteinLoader( geometryParameters );
         if( !proteinLoader.importPDBFile( geometryParameters.getPDBFile(),
-                                          Vector3f( 0, 0, 0 ), 0,
-                                          *_engine->getScene()))
+                                          Vector3f( 0, 0, 0 ), 0, scene ))
         {
             BRAYNS_ERROR << "Failed to import "
                          << geometryParameters.getPDBFile() << std::endl;
         }
 
-        ScenePtr scene = _engine->getScene();
-        for( size_t i = 0; i < scene->getMaterials().size( ); ++i )
+        for( size_t i = 0; i < scene.getMaterials().size( ); ++i )
         {
             float r,g,b;
             proteinLoader.getMaterialKd( i, r, g, b );
-            MaterialPtr material = scene->getMaterials()[i];
+            MaterialPtr material = scene.getMaterials()[i];
             material->setColor( Vector3f( r, g, b ));
         }
     }
@@ -379,11 +562,11 @@ private:
         Loads data from mesh files located in the folder specified in the
         geometry parameters (command line parameter --mesh-folder)
     */
-    void _loadMeshFolder()
+    void _loadMeshFolder(
+        const GeometryParameters& geometryParameters,
+        Scene& scene )
     {
 #ifdef BRAYNS_USE_ASSIMP
-        GeometryParameters& geometryParameters =
-            _parametersManager->getGeometryParameters();
         const boost::filesystem::path& folder =
             geometryParameters.getMeshFolder( );
         BRAYNS_INFO << "Loading meshes from " << folder << std::endl;
@@ -397,15 +580,16 @@ private:
             for( boost::filesystem::directory_iterator dirIter( folder );
                  dirIter != endIter; ++dirIter )
             {
+                if( scene.isLoadingCancelled( ))
+                    break;
                 if( boost::filesystem::is_regular_file(dirIter->status( )))
                 {
                     const std::string& filename = dirIter->path( ).string( );
                     BRAYNS_INFO << "- " << filename << std::endl;
-                    ScenePtr scene = _engine->getScene();
                     MeshContainer MeshContainer =
                     {
-                        scene->getTriangleMeshes(), scene->getMaterials(),
-                        scene->getWorldBounds()
+                        scene.getTriangleMeshes(), scene.getMaterials(),
+                        scene.getWorldBounds()
                     };
                     if(!meshLoader.importMeshFromFile(
                         filename, MeshContainer, MQ_MAX_QUALITY, NO_MATERIAL ))
@@ -424,10 +608,11 @@ private:
         Loads morphologies from circuit configuration (command line parameter
         --circuit-configuration)
     */
-    void _loadCircuitConfiguration()
+    void _loadCircuitConfiguration(
+        const GeometryParameters& geometryParameters,
+        ScenePtr scene,
+        const bool progressive )
     {
-        GeometryParameters& geometryParameters =
-            _parametersManager->getGeometryParameters();
         const std::string& filename =
             geometryParameters.getCircuitConfiguration( );
         const std::string& target =
@@ -437,13 +622,69 @@ private:
             filename << std::endl;
         const std::string& report =
             geometryParameters.getReport( );
-        MorphologyLoader morphologyLoader( geometryParameters );
         const servus::URI uri( filename );
+        if( progressive && _isLoadingInBackground( geometryParameters ))
+        {
+            // The loader lives in the loading thread, and queues batches to
+            // the scene until the circuit is loaded or loading is cancelled
+            const size_t batchSize = geometryParameters.getLoadingBatchSize();
+            scene->setLoadingProgress( 0.f );
+            _loadingThread = std::thread(
+                [geometryParameters, uri, target, batchSize, scene]
+                {
+                    // Errors must not escape the thread, the batches loaded
+                    // so far are still rendered
+                    try
+                    {
+                        MorphologyLoader morphologyLoader( geometryParameters );
+                        morphologyLoader.importCircuitInBatches(
+                            uri, target, batchSize, *scene );
+                    }
+                    catch( const std::exception& e )
+                    {
+                        BRAYNS_ERROR << "Failed to load circuit: " << e.what()
+                                     << std::endl;
+                    }
+                    scene->setLoadingProgress( 1.f );
+                });
+            return;
+        }
+
+        MorphologyLoader morphologyLoader( geometryParameters );
         if( report.empty() )
-            morphologyLoader.importCircuit( uri, target, *_engine->getScene());
+            morphologyLoader.importCircuit( uri, target, *scene );
         else
-            morphologyLoader.importCircuit(
-                uri, target, report, *_engine->getScene());
+            morphologyLoader.importCircuit( uri, target, report, *scene );
+    }
+
+    /**
+        Defines if the circuit is loaded in the background, in batches that are
+        rendered as soon as they are loaded. Options that need the whole
+        circuit when the geometry is built fall back to loading it before the
+        first frame
+    */
+    bool _isLoadingInBackground(
+        const GeometryParameters& geometryParameters ) const
+    {
+        if( geometryParameters.getLoadingBatchSize() == 0 )
+            return false;
+
+        std::string reason;
+        if( !geometryParameters.getReport().empty( ))
+            reason = "compartment reports";
+        else if( geometryParameters.getMorphologyInstancing( ))
+            reason = "morphology instancing";
+        else if( !geometryParameters.getSaveCacheFile().empty( ))
+            reason = "saving the scene cache";
+        else if( geometryParameters.getSceneEnvironment() != SE_NONE )
+            reason = "scene environments";
+        if( reason.empty( ))
+            return true;
+
+        BRAYNS_WARN << "Background loading is not supported with " << reason
+                    << ". The circuit is loaded before the first frame"
+                    << std::endl;
+        return false;
     }
 
     /**
@@ -451,10 +692,11 @@ private:
         parameter --report)
         @return the number of simulation frames loaded
     */
-    void _loadCompartmentReport()
+    void _loadCompartmentReport(
+        const GeometryParameters& geometryParameters,
+        const SceneParameters& sceneParameters,
+        Scene& scene )
     {
-        GeometryParameters& geometryParameters =
-            _parametersManager->getGeometryParameters();
         const std::string& filename =
             geometryParameters.getCircuitConfiguration( );
         const std::string& target =
@@ -466,29 +708,34 @@ private:
         const servus::URI uri( filename );
         if( morphologyLoader.importSimulationData( uri, target, report ))
         {
-            SceneParameters& sceneParameters =
-                _parametersManager->getSceneParameters();
             const std::string& transferFunctionFilename =
                 sceneParameters.getTransferFunctionFilename();
             if( !transferFunctionFilename.empty() )
             {
                 TransferFunctionLoader transferFunctionLoader;
                 transferFunctionLoader.loadFromFile(
-                    transferFunctionFilename, *_engine->getScene() );
+                    transferFunctionFilename, scene );
             }
-            _engine->getScene()->commitSimulationData();
         }
     }
 
-    void _buildDefaultScene()
+    void _buildDefaultScene( Scene& scene )
     {
-        ScenePtr scene = _engine->getScene();
-        scene->buildDefault();
-        scene->buildGeometry();
+        scene.buildDefault();
+        scene.buildGeometry();
     }
 
     ParametersManagerPtr _parametersManager;
     EnginePtr _engine;
+    std::thread _loadingThread;
+
+    // Scene loaded in the background, that replaces the current scene once
+    // loaded
+    ScenePtr _nextScene;
+    std::thread _sceneLoadingThread;
+    std::atomic< bool > _sceneLoaded;
+    std::atomic< bool > _sceneLoadFailed;
+    bool _defaultEpsilon;
 
 #if(BRAYNS_USE_DEFLECT || BRAYNS_USE_REST)
     ExtensionPluginFactoryPtr _extensionPluginFactory;
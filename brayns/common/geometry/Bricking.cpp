@@ -0,0 +1,74 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Bricking.h"
+
+namespace brayns
+{
+
+namespace
+{
+// Spreads the 10 lower bits of a value so that there are two zero bits
+// between every bit
+uint32_t _expandBits( uint32_t value )
+{
+    value = ( value * 0x00010001u ) & 0xFF0000FFu;
+    value = ( value * 0x00000101u ) & 0x0F00F00Fu;
+    value = ( value * 0x00000011u ) & 0xC30C30C3u;
+    value = ( value * 0x00000005u ) & 0x49249249u;
+    return value;
+}
+
+uint32_t _quantize( const float value, const float min, const float size )
+{
+    if( size <= 0.f )
+        return 0;
+    const float normalized = ( value - min ) / size;
+    return std::min( 1023u, static_cast< uint32_t >(
+        std::max( 0.f, normalized ) * 1024.f ));
+}
+}
+
+uint32_t getMortonCode( const Vector3f& position, const Boxf& bounds )
+{
+    const Vector3f& min = bounds.getMin();
+    const Vector3f size = bounds.getSize();
+    const uint32_t x = _quantize( position.x(), min.x(), size.x( ));
+    const uint32_t y = _quantize( position.y(), min.y(), size.y( ));
+    const uint32_t z = _quantize( position.z(), min.z(), size.z( ));
+    return ( _expandBits( x ) << 2 ) | ( _expandBits( y ) << 1 ) |
+           _expandBits( z );
+}
+
+size_ts getBricks( const size_t begin, const size_t end,
+                   const size_t maxBrickSize )
+{
+    size_ts bricks;
+    if( end <= begin )
+        return bricks;
+
+    const size_t nbPrimitives = end - begin;
+    const size_t nbBricks = ( nbPrimitives + maxBrickSize - 1 ) / maxBrickSize;
+    for( size_t i = 1; i <= nbBricks; ++i )
+        bricks.push_back( begin + nbPrimitives * i / nbBricks );
+    return bricks;
+}
+
+}
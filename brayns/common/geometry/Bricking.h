@@ -0,0 +1,123 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef BRICKING_H
+#define BRICKING_H
+
+#include <brayns/api.h>
+#include <brayns/common/types.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace brayns
+{
+
+/**
+   Returns the 30 bit Morton code of a position, quantized on a 1024^3 grid
+   covering the given bounds
+   @param position Position to encode
+   @param bounds Bounds of all positions to encode
+   @return Morton code of the position
+*/
+BRAYNS_API uint32_t getMortonCode( const Vector3f& position, const Boxf& bounds );
+
+/**
+   Splits a range of primitives into evenly sized bricks
+   @param begin Index of the first primitive of the range
+   @param end Index of the last primitive (exclusive) of the range
+   @param maxBrickSize Maximum number of primitives per brick
+   @return Index of the last primitive (exclusive) of every brick
+*/
+BRAYNS_API size_ts getBricks( size_t begin, size_t end, size_t maxBrickSize );
+
+/**
+   Reorders a range of primitives along the Morton curve of their centers, so
+   that bricks of consecutive primitives are spatially coherent
+   @param primitives Primitives to sort. The type of primitive must have a
+          center attribute
+   @param begin Index of the first primitive of the range to sort
+   @param end Index of the last primitive (exclusive) of the range to sort
+*/
+template< typename T >
+void sortByMortonCode( std::vector< T >& primitives, size_t begin, size_t end )
+{
+    if( end - begin < 2 )
+        return;
+
+    Boxf bounds;
+    for( size_t i = begin; i < end; ++i )
+        bounds.merge( primitives[i].center );
+
+    std::vector< std::pair< uint32_t, size_t >> codes;
+    codes.reserve( end - begin );
+    for( size_t i = begin; i < end; ++i )
+        codes.push_back( std::make_pair(
+            getMortonCode( primitives[i].center, bounds ), i ));
+    std::sort( codes.begin(), codes.end( ));
+
+    std::vector< T > sorted;
+    sorted.reserve( end - begin );
+    for( const auto& code: codes )
+        sorted.push_back( primitives[code.second] );
+    std::copy( sorted.begin(), sorted.end(), primitives.begin() + begin );
+}
+
+/**
+   Sorts primitives the way rendering engines expect them: by timestamp if
+   requested, and along the Morton curve within every timestamp
+   @param primitives Primitives to sort. The type of primitive must have a
+          center and a timestamp attribute
+   @param timeBuckets Defines if primitives should be sorted by timestamp.
+          Otherwise all primitives are considered to have a 0 timestamp
+   @param timestampIndices Returned index of the last primitive (exclusive)
+          for every timestamp
+*/
+template< typename T >
+void sortPrimitives( std::vector< T >& primitives, const bool timeBuckets,
+                     std::map< size_t, size_t >& timestampIndices )
+{
+    if( timeBuckets )
+        std::stable_sort( primitives.begin(), primitives.end(),
+            []( const T& a, const T& b ) { return a.timestamp < b.timestamp; } );
+    // Primitives are now grouped by timestamp, the index is only written once
+    // per group instead of once per primitive
+    const size_t nbPrimitives = primitives.size();
+    for( size_t i = 0; i < nbPrimitives; ++i )
+    {
+        const size_t ts = timeBuckets ? primitives[i].timestamp : 0;
+        const bool lastOfGroup = i + 1 == nbPrimitives ||
+            ( timeBuckets && size_t( primitives[i + 1].timestamp ) != ts );
+        if( lastOfGroup )
+            timestampIndices[ts] = i + 1;
+    }
+
+    size_t begin = 0;
+    for( const auto& index: timestampIndices )
+    {
+        sortByMortonCode( primitives, begin, index.second );
+        begin = index.second;
+    }
+}
+
+}
+
+#endif // BRICKING_H
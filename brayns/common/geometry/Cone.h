@@ -21,43 +21,49 @@
 #ifndef CONE_H
 #define CONE_H
 
-#include "Primitive.h"
-
 #include <brayns/api.h>
 #include <brayns/common/types.h>
-#include <map>
 
 namespace brayns
 {
 
-class Cone : public Primitive
+/**
+   Cone primitive
+
+   Cones are stored by value in contiguous per-material arrays, with the memory
+   layout expected by the rendering engines (center, up, center radius, up
+   radius, timestamp, value).
+ */
+struct Cone
 {
-public:
-    BRAYNS_API Cone(
-        size_t materialId,
-        const Vector3f& center,
-        const Vector3f& up,
-        float centerRadius,
-        float upRadius,
-        float timestamp,
-        float value);
-
-    BRAYNS_API const Vector3f& getCenter() const { return _center; }
-    BRAYNS_API const Vector3f& getUp() const { return _up; }
-    BRAYNS_API float getCenterRadius() const { return _centerRadius; }
-    BRAYNS_API float getUpRadius() const { return _upRadius; }
-
-    BRAYNS_API virtual size_t serializeData(floats& serializedData);
-    BRAYNS_API static size_t getSerializationSize();
-
-private:
-    Vector3f _center;
-    Vector3f _up;
-    float _centerRadius;
-    float _upRadius;
-    float _value;
+    Cone() {}
+    Cone(
+        const Vector3f& center_,
+        const Vector3f& up_,
+        const float centerRadius_,
+        const float upRadius_,
+        const float timestamp_,
+        const float value_ )
+        : center( center_ )
+        , up( up_ )
+        , centerRadius( centerRadius_ )
+        , upRadius( upRadius_ )
+        , timestamp( timestamp_ )
+        , value( value_ )
+    {
+    }
+
+    Vector3f center;
+    Vector3f up;
+    float centerRadius;
+    float upRadius;
+    float timestamp;
+    float value;
 };
 
+static_assert( sizeof( Cone ) == 10 * sizeof( float ),
+               "Unexpected cone memory layout" );
+
 }
 
 #endif // CONE_H
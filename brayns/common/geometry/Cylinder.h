@@ -21,41 +21,45 @@
 #ifndef CYLINDER_H
 #define CYLINDER_H
 
-#include "Primitive.h"
-
 #include <brayns/api.h>
 #include <brayns/common/types.h>
-#include <map>
 
 namespace brayns
 {
 
-class Cylinder : public Primitive
+/**
+   Cylinder primitive
+
+   Cylinders are stored by value in contiguous per-material arrays, with the
+   memory layout expected by the rendering engines (center, up, radius,
+   timestamp, value).
+ */
+struct Cylinder
 {
-public:
-    BRAYNS_API Cylinder(
-        size_t materialId,
-        const Vector3f& center,
-        const Vector3f& up,
-        float radius,
-        float timestamp,
-        float value);
-
-    BRAYNS_API const Vector3f& getCenter() const { return _center; }
-    BRAYNS_API const Vector3f& getUp() const { return _up; }
-    BRAYNS_API float getRadius() const { return _radius; }
-    BRAYNS_API float getValue() const { return _value; }
-
-    BRAYNS_API virtual size_t serializeData(floats& serializedData);
-    BRAYNS_API static size_t getSerializationSize();
-
-private:
-    Vector3f _center;
-    Vector3f _up;
-    float _radius;
-    float _value;
+    Cylinder() {}
+    Cylinder(
+        const Vector3f& center_,
+        const Vector3f& up_,
+        const float radius_,
+        const float timestamp_,
+        const float value_ )
+        : center( center_ )
+        , up( up_ )
+        , radius( radius_ )
+        , timestamp( timestamp_ )
+        , value( value_ )
+    {
+    }
+
+    Vector3f center;
+    Vector3f up;
+    float radius;
+    float timestamp;
+    float value;
 };
 
-}
+static_assert( sizeof( Cylinder ) == 9 * sizeof( float ),
+               "Unexpected cylinder memory layout" );
 
+}
 #endif // CYLINDER_H
@@ -0,0 +1,78 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef GEOMETRYTEMPLATE_H
+#define GEOMETRYTEMPLATE_H
+
+#include <brayns/api.h>
+#include <brayns/common/types.h>
+#include <brayns/common/geometry/Sphere.h>
+#include <brayns/common/geometry/Cylinder.h>
+#include <brayns/common/geometry/Cone.h>
+
+namespace brayns
+{
+
+/**
+   Primitives of a geometry template at a given level of detail
+ */
+struct GeometryLevel
+{
+    SpheresMap spheres;
+    CylindersMap cylinders;
+    ConesMap cones;
+};
+
+/**
+   Geometry template
+
+   Primitives shared by several instances of the scene, expressed in their own
+   frame of reference. Templates are built once, and placed in the scene by
+   instances, so that memory scales with the number of templates rather than
+   with the number of instances.
+ */
+struct GeometryTemplate
+{
+    /** Representations of the template, from the most to the least detailed.
+        Engines select one of them per instance, according to the size of the
+        instance on screen */
+    std::vector< GeometryLevel > levels;
+    Boxf bounds;
+};
+
+/**
+   Placement of a geometry template in the scene
+ */
+struct Instance
+{
+    Instance() : templateId( 0 ) {}
+    Instance( const size_t templateId_, const Matrix4f& transformation_ )
+        : templateId( templateId_ )
+        , transformation( transformation_ )
+    {
+    }
+
+    size_t templateId;
+    Matrix4f transformation;
+};
+
+}
+
+#endif // GEOMETRYTEMPLATE_H
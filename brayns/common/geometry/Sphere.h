@@ -21,37 +21,43 @@
 #ifndef SPHERE_H
 #define SPHERE_H
 
-#include "Primitive.h"
-
 #include <brayns/api.h>
 #include <brayns/common/types.h>
-#include <map>
 
 namespace brayns
 {
 
-class Sphere : public Primitive
+/**
+   Sphere primitive
+
+   Spheres are stored by value in contiguous per-material arrays. The memory
+   layout of the structure is the one expected by the rendering engines
+   (center, radius, timestamp, value) so that arrays of spheres can be handed
+   over to the engine without any conversion.
+ */
+struct Sphere
 {
-public:
-    BRAYNS_API Sphere(
-        size_t materialId,
-        const Vector3f& center,
-        float radius,
-        float timestamp,
-        float value);
-
-    BRAYNS_API const Vector3f& getCenter() const { return _center; }
-    BRAYNS_API float getRadius() const { return _radius; }
-    BRAYNS_API float getValue() const { return _value; }
-
-    BRAYNS_API virtual size_t serializeData(floats& serializedData);
-    BRAYNS_API static size_t getSerializationSize();
-
-private:
-    Vector3f _center;
-    float _radius;
-    float _value;
+    Sphere() {}
+    Sphere(
+        const Vector3f& center_,
+        const float radius_,
+        const float timestamp_,
+        const float value_ )
+        : center( center_ )
+        , radius( radius_ )
+        , timestamp( timestamp_ )
+        , value( value_ )
+    {
+    }
+
+    Vector3f center;
+    float radius;
+    float timestamp;
+    float value;
 };
 
+static_assert( sizeof( Sphere ) == 6 * sizeof( float ),
+               "Unexpected sphere memory layout" );
+
 }
 #endif // SPHERE_H
@@ -26,6 +26,7 @@
 #include <brayns/common/material/Material.h>
 #include <brayns/io/TransferFunctionLoader.h>
 #include <brayns/common/simulation/SimulationDescriptor.h>
+#include <brayns/common/geometry/Bricking.h>
 
 #include <servus/uri.h>
 
@@ -42,12 +43,18 @@ Scene::Scene(
     , _geometryParameters( geometryParameters )
     , _renderers( renderers )
     , _isEmpty( true )
+    , _loadingCancelled( false )
+    , _loadingProgress( 1.f )
 {
 }
 
 Scene::~Scene( )
 {
-    _primitives.clear( );
+    _spheres.clear( );
+    _cylinders.clear( );
+    _cones.clear( );
+    _geometryTemplates.clear( );
+    _instances.clear( );
     _trianglesMeshes.clear( );
 }
 
@@ -210,8 +217,8 @@ void Scene::buildDefault( )
     size_t material = 7;
 
     // Sphere
-    _primitives[material].push_back( SpherePtr(
-        new Sphere( material, Vector3f( -0.5f, -0.5f, -0.5f ), 0.5f, 0, 0 )));
+    _spheres[material].push_back(
+        Sphere( Vector3f( -0.5f, -0.5f, -0.5f ), 0.5f, 0, 0 ));
     _materials[material]->setOpacity( 0.3f );
     _materials[material]->setRefractionIndex( 1.3f );
     _materials[material]->setSpecularColor( WHITE );
@@ -219,20 +226,18 @@ void Scene::buildDefault( )
 
     // Cylinder
     ++material;
-    _primitives[material].push_back( CylinderPtr(
-        new Cylinder( material,
-            Vector3f( -0.5f, -0.75f, 0.5f ), Vector3f( 0.5f, -0.75f, 0.5f ),
-            0.25f, 0, 0 )));
+    _cylinders[material].push_back(
+        Cylinder( Vector3f( -0.5f, -0.75f, 0.5f ),
+            Vector3f( 0.5f, -0.75f, 0.5f ), 0.25f, 0, 0 ));
     _materials[material]->setColor( Vector3f( 0.1f, 0.1f, 0.8f ));
     _materials[material]->setSpecularColor( WHITE );
     _materials[material]->setSpecularExponent( 10.f );
 
     // Cone
     ++material;
-    _primitives[material].push_back( ConePtr(
-        new Cone( material,
-            Vector3f( 0.5f, -1.f, -0.5f ), Vector3f( 0.5f, 0.f, -0.5f ),
-            0.3f, 0.f, 0, 0 )));
+    _cones[material].push_back(
+        Cone( Vector3f( 0.5f, -1.f, -0.5f ), Vector3f( 0.5f, 0.f, -0.5f ),
+            0.3f, 0.f, 0, 0 ));
     _materials[material]->setReflectionIndex(0.8f);
     _materials[material]->setSpecularColor( WHITE );
     _materials[material]->setSpecularExponent( 10.f );
@@ -435,41 +440,114 @@ void Scene::buildEnvironment( )
         };
 
         for( size_t i = 0; i < 8; ++i)
-            _primitives[material].push_back( SpherePtr(
-                new Sphere( material, positions[i], radius, 0, 0)));
-
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[0], positions[1], radius, 0, 0)));
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[2], positions[3], radius, 0, 0)));
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[4], positions[5], radius, 0, 0)));
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[6], positions[7], radius, 0, 0)));
-
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[0], positions[2], radius, 0, 0)));
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[1], positions[3], radius, 0, 0)));
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[4], positions[6], radius, 0, 0)));
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[5], positions[7], radius, 0, 0)));
-
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[0], positions[4], radius, 0, 0)));
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[1], positions[5], radius, 0, 0)));
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[2], positions[6], radius, 0, 0)));
-        _primitives[material].push_back( CylinderPtr(
-            new Cylinder( material, positions[3], positions[7], radius, 0, 0)));
+            _spheres[material].push_back(
+                Sphere( positions[i], radius, 0, 0 ));
+
+        _cylinders[material].push_back(
+            Cylinder( positions[0], positions[1], radius, 0, 0 ));
+        _cylinders[material].push_back(
+            Cylinder( positions[2], positions[3], radius, 0, 0 ));
+        _cylinders[material].push_back(
+            Cylinder( positions[4], positions[5], radius, 0, 0 ));
+        _cylinders[material].push_back(
+            Cylinder( positions[6], positions[7], radius, 0, 0 ));
+
+        _cylinders[material].push_back(
+            Cylinder( positions[0], positions[2], radius, 0, 0 ));
+        _cylinders[material].push_back(
+            Cylinder( positions[1], positions[3], radius, 0, 0 ));
+        _cylinders[material].push_back(
+            Cylinder( positions[4], positions[6], radius, 0, 0 ));
+        _cylinders[material].push_back(
+            Cylinder( positions[5], positions[7], radius, 0, 0 ));
+
+        _cylinders[material].push_back(
+            Cylinder( positions[0], positions[4], radius, 0, 0 ));
+        _cylinders[material].push_back(
+            Cylinder( positions[1], positions[5], radius, 0, 0 ));
+        _cylinders[material].push_back(
+            Cylinder( positions[2], positions[6], radius, 0, 0 ));
+        _cylinders[material].push_back(
+            Cylinder( positions[3], positions[7], radius, 0, 0 ));
 
         break;
     }
     }
 }
 
+bool Scene::addGeometryBatch( GeometryBatch& batch )
+{
+    if( _loadingCancelled )
+        return false;
+
+    // Primitives are sorted by the loading thread, so that the rendering
+    // thread only has to create the engine specific geometry
+    const bool timeBuckets = _geometryParameters.getGenerateMultipleModels();
+    for( auto& spheres: batch.spheres )
+        sortPrimitives( spheres.second, timeBuckets,
+                        batch.timestampSpheresIndices[spheres.first] );
+    for( auto& cylinders: batch.cylinders )
+        sortPrimitives( cylinders.second, timeBuckets,
+                        batch.timestampCylindersIndices[cylinders.first] );
+    for( auto& cones: batch.cones )
+        sortPrimitives( cones.second, timeBuckets,
+                        batch.timestampConesIndices[cones.first] );
+
+    std::lock_guard< std::mutex > lock( _geometryBatchesMutex );
+    _pendingGeometryBatches.push_back( std::move( batch ));
+    return true;
+}
+
+bool Scene::commitGeometryBatches()
+{
+    std::list< GeometryBatch > batches;
+    strings removedBatches;
+    {
+        std::lock_guard< std::mutex > lock( _geometryBatchesMutex );
+        batches.swap( _pendingGeometryBatches );
+        removedBatches.swap( _removedGeometryBatches );
+    }
+    if( batches.empty() && removedBatches.empty( ))
+        return false;
+
+    // Scene bounds are kept as they are when batches are removed
+    for( const auto& name: removedBatches )
+    {
+        auto it = _geometryBatches.begin();
+        while( it != _geometryBatches.end( ))
+        {
+            if( it->name == name )
+            {
+                _removeGeometryBatch( *it );
+                it = _geometryBatches.erase( it );
+            }
+            else
+                ++it;
+        }
+    }
+
+    // Engines may share the primitive arrays of the batches, list nodes keep
+    // their address when spliced into the scene batches
+    for( auto& batch: batches )
+    {
+        _bounds.merge( batch.bounds );
+        _buildGeometryBatch( batch );
+    }
+    _geometryBatches.splice( _geometryBatches.end(), batches );
+    commit();
+    return true;
+}
+
+void Scene::removeGeometryBatches( const std::string& name )
+{
+    std::lock_guard< std::mutex > lock( _geometryBatchesMutex );
+
+    // Batches that are not committed yet are simply dropped
+    _pendingGeometryBatches.remove_if(
+        [&name]( const GeometryBatch& batch ) { return batch.name == name; });
+    _removedGeometryBatches.push_back( name );
+}
+
 void Scene::addLight( LightPtr light )
 {
     removeLight( light );
@@ -498,13 +576,23 @@ void Scene::clearLights( )
 SimulationDescriptorPtr Scene::getSimulationDescriptor()
 {
     const std::string& cacheFile = _geometryParameters.getSimulationCacheFile();
-    if( !_simulationDescriptor && !cacheFile.empty() )
+    if( !_simulationDescriptor && !cacheFile.empty() &&
+        cacheFile != _rejectedSimulationCacheFile )
     {
         if( cacheFile.empty() )
             return 0;
 
         _simulationDescriptor.reset( new SimulationDescriptor() );
-        _simulationDescriptor->attachSimulationToCacheFile( cacheFile );
+        _simulationDescriptor->setPrefetchFrames(
+            _geometryParameters.getSimulationPrefetchFrames( ));
+        _simulationDescriptor->setLockedFrames(
+            _geometryParameters.getSimulationLockedFrames( ));
+        if( !_simulationDescriptor->attachSimulationToCacheFile( cacheFile ))
+        {
+            // The cache is not attached again on the next frames
+            _simulationDescriptor.reset();
+            _rejectedSimulationCacheFile = cacheFile;
+        }
     }
     return _simulationDescriptor;
 }
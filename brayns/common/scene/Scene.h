@@ -28,12 +28,34 @@
 #include <brayns/common/geometry/Sphere.h>
 #include <brayns/common/geometry/Cylinder.h>
 #include <brayns/common/geometry/Cone.h>
+#include <brayns/common/geometry/GeometryTemplate.h>
 #include <brayns/common/geometry/TrianglesMesh.h>
 #include <brayns/common/transferFunction/TransferFunction.h>
 
+#include <atomic>
+#include <list>
+#include <mutex>
+
 namespace brayns
 {
 
+/** Primitives loaded by a background thread, and added to the scene between
+ * two frames. Primitives are organized per material, like the primitives of
+ * the scene, and sorted when the batch is queued. Batches with a name can be
+ * removed from the scene.
+ */
+struct GeometryBatch
+{
+    std::string name;
+    SpheresMap spheres;
+    CylindersMap cylinders;
+    ConesMap cones;
+    TimestampIndicesMap timestampSpheresIndices;
+    TimestampIndicesMap timestampCylindersIndices;
+    TimestampIndicesMap timestampConesIndices;
+    Boxf bounds;
+};
+
 /**
 
    Scene object
@@ -101,10 +123,67 @@ public:
     BRAYNS_API virtual void buildGeometry() = 0;
 
     /**
-        Attach simulation data to renderer
+        Attach the simulation data of the current timestamp to the renderers.
+        Nothing is done if the timestamp did not change since the last call,
+        so that it can be called before every frame
     */
     BRAYNS_API virtual void commitSimulationData() = 0;
 
+    /**
+        Attach the transfer function to the renderers. Must be called
+        whenever the transfer function is modified
+    */
+    BRAYNS_API virtual void commitTransferFunctionData() = 0;
+
+    /**
+        Selects the level of detail of every instance according to its size
+        on screen, as seen from the given camera
+        @param camera Camera used to render the scene
+    */
+    BRAYNS_API virtual void commitLevelsOfDetail( const Camera& camera ) = 0;
+
+    /**
+        Queues a batch of primitives loaded by a background thread. The batch
+        is added to the scene by the next call to commitGeometryBatches. This
+        method is thread safe.
+        @param batch Batch of primitives. Its content is moved to the scene
+        @return False if the scene does not accept batches anymore, in which
+                case loading should be stopped
+    */
+    BRAYNS_API bool addGeometryBatch( GeometryBatch& batch );
+
+    /**
+        Adds the queued batches to the scene and commits them to the rendering
+        engine. Must be called by the rendering thread, between two frames.
+        @return True if batches were added
+    */
+    BRAYNS_API bool commitGeometryBatches();
+
+    /**
+        Removes the batches of the given name from the scene. Batches that are
+        already committed are removed by the next call to
+        commitGeometryBatches. This method is thread safe.
+        @param name Name of the batches to remove
+    */
+    BRAYNS_API void removeGeometryBatches( const std::string& name );
+
+    /**
+        Stops accepting batches, so that background loading terminates.
+        Loaders also skip the data they have not loaded yet
+    */
+    BRAYNS_API void cancelLoading() { _loadingCancelled = true; }
+    BRAYNS_API bool isLoadingCancelled() const { return _loadingCancelled; }
+
+    /**
+        Progress of the data loaded in the background, from 0 to 1. The
+        progress is 1 when nothing is being loaded
+    */
+    BRAYNS_API float getLoadingProgress() const { return _loadingProgress; }
+    BRAYNS_API void setLoadingProgress( const float progress )
+    {
+        _loadingProgress = progress;
+    }
+
     /**
         Returns the bounding box for the whole scene
     */
@@ -153,7 +232,28 @@ public:
 
     BRAYNS_API GeometryParameters& getGeometryParameters() { return _geometryParameters; }
     BRAYNS_API SceneParameters& getSceneParameters() { return _sceneParameters; }
-    BRAYNS_API PrimitivesMap& getPrimitives() { return _primitives; }
+
+    /**
+        Primitives of the scene, stored per material in arrays that have the
+        memory layout expected by the rendering engine. Loaders append to
+        these arrays, and the engine directly shares them once the geometry
+        is built. They must therefore not be modified after buildGeometry
+        has been called.
+    */
+    BRAYNS_API SpheresMap& getSpheres() { return _spheres; }
+    BRAYNS_API CylindersMap& getCylinders() { return _cylinders; }
+    BRAYNS_API ConesMap& getCones() { return _cones; }
+
+    /**
+        Geometry templates and the instances placing them in the scene. Like
+        primitives, templates are shared with the engine and must not be
+        modified after buildGeometry has been called.
+    */
+    BRAYNS_API GeometryTemplates& getGeometryTemplates()
+    {
+        return _geometryTemplates;
+    }
+    BRAYNS_API Instances& getInstances() { return _instances; }
     BRAYNS_API Materials& getMaterials() { return _materials; }
     BRAYNS_API TexturesMap& getTextures() { return _textures; }
     BRAYNS_API TrianglesMeshMap& getTriangleMeshes() { return _trianglesMeshes; }
@@ -169,13 +269,30 @@ public:
     BRAYNS_API TransferFunction& getTransferFunction() { return _transferFunction; }
 
 protected:
+    /**
+        Converts the primitives of a batch into rendering engine specific data
+        structures, and adds them to the scene. The batch is kept by the scene
+        as long as the scene lives
+    */
+    virtual void _buildGeometryBatch( GeometryBatch& batch ) = 0;
+
+    /**
+        Removes the rendering engine specific data structures of a batch from
+        the scene
+    */
+    virtual void _removeGeometryBatch( GeometryBatch& batch ) = 0;
+
     // Parameters
     SceneParameters& _sceneParameters;
     GeometryParameters& _geometryParameters;
     Renderers _renderers;
 
     // Model
-    PrimitivesMap _primitives;
+    SpheresMap _spheres;
+    CylindersMap _cylinders;
+    ConesMap _cones;
+    GeometryTemplates _geometryTemplates;
+    Instances _instances;
     TrianglesMeshMap _trianglesMeshes;
     Materials _materials;
     TexturesMap _textures;
@@ -183,12 +300,21 @@ protected:
 
     // Simulation
     SimulationDescriptorPtr _simulationDescriptor;
+    std::string _rejectedSimulationCacheFile;
     TransferFunction _transferFunction;
 
     // Scene
     Boxf _bounds;
     bool _isEmpty;
 
+    // Background loading
+    std::mutex _geometryBatchesMutex;
+    std::list< GeometryBatch > _pendingGeometryBatches;
+    std::list< GeometryBatch > _geometryBatches;
+    strings _removedGeometryBatches;
+    std::atomic< bool > _loadingCancelled;
+    std::atomic< float > _loadingProgress;
+
 private:
 
     bool _attachSimulationCacheFile();
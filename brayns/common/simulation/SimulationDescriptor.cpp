@@ -22,10 +22,71 @@
 
 #include <brayns/common/log.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <limits>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+const uint64_t NO_FRAME = std::numeric_limits< uint64_t >::max();
+
+// Files without this magic are raw caches, made of the number of frames and
+// the frame size followed by 32-bit float frames. Version 1 adds the frame
+// encoding, version 2 the timing of the frames, the offset of every frame in
+// the file and the values of every cell
+const char CACHE_MAGIC[] = { 'B', 'R', 'A', 'Y', 'N', 'S', 'S', 'C' };
+const uint64_t CACHE_VERSION = 2;
+const uint64_t CACHE_HEADER_SIZE_V1 = sizeof( CACHE_MAGIC ) + 4 * sizeof( uint64_t );
+const uint64_t CACHE_HEADER_SIZE =
+    sizeof( CACHE_MAGIC ) + 5 * sizeof( uint64_t ) + 2 * sizeof( float );
+const uint64_t CELL_RECORD_SIZE = 3 * sizeof( uint64_t );
+const uint64_t QUANTIZATION_SIZE = 2 * sizeof( float );
+const uint64_t FRAME_ALIGNMENT = 8;
+
+// Adds count * size to sum, returns false if the result overflows
+bool _addProduct( uint64_t& sum, const uint64_t count, const uint64_t size )
+{
+    const uint64_t max = std::numeric_limits< uint64_t >::max();
+    if( size != 0 && count > ( max - sum ) / size )
+        return false;
+    sum += count * size;
+    return true;
+}
+
+uint64_t _getValueSize( const brayns::FrameEncoding encoding )
+{
+    switch( encoding )
+    {
+    case brayns::FE_UINT16:
+        return sizeof( uint16_t );
+    case brayns::FE_UINT8:
+        return sizeof( uint8_t );
+    default:
+        return sizeof( float );
+    }
+}
+
+template< typename T >
+void _quantizeValues(
+    const brayns::floats& values,
+    const float scale,
+    const float offset,
+    uint8_t* data )
+{
+    const float maxValue = std::numeric_limits< T >::max();
+    T* quantizedValues = reinterpret_cast< T* >( data );
+    for( size_t i = 0; i < values.size(); ++i )
+        quantizedValues[i] = scale > 0.f ?
+            T( std::min(( values[i] - offset ) / scale + 0.5f, maxValue )) : 0;
+}
+}
 
 namespace brayns
 {
@@ -34,20 +95,24 @@ SimulationDescriptor::SimulationDescriptor()
     : _headerSize( 0 )
     , _nbFrames( 0 )
     , _frameSize( 0 )
+    , _encoding( FE_FLOAT32 )
+    , _startTime( 0.f )
+    , _timestep( 1.f )
+    , _frameOffsets( 0 )
     , _memoryMapPtr( 0 )
     , _cacheFileDescriptor( -1 )
+    , _memoryMapSize( 0 )
+    , _nbPrefetchFrames( 0 )
+    , _nbLockedFrames( 0 )
+    , _currentFrame( NO_FRAME )
+    , _backward( false )
 {
 }
 
 SimulationDescriptor::~SimulationDescriptor()
 {
     if( _memoryMapPtr )
-    {
-        const uint64_t size =
-            _headerSize +
-            _frameSize * _nbFrames * sizeof(float);
-        ::munmap( (void *)_memoryMapPtr, size );
-    }
+        ::munmap( _memoryMapPtr, _memoryMapSize );
     if( _cacheFileDescriptor != -1 )
         ::close( _cacheFileDescriptor );
 }
@@ -78,14 +143,130 @@ bool SimulationDescriptor::attachSimulationToCacheFile( const std::string& cache
         ::close( _cacheFileDescriptor );
         return false;
     }
+    _memoryMapSize = sb.st_size;
+
+    // The header is validated before any member is set, so that a rejected
+    // cache leaves no frame to read
+    const char* data = (const char*)_memoryMapPtr;
+    uint64_t headerSize = 0;
+    uint64_t nbFrames = 0;
+    uint64_t frameSize = 0;
+    uint64_t encoding = FE_FLOAT32;
+    float startTime = 0.f;
+    float timestep = 1.f;
+    const uint64_t* frameOffsets = 0;
+    SimulationCells cells;
+    if( _memoryMapSize >= CACHE_HEADER_SIZE_V1 &&
+        ::memcmp( data, CACHE_MAGIC, sizeof( CACHE_MAGIC )) == 0 )
+    {
+        uint64_t header[5] = { 0 };
+        const uint64_t version = *(const uint64_t*)( data + sizeof( CACHE_MAGIC ));
+        headerSize = version == 1 ? CACHE_HEADER_SIZE_V1 : CACHE_HEADER_SIZE;
+        if(( version != 1 && version != CACHE_VERSION ) || _memoryMapSize < headerSize )
+        {
+            BRAYNS_ERROR << "Unsupported simulation cache version " << version
+                         << " in " << cacheFile << std::endl;
+            return false;
+        }
+        ::memcpy( header, data + sizeof( CACHE_MAGIC ),
+                  ( version == 1 ? 4 : 5 ) * sizeof( uint64_t ));
+        nbFrames = header[1];
+        frameSize = header[2];
+        encoding = header[3];
+        if( encoding > FE_UINT8 )
+        {
+            BRAYNS_ERROR << "Unsupported frame encoding " << encoding
+                         << " in " << cacheFile << std::endl;
+            return false;
+        }
 
-    _headerSize = 2 * sizeof( uint64_t );
+        if( version == CACHE_VERSION )
+        {
+            const uint64_t nbCells = header[4];
+            ::memcpy( &startTime, data + sizeof( CACHE_MAGIC ) + 5 * sizeof( uint64_t ),
+                      sizeof( float ));
+            ::memcpy( &timestep, data + sizeof( CACHE_MAGIC ) + 5 * sizeof( uint64_t ) +
+                      sizeof( float ), sizeof( float ));
+            if( !_addProduct( headerSize, nbFrames, sizeof( uint64_t )) ||
+                !_addProduct( headerSize, nbCells, CELL_RECORD_SIZE ) ||
+                _memoryMapSize < headerSize )
+            {
+                BRAYNS_ERROR << "Truncated simulation cache " << cacheFile << std::endl;
+                return false;
+            }
+            frameOffsets = (const uint64_t*)( data + CACHE_HEADER_SIZE );
 
-    strncpy((char *)&_nbFrames, (char *)_memoryMapPtr, sizeof( uint64_t ));
-    strncpy((char *)&_frameSize, ((char *)_memoryMapPtr + sizeof( uint64_t )), sizeof( uint64_t ));
+            const uint64_t* records = frameOffsets + nbFrames;
+            cells.resize( nbCells );
+            for( uint64_t i = 0; i < nbCells; ++i )
+            {
+                cells[i].gid = uint32_t( records[3 * i] );
+                cells[i].offset = records[3 * i + 1];
+                cells[i].size = records[3 * i + 2];
+                if( cells[i].offset > frameSize ||
+                    cells[i].size > frameSize - cells[i].offset )
+                {
+                    BRAYNS_ERROR << "Invalid values of cell " << cells[i].gid
+                                 << " in " << cacheFile << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    else
+    {
+        headerSize = 2 * sizeof( uint64_t );
+        if( _memoryMapSize < headerSize )
+        {
+            BRAYNS_ERROR << "Truncated simulation cache " << cacheFile << std::endl;
+            return false;
+        }
+        ::memcpy( &nbFrames, data, sizeof( uint64_t ));
+        ::memcpy( &frameSize, data + sizeof( uint64_t ), sizeof( uint64_t ));
+    }
+
+    // Every frame must be within the file. Frames of caches without frame
+    // offsets follow the header
+    const FrameEncoding frameEncoding = static_cast< FrameEncoding >( encoding );
+    if( nbFrames > 0 && frameSize > _memoryMapSize )
+    {
+        BRAYNS_ERROR << "Truncated simulation cache " << cacheFile << std::endl;
+        return false;
+    }
+    const uint64_t frameBytes = getFrameBytes( frameSize, frameEncoding );
+    if( frameOffsets )
+    {
+        for( uint64_t i = 0; i < nbFrames; ++i )
+            if( frameOffsets[i] > _memoryMapSize ||
+                frameBytes > _memoryMapSize - frameOffsets[i] )
+            {
+                BRAYNS_ERROR << "Truncated simulation cache " << cacheFile << std::endl;
+                return false;
+            }
+    }
+    else
+    {
+        uint64_t fileSize = headerSize;
+        if( !_addProduct( fileSize, nbFrames, frameBytes ) ||
+            fileSize > _memoryMapSize )
+        {
+            BRAYNS_ERROR << "Truncated simulation cache " << cacheFile << std::endl;
+            return false;
+        }
+    }
+
+    _headerSize = headerSize;
+    _nbFrames = nbFrames;
+    _frameSize = frameSize;
+    _encoding = frameEncoding;
+    _startTime = startTime;
+    _timestep = timestep;
+    _frameOffsets = frameOffsets;
+    _cells.swap( cells );
 
     BRAYNS_INFO << "Nb Frames: " << _nbFrames << std::endl;
     BRAYNS_INFO << "Frame size: " << _frameSize << std::endl;
+    BRAYNS_INFO << "Frame encoding: " << _encoding << std::endl;
 
     BRAYNS_INFO << "Successfully attached to " << cacheFile << std::endl;
     return true;
@@ -94,17 +275,98 @@ bool SimulationDescriptor::attachSimulationToCacheFile( const std::string& cache
 void SimulationDescriptor::writeHeader(
     std::ofstream& stream,
     uint64_t nbFrames,
-    uint64_t frameSize )
+    uint64_t frameSize,
+    const FrameEncoding encoding,
+    const float startTime,
+    const float timestep,
+    const SimulationCells& cells )
 {
-    stream.write( ( char* )&nbFrames, sizeof( uint64_t ));
-    stream.write( ( char* )&frameSize, sizeof( uint64_t ));
+    const uint64_t header[5] =
+        { CACHE_VERSION, nbFrames, frameSize, uint64_t( encoding ), cells.size() };
+    stream.write( CACHE_MAGIC, sizeof( CACHE_MAGIC ));
+    stream.write( ( char* )header, sizeof( header ));
+    stream.write( ( char* )&startTime, sizeof( float ));
+    stream.write( ( char* )&timestep, sizeof( float ));
+
+    // Frames are written one after the other after the header
+    const uint64_t headerSize =
+        CACHE_HEADER_SIZE + nbFrames * sizeof( uint64_t ) + cells.size() * CELL_RECORD_SIZE;
+    const uint64_t frameBytes = getFrameBytes( frameSize, encoding );
+    uint64_ts frameOffsets( nbFrames );
+    for( uint64_t i = 0; i < nbFrames; ++i )
+        frameOffsets[i] = headerSize + i * frameBytes;
+    stream.write( ( char* )frameOffsets.data(), frameOffsets.size() * sizeof( uint64_t ));
+
+    uint64_ts cellRecords;
+    cellRecords.reserve( 3 * cells.size( ));
+    for( const auto& cell: cells )
+    {
+        cellRecords.push_back( cell.gid );
+        cellRecords.push_back( cell.offset );
+        cellRecords.push_back( cell.size );
+    }
+    stream.write( ( char* )cellRecords.data(), cellRecords.size() * sizeof( uint64_t ));
 }
 
 void SimulationDescriptor::writeFrame(
     std::ofstream& stream,
-    const floats& values )
+    const floats& values,
+    const FrameEncoding encoding )
 {
-    stream.write( ( char* )values.data(), values.size() * sizeof(float) );
+    if( encoding == FE_FLOAT32 )
+    {
+        stream.write( ( char* )values.data(), values.size() * sizeof(float) );
+        return;
+    }
+
+    uint8_ts data;
+    encodeFrame( values, encoding, data );
+    stream.write( ( char* )data.data(), data.size( ));
+}
+
+void SimulationDescriptor::encodeFrame(
+    const floats& values,
+    const FrameEncoding encoding,
+    uint8_ts& data )
+{
+    data.assign( getFrameBytes( values.size(), encoding ), 0 );
+    if( encoding == FE_FLOAT32 )
+    {
+        ::memcpy( data.data(), values.data(), values.size() * sizeof( float ));
+        return;
+    }
+
+    // Values are stored as offset + scale * quantized value, with the range
+    // of the frame spread over all quantization levels
+    float offset = 0.f;
+    float scale = 0.f;
+    if( !values.empty( ))
+    {
+        const auto range = std::minmax_element( values.begin(), values.end( ));
+        const float levels = encoding == FE_UINT16 ?
+            std::numeric_limits< uint16_t >::max() : std::numeric_limits< uint8_t >::max();
+        offset = *range.first;
+        scale = ( *range.second - *range.first ) / levels;
+    }
+    ::memcpy( data.data(), &scale, sizeof( float ));
+    ::memcpy( data.data() + sizeof( float ), &offset, sizeof( float ));
+
+    uint8_t* quantizedValues = data.data() + 2 * sizeof( float );
+    if( encoding == FE_UINT16 )
+        _quantizeValues< uint16_t >( values, scale, offset, quantizedValues );
+    else
+        _quantizeValues< uint8_t >( values, scale, offset, quantizedValues );
+}
+
+uint64_t SimulationDescriptor::getFrameBytes(
+    const uint64_t frameSize,
+    const FrameEncoding encoding )
+{
+    if( encoding == FE_FLOAT32 )
+        return frameSize * sizeof( float );
+
+    const uint64_t bytes = QUANTIZATION_SIZE + frameSize * _getValueSize( encoding );
+    return ( bytes + FRAME_ALIGNMENT - 1 ) / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
 }
 
 void* SimulationDescriptor::getFramePointer( const uint64_t frame )
@@ -112,9 +374,201 @@ void* SimulationDescriptor::getFramePointer( const uint64_t frame )
     if( _nbFrames ==  0 )
         return 0;
 
-    uint64_t moduloFrame = frame % _nbFrames;
-    uint64_t index = std::min( _frameSize, std::max( uint64_t(0), moduloFrame ));
-    return (unsigned char*)_memoryMapPtr + _headerSize + index * _frameSize * sizeof(float);
+    _prefetch( frame );
+
+    return (unsigned char*)_memoryMapPtr + _getFrameOffset( frame % _nbFrames );
+}
+
+uint64_t SimulationDescriptor::_getFrameOffset( const uint64_t frameIndex ) const
+{
+    if( _frameOffsets )
+        return _frameOffsets[frameIndex];
+    return _headerSize + frameIndex * getFrameBytes();
+}
+
+bool SimulationDescriptor::saveSubset(
+    const std::string& cacheFile,
+    const float startTime,
+    const float endTime,
+    const std::set< uint32_t >& gids ) const
+{
+    if( !_memoryMapPtr )
+        return false;
+    if( !gids.empty() && _cells.empty( ))
+    {
+        BRAYNS_ERROR << "The simulation cache does not describe its cells, "
+                     << "cells cannot be extracted" << std::endl;
+        return false;
+    }
+
+    // Frames whose time is within the window
+    const double firstTime = std::max( 0.0, ( double( startTime ) - _startTime ) / _timestep );
+    const double lastTime = ( double( endTime ) - _startTime ) / _timestep;
+    const uint64_t firstFrame = std::min( uint64_t( std::ceil( firstTime )), _nbFrames );
+    const uint64_t endFrame = lastTime < 0.0 ? 0 :
+        std::min( uint64_t( std::min( std::floor( lastTime ) + 1.0, double( _nbFrames ))),
+                  _nbFrames );
+    const uint64_t nbFrames = endFrame > firstFrame ? endFrame - firstFrame : 0;
+
+    // Values of the selected cells are packed in the order of the cache
+    SimulationCells cells;
+    uint64_t frameSize = _frameSize;
+    if( !gids.empty( ))
+    {
+        frameSize = 0;
+        for( const auto& cell: _cells )
+            if( gids.find( cell.gid ) != gids.end( ))
+            {
+                cells.push_back( cell );
+                frameSize += cell.size;
+            }
+    }
+    else
+        cells = _cells;
+
+    std::ofstream file( cacheFile, std::ios::out | std::ios::binary );
+    if( !file.is_open( ))
+    {
+        BRAYNS_ERROR << "Failed to create " << cacheFile << std::endl;
+        return false;
+    }
+
+    SimulationCells packedCells = cells;
+    if( !gids.empty( ))
+    {
+        uint64_t offset = 0;
+        for( auto& cell: packedCells )
+        {
+            cell.offset = offset;
+            offset += cell.size;
+        }
+    }
+    writeHeader( file, nbFrames, frameSize, _encoding,
+                 _startTime + firstFrame * _timestep, _timestep, packedCells );
+
+    const uint64_t valueSize = _getValueSize( _encoding );
+    const uint64_t quantizationSize = _encoding == FE_FLOAT32 ? 0 : QUANTIZATION_SIZE;
+    uint8_ts frame( getFrameBytes( frameSize, _encoding ));
+    for( uint64_t i = 0; i < nbFrames && file.good(); ++i )
+    {
+        BRAYNS_PROGRESS( i, nbFrames );
+        const uint8_t* source =
+            (const uint8_t*)_memoryMapPtr + _getFrameOffset( firstFrame + i );
+        if( gids.empty( ))
+        {
+            file.write( (const char*)source, frame.size( ));
+            continue;
+        }
+
+        ::memcpy( frame.data(), source, quantizationSize );
+        uint8_t* destination = frame.data() + quantizationSize;
+        for( const auto& cell: cells )
+        {
+            ::memcpy( destination, source + quantizationSize + cell.offset * valueSize,
+                      cell.size * valueSize );
+            destination += cell.size * valueSize;
+        }
+        file.write( (const char*)frame.data(), frame.size( ));
+    }
+    file.close();
+
+    if( !file )
+    {
+        BRAYNS_ERROR << "Failed to write " << cacheFile << std::endl;
+        std::remove( cacheFile.c_str( ));
+        return false;
+    }
+
+    BRAYNS_INFO << "Saved " << nbFrames << " frames of " << frameSize
+                << " values to " << cacheFile << std::endl;
+    return true;
+}
+
+void SimulationDescriptor::_prefetch( const uint64_t frame )
+{
+    if( frame == _currentFrame || ( _nbPrefetchFrames == 0 && _nbLockedFrames == 0 ))
+        return;
+
+    // Playback direction is given by the last two requested frames, and kept
+    // until the playback turns around
+    if( _currentFrame != NO_FRAME )
+        _backward = frame < _currentFrame;
+    _currentFrame = frame;
+
+    const uint64_t frameIndex = frame % _nbFrames;
+    if( _nbLockedFrames > 0 )
+        _lock( frameIndex );
+
+    if( _nbPrefetchFrames == 0 )
+        return;
+
+    // Frames within the prefetch distance of the requested frame are kept in
+    // memory, in both directions so that turning around does not stall. Only
+    // the frames ahead are read
+    std::set< uint64_t > residentFrames;
+    const uint64_t nbFrames = std::min( uint64_t( _nbPrefetchFrames ), _nbFrames );
+    for( uint64_t i = 0; i < nbFrames; ++i )
+    {
+        const uint64_t ahead = _backward ?
+            ( frameIndex + _nbFrames - i ) % _nbFrames : ( frameIndex + i ) % _nbFrames;
+        const uint64_t behind = _backward ?
+            ( frameIndex + i ) % _nbFrames : ( frameIndex + _nbFrames - i ) % _nbFrames;
+        if( _residentFrames.find( ahead ) == _residentFrames.end( ))
+            _advise( ahead, MADV_WILLNEED );
+        residentFrames.insert( ahead );
+        residentFrames.insert( behind );
+    }
+
+    for( const auto residentFrame: _residentFrames )
+        if( residentFrames.find( residentFrame ) == residentFrames.end() &&
+            std::find( _lockedFrames.begin(), _lockedFrames.end(),
+                       residentFrame ) == _lockedFrames.end( ))
+        {
+            _advise( residentFrame, MADV_DONTNEED );
+        }
+    _residentFrames.swap( residentFrames );
+}
+
+void SimulationDescriptor::_lock( const uint64_t frameIndex )
+{
+    if( std::find( _lockedFrames.begin(), _lockedFrames.end(), frameIndex ) !=
+        _lockedFrames.end( ))
+    {
+        return;
+    }
+
+    const uint64_t frameBytes = getFrameBytes();
+    unsigned char* data = (unsigned char*)_memoryMapPtr;
+    if( ::mlock( data + _getFrameOffset( frameIndex ), frameBytes ) == -1 )
+    {
+        BRAYNS_WARN << "Failed to lock simulation frames in memory, "
+                    << "frame locking is disabled" << std::endl;
+        for( const auto lockedFrame: _lockedFrames )
+            ::munlock( data + _getFrameOffset( lockedFrame ), frameBytes );
+        _lockedFrames.clear();
+        _nbLockedFrames = 0;
+        return;
+    }
+
+    _lockedFrames.push_back( frameIndex );
+    if( _lockedFrames.size() > _nbLockedFrames )
+    {
+        ::munlock( data + _getFrameOffset( _lockedFrames.front( )), frameBytes );
+        _lockedFrames.pop_front();
+    }
+}
+
+void SimulationDescriptor::_advise( const uint64_t frameIndex, const int advice )
+{
+    // Advice applies to whole pages, the frame range is extended to the pages it overlaps
+    static const uint64_t pageSize = ::sysconf( _SC_PAGESIZE );
+    const uint64_t begin = _getFrameOffset( frameIndex );
+    const uint64_t end = std::min( begin + getFrameBytes(), _memoryMapSize );
+    if( begin >= end )
+        return;
+
+    const uint64_t pageBegin = begin / pageSize * pageSize;
+    ::madvise( (unsigned char*)_memoryMapPtr + pageBegin, end - pageBegin, advice );
 }
 
 }
@@ -24,16 +24,28 @@
 #include <brayns/api.h>
 #include <brayns/common/types.h>
 
+#include <deque>
+#include <set>
+
 namespace brayns
 {
 
+/** Values of a cell within the simulation frames */
+struct SimulationCell
+{
+    uint32_t gid;
+    uint64_t offset; // Index of the first value of the cell in a frame
+    uint64_t size;   // Number of values of the cell
+};
+typedef std::vector< SimulationCell > SimulationCells;
+
 class SimulationDescriptor
 {
 
 public:
 
-    SimulationDescriptor();
-    ~SimulationDescriptor();
+    BRAYNS_API SimulationDescriptor();
+    BRAYNS_API ~SimulationDescriptor();
 
     /**
     * @brief Attaches a memory mapped file to the scene so that renderers can access the data
@@ -45,25 +57,51 @@ public:
     BRAYNS_API bool attachSimulationToCacheFile( const std::string& cacheFile );
 
     /**
-    * @brief Writes the header to a stream. The header contains the number of frames and the frame
-    *        size.
+    * @brief Writes the header to a stream. The header contains the number of frames, the frame
+    *        size, the encoding of the frame values, the time of the frames, the offset of every
+    *        frame in the file and the values of every cell. Frames must then be written in
+    *        order.
     * @param stream Stream where the header should be written
     * @param nbFrames Number of frames
     * @param frameSize Frame size
+    * @param encoding Encoding of the frame values
+    * @param startTime Simulation time of the first frame
+    * @param timestep Simulation time between two frames
+    * @param cells Values of every cell in the frames, empty if unknown
     */
     BRAYNS_API static void writeHeader(
         std::ofstream& stream,
         uint64_t nbFrames,
-        uint64_t frameSize );
+        uint64_t frameSize,
+        FrameEncoding encoding = FE_FLOAT32,
+        float startTime = 0.f,
+        float timestep = 1.f,
+        const SimulationCells& cells = SimulationCells( ));
 
     /**
-    * @brief Writes a frame to a stream. A frame is a set of float values.
+    * @brief Writes a frame to a stream. A frame is a set of float values. Quantized frames start
+    *        with the scale and offset of the frame, followed by the quantized values, and are
+    *        padded to 8 bytes.
     * @param stream Stream where the header should be written
     * @param value Frame values
+    * @param encoding Encoding of the frame values, as written in the header
     */
     BRAYNS_API static void writeFrame(
         std::ofstream& stream,
-        const floats& values );
+        const floats& values,
+        FrameEncoding encoding = FE_FLOAT32 );
+
+    /**
+    * @brief Encodes a frame as it is written by writeFrame, so that frames can be encoded by
+    *        several threads and written in larger blocks.
+    * @param values Frame values
+    * @param encoding Encoding of the frame values, as written in the header
+    * @param data Resulting bytes, resized to getFrameBytes()
+    */
+    BRAYNS_API static void encodeFrame(
+        const floats& values,
+        FrameEncoding encoding,
+        uint8_ts& data );
 
     /**
      * @brief Returns the size of a given frame
@@ -73,19 +111,101 @@ public:
     uint64_t getFrameSize( const uint64_t ) { return _frameSize; }
 
     /**
-     * @brief Returns a pointer to a given frame in the memory mapped file.
+     * @brief Returns the number of frames
+     */
+    uint64_t getNbFrames() const { return _nbFrames; }
+
+    /**
+     * @brief Returns the simulation time of the first frame, 0 if the cache does not record it
+     */
+    float getStartTime() const { return _startTime; }
+
+    /**
+     * @brief Returns the simulation time between two frames, 1 if the cache does not record it
+     */
+    float getTimestep() const { return _timestep; }
+
+    /**
+     * @brief Returns the values of every cell in the frames, empty if the cache does not
+     *        record them
+     */
+    const SimulationCells& getCells() const { return _cells; }
+
+    /**
+     * @brief Returns the encoding of the frame values
+     */
+    FrameEncoding getFrameEncoding() const { return _encoding; }
+
+    /**
+     * @brief Returns the number of bytes occupied by a frame in the file, including the scale and
+     *        offset of quantized frames
+     */
+    uint64_t getFrameBytes() const { return getFrameBytes( _frameSize, _encoding ); }
+    BRAYNS_API static uint64_t getFrameBytes( uint64_t frameSize, FrameEncoding encoding );
+
+    /**
+     * @brief Returns a pointer to a given frame in the memory mapped file. When the requested frame
+     *        changes, the frames that follow it in the direction of the playback are read ahead,
+     *        and the frames left behind are released from memory.
      * @param frame Frame number
      * @return Pointer to given frame
      */
-    void* getFramePointer( const uint64_t frame );
+    BRAYNS_API void* getFramePointer( const uint64_t frame );
+
+    /**
+     * @brief Sets the number of frames read ahead of the requested frame. Frames that are further
+     *        away from the requested frame are released from memory.
+     * @param nbFrames Number of frames, 0 to disable prefetching
+     */
+    void setPrefetchFrames( const size_t nbFrames ) { _nbPrefetchFrames = nbFrames; }
+
+    /**
+     * @brief Sets the number of the most recently requested frames that are locked in memory.
+     * @param nbFrames Number of frames, 0 to disable locking
+     */
+    void setLockedFrames( const size_t nbFrames ) { _nbLockedFrames = nbFrames; }
+
+    /**
+     * @brief Saves the frames within a time window and the values of a subset of the cells to a
+     *        new cache file, with the same encoding. Values are copied from this cache, no
+     *        report is read.
+     * @param cacheFile File of the new cache
+     * @param startTime Simulation time of the first frame to save
+     * @param endTime Simulation time of the last frame to save
+     * @param gids Cells to save, all cells if empty. Requires a cache recording its cells
+     * @return True if the file was successfully saved, false otherwise
+     */
+    BRAYNS_API bool saveSubset(
+        const std::string& cacheFile,
+        float startTime,
+        float endTime,
+        const std::set< uint32_t >& gids ) const;
 
 private:
 
+    uint64_t _getFrameOffset( uint64_t frameIndex ) const;
+    void _prefetch( uint64_t frame );
+    void _lock( uint64_t frameIndex );
+    void _advise( uint64_t frameIndex, int advice );
+
     uint64_t _headerSize;
     uint64_t _nbFrames;
     uint64_t _frameSize;
+    FrameEncoding _encoding;
+    float _startTime;
+    float _timestep;
+    const uint64_t* _frameOffsets;
+    SimulationCells _cells;
     void* _memoryMapPtr;
     int _cacheFileDescriptor;
+    uint64_t _memoryMapSize;
+
+    size_t _nbPrefetchFrames;
+    size_t _nbLockedFrames;
+    uint64_t _currentFrame;
+    bool _backward;
+    std::set< uint64_t > _residentFrames;
+    std::deque< uint64_t > _lockedFrames;
 
 };
 
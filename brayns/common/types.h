@@ -84,26 +84,30 @@ typedef std::shared_ptr<ExtensionController> ExtensionControllerPtr;
 class Geometry;
 typedef std::vector< Geometry* > Geometries;
 
-class Primitive;
-typedef std::shared_ptr<Primitive> PrimitivePtr;
-typedef std::vector<PrimitivePtr> Primitives;
-typedef std::map<size_t, Primitives> PrimitivesMap;
-
-class Sphere;
-typedef std::shared_ptr<Sphere> SpherePtr;
-typedef std::vector<SpherePtr> Spheres;
+struct Sphere;
+typedef std::vector<Sphere> Spheres;
 typedef std::map<size_t, Spheres> SpheresMap;
 
-class Cylinder;
-typedef std::shared_ptr<Cylinder> CylinderPtr;
-typedef std::vector<CylinderPtr> Cylinders;
+struct Cylinder;
+typedef std::vector<Cylinder> Cylinders;
 typedef std::map<size_t, Cylinders> CylindersMap;
 
-class Cone;
-typedef std::shared_ptr<Cone> ConePtr;
-typedef std::vector<ConePtr> Cones;
+struct Cone;
+typedef std::vector<Cone> Cones;
 typedef std::map<size_t, Cones> ConesMap;
 
+/** Index of the last primitive (exclusive) for every timestamp */
+typedef std::map< size_t, size_t > TimestampIndices;
+typedef std::map< size_t, TimestampIndices > TimestampIndicesMap;
+
+struct GeometryBatch;
+
+struct GeometryTemplate;
+typedef std::vector<GeometryTemplate> GeometryTemplates;
+
+struct Instance;
+typedef std::vector<Instance> Instances;
+
 class TrianglesMesh;
 typedef std::map<size_t, TrianglesMesh> TrianglesMeshMap;
 
@@ -184,6 +188,14 @@ enum SceneEnvironment
     SE_BOUNDING_BOX
 };
 
+/** Encoding of the values of simulation frames in cache files */
+enum FrameEncoding
+{
+    FE_FLOAT32 = 0,    // Raw 32-bit floats
+    FE_UINT16,         // 16-bit values, with a scale and offset per frame
+    FE_UINT8           // 8-bit values, with a scale and offset per frame
+};
+
 /** Define light types */
 enum LightType
 {
@@ -0,0 +1,116 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "FilePrefetcher.h"
+
+#include <brayns/common/log.h>
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+const size_t READ_BUFFER_SIZE = 1 << 20;
+}
+
+namespace brayns
+{
+
+FilePrefetcher::FilePrefetcher(
+    const strings& filenames,
+    const size_t depth,
+    const size_t nbThreads )
+    : _filenames( filenames )
+    , _depth( depth )
+    , _next( 0 )
+    , _consumed( 0 )
+    , _stopped( false )
+{
+    for( size_t i = 0; i < std::max( nbThreads, size_t( 1 )); ++i )
+        _threads.push_back( std::thread( &FilePrefetcher::_prefetch, this ));
+}
+
+FilePrefetcher::~FilePrefetcher()
+{
+    {
+        std::lock_guard< std::mutex > lock( _mutex );
+        _stopped = true;
+    }
+    _condition.notify_all();
+    for( auto& thread: _threads )
+        thread.join();
+}
+
+void FilePrefetcher::consumed()
+{
+    {
+        std::lock_guard< std::mutex > lock( _mutex );
+        ++_consumed;
+    }
+    _condition.notify_one();
+}
+
+void FilePrefetcher::_prefetch()
+{
+    std::vector< char > buffer( READ_BUFFER_SIZE );
+    while( true )
+    {
+        std::string filename;
+        {
+            std::unique_lock< std::mutex > lock( _mutex );
+            _condition.wait( lock, [this]
+            {
+                return _stopped || _next >= _filenames.size() ||
+                       _next < _consumed + _depth;
+            });
+            if( _stopped || _next >= _filenames.size( ))
+                return;
+
+            filename = _filenames[_next++];
+            if( filename.empty() || !_prefetched.insert( filename ).second )
+                continue;
+        }
+        _read( filename, buffer );
+    }
+}
+
+void FilePrefetcher::_read(
+    const std::string& filename,
+    std::vector< char >& buffer )
+{
+    const int fd = ::open( filename.c_str(), O_RDONLY );
+    if( fd == -1 )
+    {
+        BRAYNS_DEBUG << "Could not prefetch " << filename << std::endl;
+        return;
+    }
+
+    // The content is discarded, reading the file is what brings it to the
+    // page cache. Readahead hints help local file systems, networked file
+    // systems usually only fetch what is actually read
+    ::posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+    ::posix_fadvise( fd, 0, 0, POSIX_FADV_WILLNEED );
+    while( ::read( fd, buffer.data(), buffer.size( )) > 0 ) {}
+    ::close( fd );
+}
+
+}
@@ -0,0 +1,84 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FILEPREFETCHER_H
+#define FILEPREFETCHER_H
+
+#include <brayns/api.h>
+#include <brayns/common/types.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+namespace brayns
+{
+
+/** Reads files in background threads, ahead of the threads that consume
+ * them, so that the consumers find the files in the page cache of the
+ * operating system. This hides the latency of networked file systems for
+ * readers, like Brion, that can only load files by name.
+ *
+ * Files are read in the order of the list, at most depth files ahead of the
+ * number of files reported as consumed. Empty and already read file names
+ * are skipped.
+ */
+class FilePrefetcher
+{
+public:
+    /**
+     * @param filenames Files in the order they are consumed
+     * @param depth Maximum number of files read ahead of the consumers
+     * @param nbThreads Number of reading threads
+     */
+    BRAYNS_API FilePrefetcher(
+        const strings& filenames,
+        size_t depth,
+        size_t nbThreads );
+
+    /** Stops reading files, and waits for the reading threads */
+    BRAYNS_API ~FilePrefetcher();
+
+    /** Reports that a file of the list was consumed, allowing one more file
+     * to be read
+     */
+    BRAYNS_API void consumed();
+
+private:
+    void _prefetch();
+    void _read( const std::string& filename, std::vector< char >& buffer );
+
+    const strings _filenames;
+    const size_t _depth;
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    size_t _next;
+    size_t _consumed;
+    bool _stopped;
+    std::unordered_set< std::string > _prefetched;
+
+    std::vector< std::thread > _threads;
+};
+
+}
+
+#endif // FILEPREFETCHER_H
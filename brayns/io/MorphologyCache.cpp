@@ -0,0 +1,89 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "MorphologyCache.h"
+
+#include <iterator>
+
+namespace brayns
+{
+
+size_t MorphologyData::getMemorySize() const
+{
+    return sizeof( MorphologyData ) +
+           sections.capacity() * sizeof( MorphologySection ) +
+           samples.capacity() * sizeof( Vector4f ) +
+           sampleDistancesToSoma.capacity() * sizeof( float );
+}
+
+MorphologyCache::MorphologyCache( const size_t maxSize )
+    : _maxSize( maxSize )
+    , _size( 0 )
+{
+}
+
+MorphologyDataPtr MorphologyCache::get( const std::string& uri )
+{
+    std::lock_guard< std::mutex > lock( _mutex );
+    auto entry = _entries.find( uri );
+    if( entry == _entries.end( ))
+        return MorphologyDataPtr();
+
+    _usage.splice( _usage.end(), _usage, entry->second.position );
+    return entry->second.morphology;
+}
+
+void MorphologyCache::insert(
+    const std::string& uri,
+    MorphologyDataPtr morphology )
+{
+    const size_t size = morphology->getMemorySize();
+    if( size > _maxSize )
+        return;
+
+    std::lock_guard< std::mutex > lock( _mutex );
+    auto entry = _entries.find( uri );
+    if( entry != _entries.end( ))
+    {
+        _size -= entry->second.morphology->getMemorySize();
+        _usage.erase( entry->second.position );
+        _entries.erase( entry );
+    }
+
+    while( _size + size > _maxSize )
+    {
+        auto leastRecentlyUsed = _entries.find( _usage.front( ));
+        _size -= leastRecentlyUsed->second.morphology->getMemorySize();
+        _entries.erase( leastRecentlyUsed );
+        _usage.pop_front();
+    }
+
+    _usage.push_back( uri );
+    _entries[uri] = { morphology, std::prev( _usage.end( )) };
+    _size += size;
+}
+
+size_t MorphologyCache::getSize() const
+{
+    std::lock_guard< std::mutex > lock( _mutex );
+    return _size;
+}
+
+}
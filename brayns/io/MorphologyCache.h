@@ -0,0 +1,120 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MORPHOLOGYCACHE_H
+#define MORPHOLOGYCACHE_H
+
+#include <brayns/api.h>
+#include <brayns/common/types.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace brayns
+{
+
+/** Section of a parsed morphology. The samples of the section are stored in
+ * the arrays of the morphology, starting at firstSample
+ */
+struct MorphologySection
+{
+    // Section type, as defined by the SWC format (1: soma, 2: axon,
+    // 3: dendrite, 4: apical dendrite)
+    size_t type;
+    float distanceToSoma;
+    size_t firstSample;
+    size_t nbSamples;
+};
+typedef std::vector< MorphologySection > MorphologySections;
+
+/** Parsed morphology, in the local frame of the morphology file. Sections are
+ * sorted by identifier, and their samples are stored in contiguous arrays, so
+ * that cells sharing the morphology only have to transform them.
+ */
+struct MorphologyData
+{
+    Vector3f somaCentroid;
+    float somaMeanRadius;
+    Boxf bounds;
+    MorphologySections sections;
+    // x, y, z and diameter of every sample
+    Vector4fs samples;
+    // Distance of every sample to the start of its section
+    floats sampleDistancesToSoma;
+
+    /** Returns the memory used by the morphology, in bytes */
+    BRAYNS_API size_t getMemorySize() const;
+};
+typedef std::shared_ptr< const MorphologyData > MorphologyDataPtr;
+
+/** Thread safe cache of parsed morphologies, keyed by URI. When the memory
+ * used by the cached morphologies exceeds the size of the cache, the least
+ * recently used morphologies are released. Threads that miss the same
+ * morphology at the same time both parse it, the last one being cached.
+ */
+class MorphologyCache
+{
+public:
+    /**
+     * @param maxSize Maximum memory used by the cached morphologies, in bytes
+     */
+    BRAYNS_API explicit MorphologyCache( size_t maxSize );
+
+    /** Returns a cached morphology
+     *
+     * @param uri URI of the morphology file
+     * @return The morphology, or an empty pointer if it is not cached
+     */
+    BRAYNS_API MorphologyDataPtr get( const std::string& uri );
+
+    /** Adds a morphology to the cache. Morphologies larger than the cache are
+     * not cached
+     *
+     * @param uri URI of the morphology file
+     * @param morphology Parsed morphology
+     */
+    BRAYNS_API void insert(
+        const std::string& uri,
+        MorphologyDataPtr morphology );
+
+    /** Returns the memory used by the cached morphologies, in bytes */
+    BRAYNS_API size_t getSize() const;
+
+private:
+    typedef std::list< std::string > URIs;
+    struct Entry
+    {
+        MorphologyDataPtr morphology;
+        URIs::iterator position;
+    };
+
+    mutable std::mutex _mutex;
+    const size_t _maxSize;
+    size_t _size;
+    // Least recently used URIs first
+    URIs _usage;
+    std::unordered_map< std::string, Entry > _entries;
+};
+
+}
+
+#endif // MORPHOLOGYCACHE_H
@@ -26,9 +26,22 @@
 #include <brayns/common/geometry/Cone.h>
 #include <brayns/common/scene/Scene.h>
 #include <brayns/common/simulation/SimulationDescriptor.h>
+#include <brayns/io/FilePrefetcher.h>
+#include <brayns/io/SWCParser.h>
+
+#include <boost/filesystem.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
 #include <fstream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <thread>
 
 #ifdef BRAYNS_USE_BRION
 #  include <brain/brain.h>
@@ -38,31 +51,303 @@
 namespace brayns
 {
 
+namespace
+{
+template< typename T >
+void _appendPrimitives(
+    std::map< size_t, std::vector< T >>& source,
+    std::map< size_t, std::vector< T >>& destination )
+{
+    for( auto& primitives: source )
+    {
+        std::vector< T >& target = destination[primitives.first];
+        if( target.empty( ))
+            target.swap( primitives.second );
+        else
+            target.insert( target.end(),
+                primitives.second.begin(), primitives.second.end( ));
+    }
+    source.clear();
+}
+
+/** Primitives and bounds of one cell. Cells are loaded by any thread into
+ * their own staging area, and merged into the scene in the order of the cells
+ * so that the result does not depend on the number of threads.
+ */
+struct CellPrimitives
+{
+    SpheresMap spheres;
+    CylindersMap cylinders;
+    ConesMap cones;
+    Boxf bounds;
+    float maxDistanceToSoma = 0.f;
+    bool loaded = false;
+};
+typedef std::vector< CellPrimitives > CellsPrimitives;
+
+template< typename T >
+void _appendPrimitives(
+    CellsPrimitives& cells,
+    std::map< size_t, std::vector< T >> CellPrimitives::* primitives,
+    std::map< size_t, std::vector< T >>& destination )
+{
+    std::map< size_t, size_t > sizes;
+    for( const auto& cell: cells )
+        for( const auto& material: cell.*primitives )
+            sizes[material.first] += material.second.size();
+
+    // Destination containers are created upfront, every material is then
+    // filled by one thread, in the order of the cells
+    std::vector< std::pair< std::vector< T >*, size_t >> targets;
+    size_ts materials;
+    for( const auto& size: sizes )
+    {
+        materials.push_back( size.first );
+        targets.push_back( std::make_pair( &destination[size.first],
+                                           size.second ));
+    }
+
+    #pragma omp parallel for schedule( dynamic )
+    for( size_t i = 0; i < materials.size(); ++i )
+    {
+        std::vector< T >& target = *targets[i].first;
+        target.reserve( target.size() + targets[i].second );
+        for( auto& cell: cells )
+        {
+            auto it = ( cell.*primitives ).find( materials[i] );
+            if( it == ( cell.*primitives ).end( ))
+                continue;
+            target.insert( target.end(),
+                           it->second.begin(), it->second.end( ));
+            std::vector< T >().swap( it->second );
+        }
+    }
+}
+
+void _mergeCells(
+    CellsPrimitives& cells,
+    SpheresMap& spheres,
+    CylindersMap& cylinders,
+    ConesMap& cones,
+    Boxf& bounds )
+{
+    for( const auto& cell: cells )
+        if( cell.loaded )
+            bounds.merge( cell.bounds );
+    _appendPrimitives( cells, &CellPrimitives::spheres, spheres );
+    _appendPrimitives( cells, &CellPrimitives::cylinders, cylinders );
+    _appendPrimitives( cells, &CellPrimitives::cones, cones );
+    cells.clear();
+}
+
+void _mergeCells( CellsPrimitives& cells, Scene& scene )
+{
+    _mergeCells( cells, scene.getSpheres(), scene.getCylinders(),
+                 scene.getCones(), scene.getWorldBounds( ));
+}
+
+/** Without compartment report, the simulation value of a primitive is the
+ * offset of its cell plus its distance to the soma, which is also its
+ * timestamp.
+ */
+template< typename T >
+void _setSimulationOffset(
+    std::map< size_t, std::vector< T >>& primitives,
+    const size_t simulationOffset )
+{
+    for( auto& material: primitives )
+        for( auto& primitive: material.second )
+            primitive.value = simulationOffset + primitive.timestamp;
+}
+
+void _mergeTransformedBounds(
+    const Boxf& bounds,
+    const Matrix4f& transformation,
+    Boxf& destination )
+{
+    if( bounds.isEmpty( ))
+        return;
+
+    const Vector3f& min = bounds.getMin();
+    const Vector3f& max = bounds.getMax();
+    for( size_t i = 0; i < 8; ++i )
+    {
+        const Vector3f corner(
+            ( i & 1 ) ? max.x() : min.x(),
+            ( i & 2 ) ? max.y() : min.y(),
+            ( i & 4 ) ? max.z() : min.z( ));
+        destination.merge( transformation * corner );
+    }
+}
+
+const size_t SWC_SECTION_SOMA = 1;
+
+/** Returns the MorphologySectionType flag of an SWC section type */
+size_t _sectionTypeFlag( const size_t sectionType )
+{
+    if( sectionType == 0 || sectionType > 4 )
+        return MST_UNDEFINED;
+    return size_t( 1 ) << ( sectionType - 1 );
+}
+
+Vector3f _transform( const Matrix4f& transformation, const Vector4f& sample )
+{
+    return transformation * Vector3f( sample.x(), sample.y(), sample.z( ));
+}
+
+/** Step between the samples of a section that are turned into geometry */
+size_t _getSampleStep(
+    const GeometryQuality geometryQuality,
+    const size_t nbSamples )
+{
+    switch( geometryQuality )
+    {
+        case GQ_FAST:
+            return nbSamples - 1;
+        case GQ_QUALITY:
+            return std::max( nbSamples / 2, size_t( 1 ));
+        default:
+            return 1;
+    }
+}
+
+/** Largest distance to the soma of the samples that are turned into
+ *  geometry, without building the geometry */
+float _getMaxDistanceToSoma(
+    const MorphologyData& morphology,
+    const GeometryQuality geometryQuality,
+    const size_t morphologySectionTypes )
+{
+    float maxDistanceToSoma = 0.f;
+    for( const auto& section: morphology.sections )
+    {
+        if( !( morphologySectionTypes & _sectionTypeFlag( section.type )) ||
+            section.nbSamples < 2 )
+        {
+            continue;
+        }
+
+        const float* distancesToSoma =
+            &morphology.sampleDistancesToSoma[section.firstSample];
+        const float distanceToSoma = section.distanceToSoma;
+        const size_t step =
+            _getSampleStep( geometryQuality, section.nbSamples );
+        for( size_t i = step; i < section.nbSamples + step; i += step )
+        {
+            const size_t sample = std::min( i, section.nbSamples - 1 );
+            maxDistanceToSoma = std::max( maxDistanceToSoma,
+                distanceToSoma + distancesToSoma[sample] );
+        }
+    }
+    return maxDistanceToSoma;
+}
+
+/** Without compartment report, every loaded cell shifts the simulation offset
+ *  of the next cells by its maximum distance to the soma. Cells that failed
+ *  to load have a negative distance.
+ */
+size_ts _accumulateSimulationOffsets(
+    const floats& maxDistancesToSoma,
+    size_t& simulationOffset )
+{
+    size_ts simulationOffsets( maxDistancesToSoma.size( ));
+    for( size_t i = 0; i < maxDistancesToSoma.size(); ++i )
+    {
+        simulationOffsets[i] = simulationOffset;
+        if( maxDistancesToSoma[i] >= 0.f )
+            simulationOffset += maxDistancesToSoma[i];
+    }
+    return simulationOffsets;
+}
+}
+
 MorphologyLoader::MorphologyLoader(
         const GeometryParameters& geometryParameters )
     : _geometryParameters(geometryParameters)
 {
+    const size_t cacheSize = geometryParameters.getMorphologyCacheSize();
+    if( cacheSize > 0 )
+        _morphologyCache.reset( new MorphologyCache( cacheSize << 20 ));
+
+    const std::string& storeFile = geometryParameters.getMorphologyStore();
+    if( !storeFile.empty( ))
+    {
+        _morphologyStore.reset( new MorphologyStore );
+        if( !_morphologyStore->open( storeFile ))
+            _morphologyStore.reset();
+    }
 }
 
-#ifdef BRAYNS_USE_BRION
 bool MorphologyLoader::importMorphology(
     const servus::URI& uri,
     const int morphologyIndex,
     Scene& scene)
 {
     float maxDistanceToSoma;
+    ParallelSceneContainer container =
+        { scene.getSpheres(), scene.getCylinders(), scene.getCones() };
     return _importMorphology(
         uri, morphologyIndex, Matrix4f(),
-        0, scene.getPrimitives(),
+        _geometryParameters.getGeometryQuality(),
+        _geometryParameters.getMorphologySectionTypes(),
+        0, container,
         scene.getWorldBounds(), 0, maxDistanceToSoma);
 }
 
+bool MorphologyLoader::importMorphologies(
+    const std::vector< servus::URI >& uris,
+    Scene& scene )
+{
+    CellsPrimitives cells( uris.size( ));
+    size_t progress = 0;
+    #pragma omp parallel for schedule( dynamic )
+    for( size_t i = 0; i < cells.size(); ++i )
+    {
+        // Cells are skipped once the scene stops accepting data
+        if( scene.isLoadingCancelled( ))
+            continue;
+
+        CellPrimitives& cell = cells[i];
+        ParallelSceneContainer container =
+            { cell.spheres, cell.cylinders, cell.cones };
+        cell.loaded = _importMorphology(
+            uris[i], i, Matrix4f(),
+            _geometryParameters.getGeometryQuality(),
+            _geometryParameters.getMorphologySectionTypes(), 0,
+            container, cell.bounds, 0, cell.maxDistanceToSoma );
+
+        BRAYNS_PROGRESS( progress, uris.size() );
+        #pragma omp atomic
+        ++progress;
+    }
+
+    if( scene.isLoadingCancelled( ))
+    {
+        BRAYNS_INFO << "Morphology loading cancelled" << std::endl;
+        return true;
+    }
+
+    bool success = true;
+    for( size_t i = 0; i < cells.size(); ++i )
+        if( !cells[i].loaded )
+        {
+            BRAYNS_ERROR << "Failed to import " << uris[i].getPath()
+                         << std::endl;
+            success = false;
+        }
+
+    _mergeCells( cells, scene );
+    return success;
+}
+
 bool MorphologyLoader::_importMorphology(
     const servus::URI& source,
     const size_t morphologyIndex,
     const Matrix4f& transformation,
+    const GeometryQuality geometryQuality,
+    const size_t morphologySectionTypes,
     const SimulationInformation* simulationInformation,
-    PrimitivesMap& primitives,
+    ParallelSceneContainer& container,
     Boxf& bounds,
     const size_t simulationOffset,
     float& maxDistanceToSoma)
@@ -72,8 +357,7 @@ bool MorphologyLoader::_importMorphology(
     {
         Vector3f translation = { 0.f, 0.f, 0.f };
 
-        brain::neuron::Morphology morphology( source, transformation );
-        brain::SectionTypes sectionTypes;
+        const MorphologyDataPtr morphology = _loadMorphology( source );
 
         const MorphologyLayout& layout =
             _geometryParameters.getMorphologyLayout();
@@ -81,12 +365,8 @@ bool MorphologyLoader::_importMorphology(
         if( layout.type != ML_NONE )
         {
             Boxf morphologyAABB;
-            const brain::Vector4fs& points = morphology.getPoints();
-            for( Vector4f point: points )
-            {
-                const Vector3f p = { point.x(), point.y(), point.z() };
-                morphologyAABB.merge( p );
-            }
+            _mergeTransformedBounds(
+                morphology->bounds, transformation, morphologyAABB );
 
             const Vector3f positionInGrid =
             {
@@ -99,20 +379,6 @@ bool MorphologyLoader::_importMorphology(
             translation = positionInGrid - morphologyAABB.getCenter();
         }
 
-        const size_t morphologySectionTypes =
-            _geometryParameters.getMorphologySectionTypes();
-        if( morphologySectionTypes & MST_SOMA )
-            sectionTypes.push_back( brain::SECTION_SOMA );
-        if( morphologySectionTypes & MST_AXON )
-            sectionTypes.push_back( brain::SECTION_AXON );
-        if( morphologySectionTypes & MST_DENDRITE )
-            sectionTypes.push_back( brain::SECTION_DENDRITE );
-        if( morphologySectionTypes & MST_APICAL_DENDRITE )
-            sectionTypes.push_back( brain::SECTION_APICAL_DENDRITE );
-
-        const brain::neuron::Sections& sections =
-            morphology.getSections( sectionTypes );
-
         size_t sectionId = 0;
 
         float offset = 0.f;
@@ -125,64 +391,62 @@ bool MorphologyLoader::_importMorphology(
         if( morphologySectionTypes & MST_SOMA )
         {
             // Soma
-            const brain::neuron::Soma& soma = morphology.getSoma();
             const size_t material =
-                _material( morphologyIndex, brain::SECTION_SOMA );
-            const Vector3f& center = soma.getCentroid() + translation;
+                _material( morphologyIndex, SWC_SECTION_SOMA );
+            const Vector3f& center =
+                transformation * morphology->somaCentroid + translation;
 
             const float radius =
                 ( _geometryParameters.getRadiusCorrection() != 0.f ?
                 _geometryParameters.getRadiusCorrection() :
-                soma.getMeanRadius() *
+                morphology->somaMeanRadius *
                     _geometryParameters.getRadiusMultiplier() );
-            primitives[material].push_back( SpherePtr(
-                new Sphere( material, center, radius, 0.f, offset )));
+            container.spheres[material].push_back(
+                Sphere( center, radius, 0.f, offset ));
             bounds.merge( center );
         }
 
         // Dendrites and axon
-        for( const auto& section: sections )
+        for( const auto& section: morphology->sections )
         {
-            const size_t material =
-                _material( morphologyIndex, section.getType( ));
-            const Vector4fs& samples = section.getSamples();
-            if( samples.size() == 0 )
+            if( !( morphologySectionTypes & _sectionTypeFlag( section.type )))
                 continue;
 
-            Vector4f previousSample = samples[0];
-            size_t step = 1;
-            switch( _geometryParameters.getGeometryQuality() )
+            const size_t material =
+                _material( morphologyIndex, section.type );
+            // A section needs two samples to define a segment
+            if( section.nbSamples < 2 )
             {
-                case GQ_FAST:
-                    step = samples.size()-1;
-                    break;
-                case GQ_QUALITY:
-                    step = samples.size()/2;
-                    step = ( step == 0 ) ? 1 : step;
-                    break;
-                default:
-                    step = 1;
+                if( section.nbSamples == 1 )
+                    ++sectionId;
+                continue;
             }
+            const Vector4f* samples = &morphology->samples[section.firstSample];
+            const float* distancesToSoma =
+                &morphology->sampleDistancesToSoma[section.firstSample];
 
-            const float distanceToSoma = section.getDistanceToSoma();
-            const floats& distancesToSoma = section.getSampleDistancesToSoma();
+            const size_t nbSamples = section.nbSamples;
+            Vector3f previousPosition = _transform( transformation, samples[0] );
+            const size_t step = _getSampleStep( geometryQuality, nbSamples );
+
+            const float distanceToSoma = section.distanceToSoma;
 
             float segmentStep = 0.f;
             if( simulationInformation )
             {
                 // Number of compartments usually differs from number of samples
-                if( samples.size() != 0 && (*simulationInformation->compartmentCounts)[sectionId] > 1 )
+                if( nbSamples != 0 && (*simulationInformation->compartmentCounts)[sectionId] > 1 )
                     segmentStep =
                         float((*simulationInformation->compartmentCounts)[sectionId]) /
-                        float(samples.size());
+                        float(nbSamples);
             }
 
             bool done = false;
-            for( size_t i = step; !done && i < samples.size() + step; i += step )
+            for( size_t i = step; !done && i < nbSamples + step; i += step )
             {
-                if( i>=samples.size() )
+                if( i>=nbSamples )
                 {
-                    i = samples.size()-1;
+                    i = nbSamples-1;
                     done = true;
                 }
 
@@ -197,18 +461,17 @@ bool MorphologyLoader::_importMorphology(
                     if( simulationOffset != 0 )
                         offset = simulationOffset + distance;
 
-                Vector4f sample =  samples[i];
+                const Vector4f& sample = samples[i];
                 const float previousRadius =
                     (_geometryParameters.getRadiusCorrection() != 0.f ?
                     _geometryParameters.getRadiusCorrection() :
                     samples[ i - step ].w() * 0.5f *
                         _geometryParameters.getRadiusMultiplier( ));
 
-                Vector3f position( sample.x(), sample.y(), sample.z());
-                position += translation;
-                Vector3f target(
-                    previousSample.x(), previousSample.y(), previousSample.z());
-                target += translation;
+                const Vector3f transformedPosition =
+                    _transform( transformation, sample );
+                const Vector3f position = transformedPosition + translation;
+                const Vector3f target = previousPosition + translation;
                 const float radius =
                     (_geometryParameters.getRadiusCorrection() != 0.f ?
                     _geometryParameters.getRadiusCorrection() :
@@ -216,24 +479,23 @@ bool MorphologyLoader::_importMorphology(
                          _geometryParameters.getRadiusMultiplier( ));
 
                 if( radius > 0.f )
-                    primitives[material].push_back( SpherePtr(
-                        new Sphere( material, position,
-                            radius, distance, offset )));
+                    container.spheres[material].push_back(
+                        Sphere( position, radius, distance, offset ));
 
                 bounds.merge( position );
                 if( position != target && radius > 0.f && previousRadius > 0.f )
                 {
                     if( radius == previousRadius )
-                        primitives[material].push_back( CylinderPtr(
-                            new Cylinder( material, position, target,
-                                radius, distance, offset )));
+                        container.cylinders[material].push_back(
+                            Cylinder( position, target,
+                                radius, distance, offset ));
                     else
-                        primitives[material].push_back( ConePtr(
-                            new Cone( material, position, target,
-                                radius, previousRadius, distance, offset )));
+                        container.cones[material].push_back(
+                            Cone( position, target,
+                                radius, previousRadius, distance, offset ));
                     bounds.merge( target );
                 }
-                previousSample = sample;
+                previousPosition = transformedPosition;
             }
             ++sectionId;
         }
@@ -246,67 +508,626 @@ bool MorphologyLoader::_importMorphology(
     return true;
 }
 
+MorphologyDataPtr MorphologyLoader::_loadMorphology(
+    const servus::URI& source )
+{
+    const std::string uri = std::to_string( source );
+    MorphologyDataPtr morphology;
+    if( _morphologyCache )
+    {
+        morphology = _morphologyCache->get( uri );
+        if( morphology )
+            return morphology;
+    }
+
+    if( _morphologyStore )
+        morphology = _morphologyStore->get( uri );
+    if( !morphology )
+        morphology = _parseMorphology( source );
+
+    if( _morphologyCache )
+        _morphologyCache->insert( uri, morphology );
+    return morphology;
+}
+
+MorphologyDataPtr MorphologyLoader::_parseMorphology(
+    const servus::URI& source )
+{
+    const std::string& path = source.getPath();
+    if( boost::filesystem::path( path ).extension() == ".swc" )
+        return SWCParser::parseFile( path );
+
+#ifdef BRAYNS_USE_BRION
+    const brain::neuron::Morphology morphology( source );
+    std::shared_ptr< MorphologyData > data( new MorphologyData );
+
+    for( const Vector4f& point: morphology.getPoints( ))
+        data->bounds.merge( Vector3f( point.x(), point.y(), point.z( )));
+
+    const brain::neuron::Soma& soma = morphology.getSoma();
+    data->somaCentroid = soma.getCentroid();
+    data->somaMeanRadius = soma.getMeanRadius();
+
+    const brain::neuron::Sections& sections = morphology.getSections(
+        { brain::SECTION_SOMA, brain::SECTION_AXON, brain::SECTION_DENDRITE,
+          brain::SECTION_APICAL_DENDRITE } );
+    data->sections.reserve( sections.size( ));
+    for( const auto& section: sections )
+    {
+        const Vector4fs& samples = section.getSamples();
+        const floats& distancesToSoma = section.getSampleDistancesToSoma();
+        const MorphologySection morphologySection =
+        {
+            size_t( section.getType( )), section.getDistanceToSoma(),
+            data->samples.size(), samples.size()
+        };
+        data->sections.push_back( morphologySection );
+        data->samples.insert(
+            data->samples.end(), samples.begin(), samples.end( ));
+        data->sampleDistancesToSoma.insert( data->sampleDistancesToSoma.end(),
+            distancesToSoma.begin(), distancesToSoma.end( ));
+    }
+    return data;
+#else
+    throw std::runtime_error( "Brion is required to load " + path );
+#endif
+}
+
+floats MorphologyLoader::_getMaxDistancesToSoma(
+    const std::vector< servus::URI >& uris )
+{
+    floats maxDistancesToSoma( uris.size( ));
+    #pragma omp parallel for schedule( dynamic )
+    for( size_t i = 0; i < uris.size(); ++i )
+    {
+        try
+        {
+            maxDistancesToSoma[i] = _getMaxDistanceToSoma(
+                *_loadMorphology( uris[i] ),
+                _geometryParameters.getGeometryQuality(),
+                _geometryParameters.getMorphologySectionTypes( ));
+        }
+        catch( const std::runtime_error& )
+        {
+            maxDistancesToSoma[i] = -1.f;
+        }
+    }
+    return maxDistancesToSoma;
+}
+
+bool MorphologyLoader::saveSimulationSubset(
+    const servus::URI& circuitConfig,
+    const std::string& target,
+    const std::string& filename )
+{
+    std::set< uint32_t > gids;
+    if( !target.empty( ))
+    {
+#ifdef BRAYNS_USE_BRION
+        const brion::BlueConfig bc( circuitConfig.getPath( ));
+        const brain::Circuit circuit( bc );
+        const brain::GIDSet& targetGids = circuit.getGIDs( target );
+        if( targetGids.empty( ))
+        {
+            BRAYNS_ERROR << "Target " << target << " does not contain any "
+                         << "cells" << std::endl;
+            return false;
+        }
+        gids.insert( targetGids.begin(), targetGids.end( ));
+#else
+        BRAYNS_ERROR << "Brion is required to load target " << target
+                     << " from " << circuitConfig.getPath() << std::endl;
+        return false;
+#endif
+    }
+
+    SimulationDescriptor simulationDescriptor;
+    if( !simulationDescriptor.attachSimulationToCacheFile(
+            _geometryParameters.getSimulationCacheFile( )))
+    {
+        return false;
+    }
+    return simulationDescriptor.saveSubset(
+        filename, _geometryParameters.getStartSimulationTime(),
+        _geometryParameters.getEndSimulationTime(), gids );
+}
+
+#ifdef BRAYNS_USE_BRION
 bool MorphologyLoader::importCircuit(
     const servus::URI& circuitConfig,
     const std::string& target,
     Scene& scene)
+{
+    size_t simulationOffset = 1;
+    return importCircuitShard( circuitConfig, target, 0, 1,
+                               [] { return size_t( 1 ); },
+                               simulationOffset, scene );
+}
+
+bool MorphologyLoader::importCircuitShard(
+    const servus::URI& circuitConfig,
+    const std::string& target,
+    const size_t shard,
+    const size_t nbShards,
+    const std::function< size_t() >& firstSimulationOffset,
+    size_t& simulationOffset,
+    Scene& scene)
 {
     const std::string& filename = circuitConfig.getPath();
     const brion::BlueConfig bc( filename );
     const brain::Circuit circuit( bc );
-    const brain::GIDSet& gids =
+    const brain::GIDSet& allGids =
         ( target.empty() ? circuit.getGIDs() : circuit.getGIDs( target ));
-    if( gids.empty() )
+    if( allGids.empty() )
     {
         BRAYNS_ERROR << "Circuit does not contain any cells" << std::endl;
         return false;
     }
+
+    // Range of consecutive GIDs of the shard
+    const size_t firstCell = allGids.size() * shard / nbShards;
+    const size_t lastCell = allGids.size() * ( shard + 1 ) / nbShards;
+    const brain::GIDSet gids(
+        std::next( allGids.begin(), firstCell ),
+        std::next( allGids.begin(), lastCell ));
+    if( nbShards > 1 )
+        BRAYNS_INFO << "Shard " << shard << "/" << nbShards << ": cells "
+                    << firstCell << " to " << lastCell << std::endl;
+    if( gids.empty( ))
+    {
+        simulationOffset = firstSimulationOffset();
+        return true;
+    }
+
     const Matrix4fs& transforms = circuit.getTransforms( gids );
 
     const brain::URIs& uris = circuit.getMorphologyURIs( gids );
 
+    if( _geometryParameters.getMorphologyLevelsOfDetail() &&
+        !_geometryParameters.getMorphologyInstancing( ))
+        BRAYNS_WARN << "Morphology levels of detail require morphology "
+                    << "instancing" << std::endl;
+
+    if( _geometryParameters.getMorphologyInstancing() &&
+        _isInstancingSupported( ))
+    {
+        simulationOffset = firstSimulationOffset();
+        return _importInstancedCircuit( uris, transforms, scene );
+    }
+
     BRAYNS_INFO << "Loading " << uris.size() << " cells" << std::endl;
 
-    std::map< size_t, float > morphologyOffsets;
+    size_ts cellIndices( uris.size( ));
+    std::iota( cellIndices.begin(), cellIndices.end(), firstCell );
+
+    // The offsets of the cells of the shard follow the cells of the preceding
+    // shards, which are only requested once the cells of the shard are loaded
+    GeometryBatch batch;
+    _importCells( uris, transforms, cellIndices, 0, uris.size(),
+        [&]( const floats& maxDistancesToSoma )
+        {
+            simulationOffset = firstSimulationOffset();
+            return _accumulateSimulationOffsets( maxDistancesToSoma,
+                                                 simulationOffset );
+        },
+        &scene, batch );
+
+    scene.getWorldBounds().merge( batch.bounds );
+    _appendPrimitives( batch.spheres, scene.getSpheres( ));
+    _appendPrimitives( batch.cylinders, scene.getCylinders( ));
+    _appendPrimitives( batch.cones, scene.getCones( ));
+    return true;
+}
+
+bool MorphologyLoader::importCircuitInBatches(
+    const servus::URI& circuitConfig,
+    const std::string& target,
+    const size_t batchSize,
+    Scene& scene )
+{
+    const std::string& filename = circuitConfig.getPath();
+    const brion::BlueConfig bc( filename );
+    const brain::Circuit circuit( bc );
+    const brain::GIDSet& gids =
+        ( target.empty() ? circuit.getGIDs() : circuit.getGIDs( target ));
+    if( gids.empty() )
+    {
+        BRAYNS_ERROR << "Circuit does not contain any cells" << std::endl;
+        scene.setLoadingProgress( 1.f );
+        return false;
+    }
+
+    const Matrix4fs& transforms = circuit.getTransforms( gids );
+    const brain::URIs& uris = circuit.getMorphologyURIs( gids );
+
+    // The first batch only holds the positions of the cells, so that the
+    // whole circuit is framed as soon as the first batch is committed
+    GeometryBatch positions;
+    for( const auto& transform: transforms )
+        positions.bounds.merge( transform.getTranslation( ));
+    if( !scene.addGeometryBatch( positions ))
+        return true;
+
+    BRAYNS_INFO << "Loading " << uris.size() << " cells in batches of "
+                << batchSize << " cells" << std::endl;
+
+    size_ts cellIndices( uris.size( ));
+    std::iota( cellIndices.begin(), cellIndices.end(), 0 );
 
     size_t simulationOffset = 1;
-    size_t simulatedCells = 0;
-    size_t progress = 0;
-    #pragma omp parallel
+    for( size_t begin = 0; begin < uris.size(); begin += batchSize )
+    {
+        const size_t end = std::min( begin + batchSize, uris.size( ));
+        GeometryBatch batch;
+        _importCells( uris, transforms, cellIndices, begin, end,
+            [&]( const floats& maxDistancesToSoma )
+            {
+                return _accumulateSimulationOffsets( maxDistancesToSoma,
+                                                     simulationOffset );
+            },
+            &scene, batch );
+        if( !scene.addGeometryBatch( batch ))
+        {
+            BRAYNS_INFO << "Circuit loading cancelled" << std::endl;
+            return true;
+        }
+        scene.setLoadingProgress( float( end ) / float( uris.size( )));
+    }
+    return true;
+}
+
+bool MorphologyLoader::importCells(
+    const servus::URI& circuitConfig,
+    const uints& gids,
+    TargetSimulationOffsets& targetSimulationOffsets,
+    GeometryBatch& batch )
+{
+    const std::string& filename = circuitConfig.getPath();
+    const brion::BlueConfig bc( filename );
+    const brain::Circuit circuit( bc );
+    const std::string& target = _geometryParameters.getTarget();
+    const brain::GIDSet& targetGids =
+        ( target.empty() ? circuit.getGIDs() : circuit.getGIDs( target ));
+
+    // Cells keep the index they have in the circuit target
+    const std::set< uint32_t > requestedGids( gids.begin(), gids.end( ));
+    brain::GIDSet cellGids;
+    size_ts cellIndices;
+    size_t index = 0;
+    for( const auto gid: targetGids )
+    {
+        if( requestedGids.count( gid ))
+        {
+            cellGids.insert( gid );
+            cellIndices.push_back( index );
+        }
+        ++index;
+    }
+    if( cellGids.empty( ))
+    {
+        BRAYNS_ERROR << "None of the " << gids.size() << " cells belong to "
+                     << "the circuit target" << std::endl;
+        return false;
+    }
+
+    const Matrix4fs& transforms = circuit.getTransforms( cellGids );
+    const brain::URIs& uris = circuit.getMorphologyURIs( cellGids );
+
+    // Cells also keep the simulation offset they have in the circuit target,
+    // which depends on the maximum distance to the soma of all the cells that
+    // precede them. Offsets are only computed for the target cells that were
+    // not requested before
+    size_ts simulationOffsets( cellIndices.size(), 0 );
+    if( !_geometryParameters.getReport().empty() ||
+        !_geometryParameters.getSimulationCacheFile().empty( ))
+    {
+        // Distances to the soma also depend on the geometry that is built
+        const std::string circuitTarget = filename + ":" + target + ":" +
+            std::to_string( _geometryParameters.getGeometryQuality( )) + ":" +
+            std::to_string( _geometryParameters.getMorphologySectionTypes( ));
+        if( targetSimulationOffsets.circuitTarget != circuitTarget )
+        {
+            targetSimulationOffsets = TargetSimulationOffsets();
+            targetSimulationOffsets.circuitTarget = circuitTarget;
+        }
+
+        size_ts& offsets = targetSimulationOffsets.offsets;
+        const size_t nbOffsets = cellIndices.back() + 1;
+        if( offsets.size() < nbOffsets )
+        {
+            const brain::GIDSet precedingGids(
+                std::next( targetGids.begin(), offsets.size( )),
+                std::next( targetGids.begin(), nbOffsets ));
+            const size_ts newOffsets = _accumulateSimulationOffsets(
+                _getMaxDistancesToSoma(
+                    circuit.getMorphologyURIs( precedingGids )),
+                targetSimulationOffsets.nextOffset );
+            offsets.insert( offsets.end(), newOffsets.begin(),
+                            newOffsets.end( ));
+        }
+        for( size_t i = 0; i < cellIndices.size(); ++i )
+            simulationOffsets[i] = offsets[cellIndices[i]];
+    }
+
+    BRAYNS_INFO << "Loading " << uris.size() << " cells" << std::endl;
+
+    _importCells( uris, transforms, cellIndices, 0, uris.size(),
+        [&simulationOffsets]( const floats& )
+        {
+            return simulationOffsets;
+        },
+        nullptr, batch );
+    return true;
+}
+
+void MorphologyLoader::_importCells(
+    const std::vector< servus::URI >& uris,
+    const Matrix4fs& transforms,
+    const size_ts& cellIndices,
+    const size_t begin,
+    const size_t end,
+    const std::function< size_ts( const floats& ) >& getSimulationOffsets,
+    const Scene* scene,
+    GeometryBatch& batch )
+{
+    // Files are read ahead of the cells being built, so that the reads of
+    // the building threads hit the page cache instead of waiting for the
+    // file system
+    std::unique_ptr< FilePrefetcher > prefetcher;
+    const size_t prefetchDepth =
+        _geometryParameters.getMorphologyPrefetchDepth();
+    if( prefetchDepth > 0 )
     {
-        PrimitivesMap private_primitives;
-        #pragma omp for nowait
-        for( size_t i = 0; i < uris.size(); ++i )
+        strings filenames( end - begin );
+        for( size_t i = 0; i < filenames.size(); ++i )
         {
-            const auto& uri = uris[i];
-            float maxDistanceToSoma = 0.f;
-            if( _importMorphology(
-                uri, i, transforms[i], 0,
-                private_primitives, scene.getWorldBounds(),
-                simulationOffset, maxDistanceToSoma))
+            const servus::URI& uri = uris[begin + i];
+            const std::string name = std::to_string( uri );
+            if(( !_morphologyCache || !_morphologyCache->get( name )) &&
+               ( !_morphologyStore || !_morphologyStore->contains( name )))
             {
-                morphologyOffsets[simulatedCells] = maxDistanceToSoma;
-                simulationOffset += maxDistanceToSoma;
+                filenames[i] = uri.getPath();
             }
+        }
+        prefetcher.reset( new FilePrefetcher(
+            filenames, prefetchDepth,
+            _geometryParameters.getMorphologyIOThreads( )));
+    }
+
+    CellsPrimitives cells( end - begin );
+    size_t progress = begin;
+    #pragma omp parallel for schedule( dynamic )
+    for( size_t i = 0; i < cells.size(); ++i )
+    {
+        // Cells are skipped once the scene stops accepting data, files that
+        // are not consumed are then not read ahead anymore
+        if( scene && scene->isLoadingCancelled( ))
+            continue;
+
+        const size_t cellIndex = begin + i;
+        CellPrimitives& cell = cells[i];
+        ParallelSceneContainer container =
+            { cell.spheres, cell.cylinders, cell.cones };
+        cell.loaded = _importMorphology(
+            uris[cellIndex], cellIndices[cellIndex], transforms[cellIndex],
+            _geometryParameters.getGeometryQuality(),
+            _geometryParameters.getMorphologySectionTypes(), 0,
+            container, cell.bounds, 0, cell.maxDistanceToSoma );
+        if( prefetcher )
+            prefetcher->consumed();
+
+        BRAYNS_PROGRESS( progress, uris.size() );
+        #pragma omp atomic
+        ++progress;
+    }
+
+    // The simulation offset of a cell depends on all the cells that precede
+    // it, offsets are therefore computed once all cells are loaded
+    floats maxDistancesToSoma( cells.size( ));
+    for( size_t i = 0; i < cells.size(); ++i )
+        maxDistancesToSoma[i] =
+            cells[i].loaded ? cells[i].maxDistanceToSoma : -1.f;
+    const size_ts simulationOffsets =
+        getSimulationOffsets( maxDistancesToSoma );
+
+    #pragma omp parallel for schedule( dynamic )
+    for( size_t i = 0; i < cells.size(); ++i )
+    {
+        _setSimulationOffset( cells[i].spheres, simulationOffsets[i] );
+        _setSimulationOffset( cells[i].cylinders, simulationOffsets[i] );
+        _setSimulationOffset( cells[i].cones, simulationOffsets[i] );
+    }
+
+    _mergeCells( cells, batch.spheres, batch.cylinders, batch.cones,
+                 batch.bounds );
+}
+
+bool MorphologyLoader::saveMorphologyStore(
+    const servus::URI& circuitConfig,
+    const std::string& target,
+    const std::string& filename )
+{
+    const brion::BlueConfig bc( circuitConfig.getPath( ));
+    const brain::Circuit circuit( bc );
+    const brain::GIDSet& gids =
+        ( target.empty() ? circuit.getGIDs() : circuit.getGIDs( target ));
+    if( gids.empty() )
+    {
+        BRAYNS_ERROR << "Circuit does not contain any cells" << std::endl;
+        return false;
+    }
 
-            BRAYNS_PROGRESS( progress, uris.size() );
+    // Every morphology is parsed once, whatever the number of cells using it
+    const brain::URIs& uris = circuit.getMorphologyURIs( gids );
+    std::vector< servus::URI > uniqueURIs;
+    std::set< std::string > names;
+    for( const auto& uri: uris )
+        if( names.insert( std::to_string( uri )).second )
+            uniqueURIs.push_back( uri );
+
+    BRAYNS_INFO << "Converting " << uniqueURIs.size() << " morphologies of "
+                << gids.size() << " cells" << std::endl;
+    std::vector< MorphologyDataPtr > morphologies( uniqueURIs.size( ));
+    size_t progress = 0;
+    size_t nbFailures = 0;
+    #pragma omp parallel for schedule( dynamic )
+    for( size_t i = 0; i < uniqueURIs.size(); ++i )
+    {
+        try
+        {
+            morphologies[i] = _parseMorphology( uniqueURIs[i] );
+        }
+        catch( const std::runtime_error& e )
+        {
+            BRAYNS_ERROR << e.what() << std::endl;
             #pragma omp atomic
-            ++progress;
+            ++nbFailures;
         }
-        #pragma omp critical
-        for( const auto& p: private_primitives )
+
+        BRAYNS_PROGRESS( progress, uniqueURIs.size( ));
+        #pragma omp atomic
+        ++progress;
+    }
+    if( nbFailures > 0 )
+        return false;
+
+    MorphologyDataMap store;
+    for( size_t i = 0; i < uniqueURIs.size(); ++i )
+        store[std::to_string( uniqueURIs[i] )] = morphologies[i];
+    return MorphologyStore::save( filename, store );
+}
+
+bool MorphologyLoader::_importInstancedCircuit(
+    const std::vector< servus::URI >& uris,
+    const Matrix4fs& transforms,
+    Scene& scene )
+{
+    // Every unique morphology becomes a geometry template, built once in its
+    // own frame of reference. Cells are instances of the template of their
+    // morphology, placed with their circuit transformation
+    std::map< std::string, size_t > templateIndices;
+    std::vector< servus::URI > templateUris;
+    size_ts cellTemplates;
+    cellTemplates.reserve( uris.size( ));
+    for( const auto& uri: uris )
+    {
+        const std::string key = std::to_string( uri );
+        auto it = templateIndices.find( key );
+        if( it == templateIndices.end( ))
         {
-            const size_t material = p.first;
-            scene.getPrimitives()[material].insert(
-                scene.getPrimitives()[material].end(),
-                private_primitives[material].begin(),
-                private_primitives[material].end());
+            it = templateIndices.insert(
+                std::make_pair( key, templateUris.size( ))).first;
+            templateUris.push_back( uri );
         }
+        cellTemplates.push_back( it->second );
+    }
+
+    BRAYNS_INFO << "Loading " << templateUris.size()
+                << " unique morphologies for " << uris.size()
+                << " cells" << std::endl;
+
+    // Levels of detail of every template, from the most to the least detailed.
+    // Every level is defined by a geometry quality and the types of sections
+    // it contains
+    std::vector< std::pair< GeometryQuality, size_t >> levels;
+    const GeometryQuality geometryQuality =
+        _geometryParameters.getGeometryQuality();
+    const size_t sectionTypes =
+        _geometryParameters.getMorphologySectionTypes();
+    levels.push_back( std::make_pair( geometryQuality, sectionTypes ));
+    if( _geometryParameters.getMorphologyLevelsOfDetail( ))
+    {
+        // Coarse skeleton, with one segment per section
+        if( geometryQuality != GQ_FAST )
+            levels.push_back( std::make_pair( GQ_FAST, sectionTypes ));
+        // Soma only
+        if( sectionTypes != MST_SOMA && ( sectionTypes & MST_SOMA ))
+            levels.push_back( std::make_pair( GQ_FAST, size_t( MST_SOMA )));
     }
 
+    GeometryTemplates& templates = scene.getGeometryTemplates();
+    const size_t firstTemplate = templates.size();
+    templates.resize( firstTemplate + templateUris.size( ));
+    uint8_ts loaded( templateUris.size(), 0 );
+
+    size_t progress = 0;
+    #pragma omp parallel for
+    for( size_t i = 0; i < templateUris.size(); ++i )
+    {
+        GeometryTemplate& geometryTemplate = templates[firstTemplate + i];
+        for( const auto& level: levels )
+        {
+            geometryTemplate.levels.push_back( GeometryLevel( ));
+            GeometryLevel& geometryLevel = geometryTemplate.levels.back();
+            ParallelSceneContainer container =
+            {
+                geometryLevel.spheres,
+                geometryLevel.cylinders,
+                geometryLevel.cones
+            };
+
+            // The most detailed level defines the bounds of the template
+            Boxf bounds;
+            Boxf& levelBounds = geometryTemplate.levels.size() == 1 ?
+                geometryTemplate.bounds : bounds;
+            float maxDistanceToSoma;
+            const bool imported = _importMorphology(
+                templateUris[i], 0, Matrix4f(), level.first, level.second, 0,
+                container, levelBounds, 0, maxDistanceToSoma );
+
+            if( !imported || ( geometryLevel.spheres.empty() &&
+                geometryLevel.cylinders.empty() && geometryLevel.cones.empty( )))
+            {
+                geometryTemplate.levels.pop_back();
+            }
+            if( !imported )
+                break;
+        }
+        loaded[i] = !geometryTemplate.levels.empty();
+
+        BRAYNS_PROGRESS( progress, templateUris.size() );
+        #pragma omp atomic
+        ++progress;
+    }
+
+    Instances& instances = scene.getInstances();
+    instances.reserve( instances.size() + uris.size( ));
+    for( size_t i = 0; i < uris.size(); ++i )
+    {
+        if( !loaded[cellTemplates[i]] )
+            continue;
+
+        const size_t templateId = firstTemplate + cellTemplates[i];
+        instances.push_back( Instance( templateId, transforms[i] ));
+        _mergeTransformedBounds(
+            templates[templateId].bounds, transforms[i],
+            scene.getWorldBounds( ));
+    }
     return true;
 }
 
+namespace
+{
+/** Values of a cell in the frames of a compartment report. The compartments
+ *  of a cell are contiguous in report frames */
+SimulationCell _getSimulationCell(
+    const uint32_t gid,
+    const uint64_ts& offsets,
+    const uint16_ts& counts )
+{
+    SimulationCell cell = { gid, std::numeric_limits< uint64_t >::max(), 0 };
+    for( size_t i = 0; i < offsets.size(); ++i )
+        if( counts[i] > 0 )
+        {
+            cell.offset = std::min( cell.offset, offsets[i] );
+            cell.size += counts[i];
+        }
+    if( cell.size == 0 )
+        cell.offset = 0;
+    return cell;
+}
+}
+
 bool MorphologyLoader::importCircuit(
     const servus::URI& circuitConfig,
     const std::string& target,
@@ -327,6 +1148,12 @@ bool MorphologyLoader::importCircuit(
 
     const brain::URIs& uris = circuit.getMorphologyURIs( gids );
 
+    if( _geometryParameters.getMorphologyInstancing( ))
+        BRAYNS_WARN << "Morphology instancing is not supported with "
+                    << "compartment reports since every cell has its own "
+                    << "simulation offsets. Cells are loaded individually"
+                    << std::endl;
+
     // Load simulation information from compartment reports
     const brion::CompartmentReport compartmentReport(
         brion::URI( bc.getReportSource( report ).getPath( )), brion::MODE_READ,
@@ -341,6 +1168,56 @@ bool MorphologyLoader::importCircuit(
     brain::URIs cr_uris;
     const brain::GIDSet& cr_gids = compartmentReport.getGIDs();
 
+    // Caches describing their cells may hold a subset of the report, in
+    // which case compartment offsets are relocated to the values of the cells
+    // in the cache. Cells missing from the cache, or with fewer values in the
+    // cache than in the report, have no offsets, and are loaded as
+    // non-simulated cells since their offsets would point past their values
+    std::vector< uint64_ts > cacheOffsets;
+    SimulationDescriptor simulationDescriptor;
+    const std::string& cacheFile = _geometryParameters.getSimulationCacheFile();
+    if( !cacheFile.empty() &&
+        boost::filesystem::exists( cacheFile ) &&
+        simulationDescriptor.attachSimulationToCacheFile( cacheFile ) &&
+        !simulationDescriptor.getCells().empty( ))
+    {
+        std::map< uint32_t, SimulationCell > cacheCells;
+        for( const auto& cell: simulationDescriptor.getCells( ))
+            cacheCells[cell.gid] = cell;
+
+        size_t i = 0;
+        for( const auto cr_gid: cr_gids )
+        {
+            uint64_ts offsets = compartmentOffsets[i];
+            const SimulationCell cell = _getSimulationCell(
+                cr_gid, offsets, compartmentCounts[i] );
+            const auto cacheCell = cacheCells.find( cr_gid );
+            if( cacheCell == cacheCells.end( ))
+            {
+                BRAYNS_WARN << "Cell " << cr_gid << " is not in the "
+                            << "simulation cache and is not simulated"
+                            << std::endl;
+                offsets.clear();
+            }
+            else if( cell.size > cacheCell->second.size )
+            {
+                BRAYNS_WARN << "Cell " << cr_gid << " has fewer values in the "
+                            << "simulation cache than in the report and is "
+                            << "not simulated" << std::endl;
+                offsets.clear();
+            }
+            else
+            {
+                for( size_t j = 0; j < offsets.size(); ++j )
+                    if( compartmentCounts[i][j] > 0 )
+                        offsets[j] = cacheCell->second.offset + offsets[j] -
+                                     cell.offset;
+            }
+            cacheOffsets.push_back( offsets );
+            ++i;
+        }
+    }
+
     BRAYNS_INFO << "Loading " << cr_gids.size()
                 << " simulated cells" << std::endl;
     for( const auto cr_gid: cr_gids)
@@ -350,44 +1227,41 @@ bool MorphologyLoader::importCircuit(
         cr_uris.push_back( uris[ index ] );
     }
 
+    CellsPrimitives cells( cr_uris.size( ));
     size_t progress = 0;
-    #pragma omp parallel
+    #pragma omp parallel for schedule( dynamic )
+    for( size_t i = 0; i < cr_uris.size(); ++i )
     {
-        PrimitivesMap private_primitives;
-        #pragma omp for nowait
-        for( size_t i = 0; i < cr_uris.size(); ++i )
-        {
-            const auto& uri = cr_uris[i];
-            const SimulationInformation simulationInformation =
-            {
-                &compartmentCounts[i],
-                &compartmentOffsets[i]
-            };
-
-            float maxDistanceToSoma;
-            _importMorphology(
-                uri, i, transforms[i], &simulationInformation,
-                private_primitives, scene.getWorldBounds(),
-                0, maxDistanceToSoma);
+        if( scene.isLoadingCancelled( ))
+            continue;
 
-            BRAYNS_PROGRESS( progress, cr_uris.size() );
-            #pragma omp atomic
-            ++progress;
-        }
-        #pragma omp critical
-        for( const auto& p: private_primitives )
+        const SimulationInformation simulationInformation =
         {
-            const size_t material = p.first;
-            scene.getPrimitives()[material].insert(
-                scene.getPrimitives()[material].end(),
-                private_primitives[material].begin(),
-                private_primitives[material].end());
-        }
+            &compartmentCounts[i],
+            cacheOffsets.empty() ? &compartmentOffsets[i] : &cacheOffsets[i]
+        };
+
+        const bool simulated = cacheOffsets.empty() || !cacheOffsets[i].empty();
+
+        CellPrimitives& cell = cells[i];
+        ParallelSceneContainer container =
+            { cell.spheres, cell.cylinders, cell.cones };
+        cell.loaded = _importMorphology(
+            cr_uris[i], i, transforms[i],
+            _geometryParameters.getGeometryQuality(),
+            _geometryParameters.getMorphologySectionTypes(),
+            simulated ? &simulationInformation : 0,
+            container, cell.bounds, 0, cell.maxDistanceToSoma );
+
+        BRAYNS_PROGRESS( progress, cr_uris.size() );
+        #pragma omp atomic
+        ++progress;
     }
+    _mergeCells( cells, scene );
 
     size_t nonSimulatedCells =
         _geometryParameters.getNonSimulatedCells();
-    if( nonSimulatedCells != 0 )
+    if( nonSimulatedCells != 0 && !scene.isLoadingCancelled( ))
     {
         // Non simulated cells
         const brain::GIDSet& allGids = circuit.getGIDs();
@@ -410,39 +1284,100 @@ bool MorphologyLoader::importCircuit(
         BRAYNS_INFO << "Loading " << nonSimulatedCells
                     << " non-simulated cells" << std::endl;
 
+        cells.resize( nonSimulatedCells );
         progress = 0;
-        #pragma omp parallel
+        #pragma omp parallel for schedule( dynamic )
+        for( size_t i = 0; i < nonSimulatedCells; ++i )
         {
-            PrimitivesMap private_primitives;
-            #pragma omp for nowait
-            for( size_t i = 0; i < nonSimulatedCells; ++i )
-            {
-                float maxDistanceToSoma;
-                const auto& uri = allUris[i];
+            if( scene.isLoadingCancelled( ))
+                continue;
 
-                _importMorphology(
-                    uri, i, allTransforms[i], 0,
-                    private_primitives, scene.getWorldBounds(),
-                    0, maxDistanceToSoma);
+            CellPrimitives& cell = cells[i];
+            ParallelSceneContainer container =
+                { cell.spheres, cell.cylinders, cell.cones };
+            cell.loaded = _importMorphology(
+                allUris[i], i, allTransforms[i],
+                _geometryParameters.getGeometryQuality(),
+                _geometryParameters.getMorphologySectionTypes(), 0,
+                container, cell.bounds, 0, cell.maxDistanceToSoma );
 
-                BRAYNS_PROGRESS( progress, allUris.size() );
-                #pragma omp atomic
-                ++progress;
-            }
-            #pragma omp critical
-            for( const auto& p: private_primitives )
-            {
-                const size_t material = p.first;
-                scene.getPrimitives()[material].insert(
-                    scene.getPrimitives()[material].end(),
-                    private_primitives[material].begin(),
-                    private_primitives[material].end());
-            }
+            BRAYNS_PROGRESS( progress, allUris.size() );
+            #pragma omp atomic
+            ++progress;
         }
+        _mergeCells( cells, scene );
     }
     return true;
 }
 
+namespace
+{
+const size_t SIMULATION_CACHE_WRITE_SIZE = 64 << 20;
+
+/** Encoded frames, loaded by several threads in any order, and handed over
+ *  to the writer in the order of the frames. Threads only load frames within
+ *  a window after the next frame to write, so that memory usage is bounded.
+ */
+class FrameReorderBuffer
+{
+public:
+    explicit FrameReorderBuffer( const uint64_t window )
+        : _window( window )
+        , _nextFrame( 0 )
+        , _cancelled( false )
+    {
+    }
+
+    /** Waits until the frame is within the window. Returns false if the
+        pipeline was cancelled */
+    bool waitForSlot( const uint64_t frame )
+    {
+        std::unique_lock< std::mutex > lock( _mutex );
+        _condition.wait( lock, [this, frame]
+            { return _cancelled || frame < _nextFrame + _window; });
+        return !_cancelled;
+    }
+
+    void push( const uint64_t frame, uint8_ts& data )
+    {
+        std::lock_guard< std::mutex > lock( _mutex );
+        _frames[frame].swap( data );
+        _condition.notify_all();
+    }
+
+    /** Waits for the given frame, which must be the next one in order.
+        Returns false if the pipeline was cancelled */
+    bool pop( const uint64_t frame, uint8_ts& data )
+    {
+        std::unique_lock< std::mutex > lock( _mutex );
+        _condition.wait( lock, [this, frame]
+            { return _cancelled || _frames.count( frame ) > 0; });
+        if( _cancelled )
+            return false;
+        data.swap( _frames[frame] );
+        _frames.erase( frame );
+        _nextFrame = frame + 1;
+        _condition.notify_all();
+        return true;
+    }
+
+    void cancel()
+    {
+        std::lock_guard< std::mutex > lock( _mutex );
+        _cancelled = true;
+        _condition.notify_all();
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::map< uint64_t, uint8_ts > _frames;
+    const uint64_t _window;
+    uint64_t _nextFrame;
+    bool _cancelled;
+};
+}
+
 bool MorphologyLoader::importSimulationData(
     const servus::URI& circuitConfig,
     const std::string& target,
@@ -490,22 +1425,96 @@ bool MorphologyLoader::importSimulationData(
 
     const uint64_t nbFrames = ( lastFrame - firstFrame ) / step;
 
+    // Values of every cell, so that subsets of the cache can be extracted
+    const brion::CompartmentCounts& compartmentCounts =
+        compartmentReport.getCompartmentCounts();
+    const brion::SectionOffsets& compartmentOffsets =
+        compartmentReport.getOffsets();
+    SimulationCells cells;
+    for( const auto gid: compartmentReport.getGIDs( ))
+        cells.push_back( _getSimulationCell(
+            gid, compartmentOffsets[cells.size()],
+            compartmentCounts[cells.size()] ));
+
     BRAYNS_INFO << "Loading values from compartment report and saving them to cache" << std::endl;
 
     // Write header
-    simulationDescriptor.writeHeader( file, nbFrames, frameSize );
+    const FrameEncoding encoding =
+        _geometryParameters.getSimulationCacheEncoding();
+    simulationDescriptor.writeHeader(
+        file, nbFrames, frameSize, encoding, firstFrame, step, cells );
+
+    // Frames are loaded and encoded by several threads, each with its own
+    // report reader, and written in order in large blocks
+    const size_t nbThreads =
+        std::max( size_t( 1 ), _geometryParameters.getSimulationCacheThreads( ));
+    const brion::URI reportSource( bc.getReportSource( report ).getPath( ));
+    FrameReorderBuffer frames( 2 * nbThreads );
+    std::atomic< uint64_t > nextFrame( 0 );
+    std::vector< std::thread > readers;
+    for( size_t i = 0; i < nbThreads; ++i )
+        readers.push_back( std::thread( [&]
+        {
+            try
+            {
+                brion::CompartmentReport threadReport(
+                    reportSource, brion::MODE_READ, gids );
+                uint8_ts data;
+                for( uint64_t frame = nextFrame++; frame < nbFrames;
+                     frame = nextFrame++ )
+                {
+                    if( !frames.waitForSlot( frame ))
+                        return;
+                    const float frameTime = firstFrame + step * frame;
+                    const brion::floatsPtr& valuesPtr =
+                        threadReport.loadFrame( frameTime );
+                    if( !valuesPtr )
+                        throw std::runtime_error( "Failed to load frame at " +
+                            std::to_string( frameTime ));
+                    SimulationDescriptor::encodeFrame(
+                        *valuesPtr, encoding, data );
+                    frames.push( frame, data );
+                }
+            }
+            catch( const std::exception& e )
+            {
+                BRAYNS_ERROR << e.what() << std::endl;
+                frames.cancel();
+            }
+        }));
 
     // Write body
-    for( uint64_t frame = 0; frame < nbFrames; ++frame )
+    bool success = true;
+    uint8_ts block;
+    block.reserve( SIMULATION_CACHE_WRITE_SIZE );
+    uint8_ts data;
+    for( uint64_t frame = 0; success && frame < nbFrames; ++frame )
     {
         BRAYNS_PROGRESS( frame, nbFrames );
-        const float frameTime = firstFrame + step * frame;
-        const brion::floatsPtr& valuesPtr = compartmentReport.loadFrame( frameTime );
-        const floats& values = *valuesPtr;
-        simulationDescriptor.writeFrame( file, values );
+        if( !frames.pop( frame, data ))
+        {
+            success = false;
+            break;
+        }
+        block.insert( block.end(), data.begin(), data.end( ));
+        if( block.size() >= SIMULATION_CACHE_WRITE_SIZE || frame + 1 == nbFrames )
+        {
+            success = file.write( ( char* )block.data(), block.size( )).good();
+            block.clear();
+        }
     }
+    frames.cancel();
+    for( auto& reader: readers )
+        reader.join();
     file.close();
 
+    if( !success )
+    {
+        BRAYNS_ERROR << "Failed to create cache file" << std::endl;
+        std::remove( cacheFile.c_str( ));
+        return false;
+    }
+
     BRAYNS_INFO << "----------------------------------------" << std::endl;
     BRAYNS_INFO << "Cache file successfully created" << std::endl;
     BRAYNS_INFO << "Number of frames: " << nbFrames << std::endl;
@@ -516,15 +1525,39 @@ bool MorphologyLoader::importSimulationData(
 
 #else
 
-bool MorphologyLoader::importMorphology(
-    const servus::URI&, const int, Scene& )
+bool MorphologyLoader::importCircuit(
+    const servus::URI&, const std::string&, Scene& )
 {
-    BRAYNS_ERROR << "Brion is required to load morphologies" << std::endl;
+    BRAYNS_ERROR << "Brion is required to load circuits" << std::endl;
     return false;
 }
 
-bool MorphologyLoader::importCircuit(
-    const servus::URI&, const std::string&, Scene& )
+bool MorphologyLoader::importCircuitShard(
+    const servus::URI&, const std::string&, const size_t, const size_t,
+    const std::function< size_t() >&, size_t&, Scene& )
+{
+    BRAYNS_ERROR << "Brion is required to load circuits" << std::endl;
+    return false;
+}
+
+bool MorphologyLoader::importCircuitInBatches(
+    const servus::URI&, const std::string&, const size_t, Scene& scene )
+{
+    BRAYNS_ERROR << "Brion is required to load circuits" << std::endl;
+    scene.setLoadingProgress( 1.f );
+    return false;
+}
+
+bool MorphologyLoader::saveMorphologyStore(
+    const servus::URI&, const std::string&, const std::string& )
+{
+    BRAYNS_ERROR << "Brion is required to convert morphologies" << std::endl;
+    return false;
+}
+
+bool MorphologyLoader::importCells(
+    const servus::URI&, const uints&, TargetSimulationOffsets&,
+    GeometryBatch& )
 {
     BRAYNS_ERROR << "Brion is required to load circuits" << std::endl;
     return false;
@@ -537,16 +1570,36 @@ bool MorphologyLoader::importCircuit(
     return false;
 }
 
-bool MorphologyLoader::_createSimulationDataCache(
-    const brion::CompartmentReport& report,
-    const std::string& cacheFile )
+bool MorphologyLoader::importSimulationData(
+    const servus::URI&, const std::string&, const std::string& )
 {
     BRAYNS_ERROR << "Brion is required to load simulation data" << std::endl;
-    return 0;
+    return false;
 }
 
 #endif
 
+bool MorphologyLoader::_isInstancingSupported() const
+{
+    // Templates are shared by all cells with the same morphology, so they
+    // cannot hold anything specific to a cell
+    if( _geometryParameters.getColorScheme() == CS_NEURON_BY_ID )
+    {
+        BRAYNS_WARN << "Morphology instancing is not supported with the "
+                    << "neuron-by-id color scheme. Cells are loaded "
+                    << "individually" << std::endl;
+        return false;
+    }
+    if( _geometryParameters.getMorphologyLayout().type != ML_NONE )
+    {
+        BRAYNS_WARN << "Morphology instancing is not supported with "
+                    << "morphology layouts. Cells are loaded individually"
+                    << std::endl;
+        return false;
+    }
+    return true;
+}
+
 size_t MorphologyLoader::_material(
     const size_t morphologyIndex,
     const size_t sectionType )
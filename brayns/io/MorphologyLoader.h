@@ -22,11 +22,13 @@
 #define MORPHOLOGY_LOADER_H
 
 #include <brayns/common/types.h>
-#include <brayns/common/geometry/Primitive.h>
 #include <brayns/parameters/GeometryParameters.h>
+#include <brayns/io/MorphologyCache.h>
+#include <brayns/io/MorphologyStore.h>
 
 #include <servus/types.h>
 
+#include <functional>
 #include <vector>
 
 namespace brion
@@ -48,6 +50,32 @@ struct SimulationInformation
     const uint64_ts* compartmentOffsets;
 };
 
+/** Primitives created by the loader, organized per material and per type of
+ * primitive. During circuit loading, every thread fills its own container and
+ * the containers are then appended to the scene.
+ */
+struct ParallelSceneContainer
+{
+    SpheresMap& spheres;
+    CylindersMap& cylinders;
+    ConesMap& cones;
+};
+
+/** Simulation offsets of the first cells of a circuit target, extended as
+ * cells further in the target are requested, so that loading a few cells does
+ * not require the distances of all the preceding cells to be computed again.
+ * circuitTarget identifies the circuit target and the geometry the offsets
+ * belong to.
+ */
+struct TargetSimulationOffsets
+{
+    TargetSimulationOffsets() : nextOffset( 1 ) {}
+
+    std::string circuitTarget;
+    size_ts offsets;
+    size_t nextOffset;
+};
+
 /** Loads morphologies from SWC and H5 files
  */
 class MorphologyLoader
@@ -69,6 +97,18 @@ public:
         int morphologyIndex,
         Scene& scene);
 
+    /** Imports morphologies from SWC or H5 files. Files are parsed in
+     *  parallel, and every morphology is given the index of its file.
+     *
+     * @param uris URIs of the morphologies
+     * @param scene resulting scene
+     * @return True if all morphologies are successfully loaded, false
+     *         otherwise
+     */
+    bool importMorphologies(
+        const std::vector< servus::URI >& uris,
+        Scene& scene );
+
     /** Imports morphology from a circuit for the given target name
      *
      * @param circuitConfig URI of the Circuit Config file
@@ -101,6 +141,111 @@ public:
         const std::string& target,
         Scene& scene);
 
+    /** Imports one shard of the morphologies of a circuit target. Cells of
+     * the target are split into nbShards ranges of consecutive GIDs, so that
+     * shards can be loaded by independent processes. Cells keep the index
+     * and the simulation offset they have in the whole target.
+     *
+     * @param circuitConfig URI of the Circuit Config file
+     * @param target Target to be loaded. If empty, the target specified in the
+     *        circuit configuration file is used. If such an entry does not
+     *        exist, all neurons are loaded.
+     * @param shard Index of the shard to be loaded
+     * @param nbShards Number of shards the target is split into
+     * @param firstSimulationOffset Returns the simulation offset following
+     *        the last cell of the preceding shards. It is called once the
+     *        cells of the shard are loaded.
+     * @param simulationOffset Returns the simulation offset following the
+     *        last cell of the shard
+     * @param scene resulting scene
+     * @return True if the shard is successfully loaded, false if the circuit
+     *         contains no cells.
+     */
+    bool importCircuitShard(
+        const servus::URI& circuitConfig,
+        const std::string& target,
+        size_t shard,
+        size_t nbShards,
+        const std::function< size_t() >& firstSimulationOffset,
+        size_t& simulationOffset,
+        Scene& scene);
+
+    /** Imports the morphologies of a circuit target in batches of consecutive
+     * cells. Every batch is queued to the scene with Scene::addGeometryBatch
+     * as soon as it is loaded, so that this method can run in a background
+     * thread while the scene is being rendered. Cells are always loaded
+     * individually, without morphology instancing.
+     *
+     * @param circuitConfig URI of the Circuit Config file
+     * @param target Target to be loaded. If empty, the target specified in the
+     *        circuit configuration file is used. If such an entry does not
+     *        exist, all neurons are loaded.
+     * @param batchSize Number of cells per batch
+     * @param scene Scene receiving the batches, and the loading progress
+     * @return True if the circuit is successfully loaded or if loading was
+     *         cancelled by the scene, false if the circuit contains no cells.
+     */
+    bool importCircuitInBatches(
+        const servus::URI& circuitConfig,
+        const std::string& target,
+        size_t batchSize,
+        Scene& scene);
+
+    /** Imports the morphologies of an arbitrary set of cells of a circuit
+     * into a geometry batch, which can then be added to a scene with
+     * Scene::addGeometryBatch. Cells are always loaded individually, without
+     * morphology instancing, and keep the index and the simulation offset they
+     * have in the circuit target given by the geometry parameters.
+     *
+     * @param circuitConfig URI of the Circuit Config file
+     * @param gids GIDs of the cells to be loaded
+     * @param targetSimulationOffsets Offsets of the circuit target, reused and
+     *        extended by successive calls. Offsets are only computed when a
+     *        report or a simulation cache is given, cells are not simulated
+     *        otherwise
+     * @param batch resulting batch
+     * @return True if the cells are successfully loaded, false if none of the
+     *         GIDs belong to the circuit target.
+     */
+    bool importCells(
+        const servus::URI& circuitConfig,
+        const uints& gids,
+        TargetSimulationOffsets& targetSimulationOffsets,
+        GeometryBatch& batch );
+
+    /** Converts the morphologies of a circuit target to a morphology store
+     * file, that can then be given to the loader with --morphology-store.
+     * Every morphology is parsed once, whatever the number of cells using it.
+     *
+     * @param circuitConfig URI of the Circuit Config file
+     * @param target Target to be converted. If empty, the target specified in
+     *        the circuit configuration file is used. If such an entry does
+     *        not exist, all neurons are converted.
+     * @param filename Morphology store file to save
+     * @return True if the store is successfully saved, false otherwise
+     */
+    bool saveMorphologyStore(
+        const servus::URI& circuitConfig,
+        const std::string& target,
+        const std::string& filename );
+
+    /** Saves a subset of the simulation cache file given by the geometry
+     * parameters to a new cache file: the frames within the start and end
+     * simulation times, and the cells of the target. Values are copied from
+     * the cache, the compartment report is not read.
+     *
+     * @param circuitConfig URI of the Circuit Config file, only used to load
+     *        the target
+     * @param target Target of the cells to save. If empty, all cells of the
+     *        cache are saved.
+     * @param filename Simulation cache file to save
+     * @return True if the cache file is successfully saved, false otherwise
+     */
+    bool saveSimulationSubset(
+        const servus::URI& circuitConfig,
+        const std::string& target,
+        const std::string& filename );
+
     /** Imports simulation data into the scene
      * @param circuitConfig URI of the Circuit Config file
      * @param target Target to be loaded. If empty, the target specified in the
@@ -120,17 +265,46 @@ private:
         const servus::URI& source,
         size_t morphologyIndex,
         const Matrix4f& transformation,
+        GeometryQuality geometryQuality,
+        size_t morphologySectionTypes,
         const SimulationInformation* simulationInformation,
-        PrimitivesMap& primitives,
+        ParallelSceneContainer& container,
         Boxf& bounds,
         const size_t simulationOffset,
         float& maxDistanceToSoma);
 
+    MorphologyDataPtr _loadMorphology( const servus::URI& source );
+    MorphologyDataPtr _parseMorphology( const servus::URI& source );
+    floats _getMaxDistancesToSoma( const std::vector< servus::URI >& uris );
+
+    void _importCells(
+        const std::vector< servus::URI >& uris,
+        const Matrix4fs& transforms,
+        const size_ts& cellIndices,
+        size_t begin,
+        size_t end,
+        const std::function< size_ts( const floats& ) >& getSimulationOffsets,
+        const Scene* scene,
+        GeometryBatch& batch );
+
+    bool _importInstancedCircuit(
+        const std::vector< servus::URI >& uris,
+        const Matrix4fs& transforms,
+        Scene& scene );
+
+    bool _isInstancingSupported() const;
+
     size_t _material(
         size_t morphologyIndex,
         size_t sectionType );
 
     GeometryParameters _geometryParameters;
+
+    // Parsed morphologies, shared by the cells of the circuit
+    std::shared_ptr< MorphologyCache > _morphologyCache;
+
+    // Preprocessed morphologies, read instead of the morphology files
+    std::shared_ptr< MorphologyStore > _morphologyStore;
 };
 
 }
@@ -0,0 +1,339 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "MorphologyStore.h"
+
+#include <brayns/common/log.h>
+
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace brayns
+{
+
+namespace
+{
+const char MORPHOLOGY_STORE_MAGIC[8] =
+    { 'B', 'R', 'A', 'Y', 'N', 'S', 'M', 'S' };
+
+// Records and index entries start on 8 bytes boundaries
+const uint64_t MORPHOLOGY_STORE_ALIGNMENT = 8;
+
+/** Section as stored in the file */
+struct StoredSection
+{
+    uint32_t type;
+    float distanceToSoma;
+    uint64_t firstSample;
+    uint64_t nbSamples;
+};
+
+/** Fixed size part of a morphology record, followed by the sections, the
+ * samples and the distances to soma of the samples */
+struct StoredMorphology
+{
+    float somaCentroid[3];
+    float somaMeanRadius;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t nbSections;
+    uint64_t nbSamples;
+};
+
+static_assert( sizeof( Vector4f ) == 4 * sizeof( float ),
+               "Samples are stored as arrays of 4 floats" );
+
+void _pad( std::ofstream& file )
+{
+    const uint64_t position = file.tellp();
+    const uint64_t padding = ( MORPHOLOGY_STORE_ALIGNMENT -
+        position % MORPHOLOGY_STORE_ALIGNMENT ) % MORPHOLOGY_STORE_ALIGNMENT;
+    const char zeros[MORPHOLOGY_STORE_ALIGNMENT] = {};
+    file.write( zeros, padding );
+}
+
+template< typename T >
+void _write( std::ofstream& file, const T& value )
+{
+    file.write( ( const char* )&value, sizeof( T ));
+}
+
+template< typename T >
+bool _read( const char*& cursor, const char* end, T& value )
+{
+    if( cursor + sizeof( T ) > end )
+        return false;
+    memcpy( &value, cursor, sizeof( T ));
+    cursor += sizeof( T );
+    return true;
+}
+
+uint64_t _align( const uint64_t offset )
+{
+    return ( offset + MORPHOLOGY_STORE_ALIGNMENT - 1 ) /
+        MORPHOLOGY_STORE_ALIGNMENT * MORPHOLOGY_STORE_ALIGNMENT;
+}
+}
+
+MorphologyStore::MorphologyStore()
+    : _data( 0 )
+    , _size( 0 )
+{
+}
+
+MorphologyStore::~MorphologyStore()
+{
+    _close();
+}
+
+bool MorphologyStore::save(
+    const std::string& filename,
+    const MorphologyDataMap& morphologies )
+{
+    std::ofstream file( filename, std::ios::out | std::ios::binary );
+    if( !file.good( ))
+    {
+        BRAYNS_ERROR << "Could not create morphology store " << filename
+                     << std::endl;
+        return false;
+    }
+
+    // The offset of the index is only known once the records are written
+    file.write( MORPHOLOGY_STORE_MAGIC, sizeof( MORPHOLOGY_STORE_MAGIC ));
+    _write( file, MORPHOLOGY_STORE_VERSION );
+    _write( file, uint64_t( morphologies.size( )));
+    const uint64_t indexOffsetPosition = file.tellp();
+    _write( file, uint64_t( 0 ));
+
+    std::vector< uint64_t > offsets;
+    offsets.reserve( morphologies.size( ));
+    for( const auto& morphology: morphologies )
+    {
+        const MorphologyData& data = *morphology.second;
+        offsets.push_back( file.tellp( ));
+
+        const StoredMorphology record =
+        {
+            { data.somaCentroid.x(), data.somaCentroid.y(),
+              data.somaCentroid.z() },
+            data.somaMeanRadius,
+            { data.bounds.getMin().x(), data.bounds.getMin().y(),
+              data.bounds.getMin().z() },
+            { data.bounds.getMax().x(), data.bounds.getMax().y(),
+              data.bounds.getMax().z() },
+            data.sections.size(),
+            data.samples.size()
+        };
+        _write( file, record );
+        for( const auto& section: data.sections )
+        {
+            const StoredSection storedSection =
+            {
+                uint32_t( section.type ), section.distanceToSoma,
+                section.firstSample, section.nbSamples
+            };
+            _write( file, storedSection );
+        }
+        file.write( ( const char* )data.samples.data(),
+                    data.samples.size() * sizeof( Vector4f ));
+        file.write( ( const char* )data.sampleDistancesToSoma.data(),
+                    data.sampleDistancesToSoma.size() * sizeof( float ));
+        _pad( file );
+    }
+
+    const uint64_t indexOffset = file.tellp();
+    size_t i = 0;
+    for( const auto& morphology: morphologies )
+    {
+        _write( file, uint64_t( morphology.first.size( )));
+        _write( file, offsets[i++] );
+        file.write( morphology.first.data(), morphology.first.size( ));
+        _pad( file );
+    }
+
+    file.seekp( indexOffsetPosition );
+    _write( file, indexOffset );
+    file.close();
+
+    if( !file.good( ))
+    {
+        BRAYNS_ERROR << "Failed to write morphology store " << filename
+                     << std::endl;
+        return false;
+    }
+    BRAYNS_INFO << morphologies.size() << " morphologies saved to "
+                << filename << std::endl;
+    return true;
+}
+
+bool MorphologyStore::open( const std::string& filename )
+{
+    _close();
+
+    const int fd = ::open( filename.c_str(), O_RDONLY );
+    if( fd == -1 )
+    {
+        BRAYNS_ERROR << "Could not open morphology store " << filename
+                     << std::endl;
+        return false;
+    }
+
+    struct stat sb;
+    if( ::fstat( fd, &sb ) == -1 || sb.st_size == 0 )
+    {
+        BRAYNS_ERROR << "Could not open morphology store " << filename
+                     << std::endl;
+        ::close( fd );
+        return false;
+    }
+
+    void* memoryMap = ::mmap( 0, sb.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if( memoryMap == MAP_FAILED )
+    {
+        BRAYNS_ERROR << "Could not map morphology store " << filename
+                     << std::endl;
+        return false;
+    }
+    _data = static_cast< const char* >( memoryMap );
+    _size = sb.st_size;
+
+    const char* end = _data + _size;
+    const char* cursor = _data;
+    char magic[sizeof( MORPHOLOGY_STORE_MAGIC )];
+    uint64_t version = 0;
+    uint64_t nbMorphologies = 0;
+    uint64_t indexOffset = 0;
+    bool valid =
+        _read( cursor, end, magic ) &&
+        memcmp( magic, MORPHOLOGY_STORE_MAGIC, sizeof( magic )) == 0 &&
+        _read( cursor, end, version ) &&
+        version == MORPHOLOGY_STORE_VERSION &&
+        _read( cursor, end, nbMorphologies ) &&
+        _read( cursor, end, indexOffset ) &&
+        indexOffset <= _size;
+
+    cursor = _data + indexOffset;
+    for( uint64_t i = 0; valid && i < nbMorphologies; ++i )
+    {
+        uint64_t length = 0;
+        uint64_t offset = 0;
+        valid = _read( cursor, end, length ) && _read( cursor, end, offset ) &&
+                length <= uint64_t( end - cursor ) && offset < indexOffset;
+        if( !valid )
+            break;
+        _offsets[std::string( cursor, length )] = offset;
+        cursor = _data + _align( cursor - _data + length );
+    }
+
+    if( !valid )
+    {
+        BRAYNS_ERROR << "Invalid morphology store " << filename << std::endl;
+        _close();
+        return false;
+    }
+
+    BRAYNS_INFO << "Morphology store " << filename << " holds "
+                << _offsets.size() << " morphologies" << std::endl;
+    return true;
+}
+
+bool MorphologyStore::contains( const std::string& uri ) const
+{
+    return _offsets.find( uri ) != _offsets.end();
+}
+
+MorphologyDataPtr MorphologyStore::get( const std::string& uri ) const
+{
+    const auto offset = _offsets.find( uri );
+    if( offset == _offsets.end( ))
+        return MorphologyDataPtr();
+
+    const char* end = _data + _size;
+    const char* cursor = _data + offset->second;
+    StoredMorphology record;
+    if( !_read( cursor, end, record ) ||
+        record.nbSections > uint64_t( end - cursor ) / sizeof( StoredSection ))
+    {
+        BRAYNS_ERROR << "Corrupted morphology " << uri << " in store"
+                     << std::endl;
+        return MorphologyDataPtr();
+    }
+
+    const char* sections = cursor;
+    const char* samples = sections + record.nbSections * sizeof( StoredSection );
+    if( record.nbSamples > uint64_t( end - samples ) /
+            ( sizeof( Vector4f ) + sizeof( float )))
+    {
+        BRAYNS_ERROR << "Corrupted morphology " << uri << " in store"
+                     << std::endl;
+        return MorphologyDataPtr();
+    }
+    const char* distances = samples + record.nbSamples * sizeof( Vector4f );
+
+    std::shared_ptr< MorphologyData > data( new MorphologyData );
+    data->somaCentroid = Vector3f( record.somaCentroid[0],
+        record.somaCentroid[1], record.somaCentroid[2] );
+    data->somaMeanRadius = record.somaMeanRadius;
+    data->bounds = Boxf(
+        Vector3f( record.boundsMin[0], record.boundsMin[1],
+                  record.boundsMin[2] ),
+        Vector3f( record.boundsMax[0], record.boundsMax[1],
+                  record.boundsMax[2] ));
+
+    data->sections.resize( record.nbSections );
+    for( size_t i = 0; i < record.nbSections; ++i )
+    {
+        StoredSection section;
+        memcpy( &section, sections + i * sizeof( StoredSection ),
+                sizeof( StoredSection ));
+        if( section.firstSample + section.nbSamples > record.nbSamples )
+        {
+            BRAYNS_ERROR << "Corrupted morphology " << uri << " in store"
+                         << std::endl;
+            return MorphologyDataPtr();
+        }
+        data->sections[i] = { section.type, section.distanceToSoma,
+                              section.firstSample, section.nbSamples };
+    }
+
+    data->samples.resize( record.nbSamples );
+    memcpy( data->samples.data(), samples,
+            record.nbSamples * sizeof( Vector4f ));
+    data->sampleDistancesToSoma.resize( record.nbSamples );
+    memcpy( data->sampleDistancesToSoma.data(), distances,
+            record.nbSamples * sizeof( float ));
+    return data;
+}
+
+void MorphologyStore::_close()
+{
+    if( _data )
+        ::munmap( const_cast< char* >( _data ), _size );
+    _data = 0;
+    _size = 0;
+    _offsets.clear();
+}
+
+}
@@ -0,0 +1,92 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MORPHOLOGYSTORE_H
+#define MORPHOLOGYSTORE_H
+
+#include <brayns/api.h>
+#include <brayns/common/types.h>
+#include <brayns/io/MorphologyCache.h>
+
+#include <string>
+#include <unordered_map>
+
+namespace brayns
+{
+
+// Version of the morphology store files
+const uint64_t MORPHOLOGY_STORE_VERSION = 1;
+
+typedef std::map< std::string, MorphologyDataPtr > MorphologyDataMap;
+
+/** Reads and writes Brayns native binary morphology files. A store holds
+ * parsed morphologies, keyed by the URI of the file they were parsed from,
+ * with the section types, samples and distances to soma of every morphology
+ * in contiguous arrays. Stores are memory mapped when opened, and loading a
+ * morphology only copies its arrays.
+ */
+class MorphologyStore
+{
+public:
+    BRAYNS_API MorphologyStore();
+    BRAYNS_API ~MorphologyStore();
+
+    /** Saves morphologies to a store file
+     *
+     * @param filename Store file
+     * @param morphologies Morphologies to save, keyed by URI
+     * @return True if the file was successfully saved, false otherwise
+     */
+    BRAYNS_API static bool save(
+        const std::string& filename,
+        const MorphologyDataMap& morphologies );
+
+    /** Maps a store file and reads its index
+     *
+     * @param filename Store file
+     * @return True if the file is a valid store, false otherwise
+     */
+    BRAYNS_API bool open( const std::string& filename );
+
+    /** Returns true if the store holds the morphology of the given URI */
+    BRAYNS_API bool contains( const std::string& uri ) const;
+
+    /** Loads a morphology from the store
+     *
+     * @param uri URI of the morphology file the morphology was parsed from
+     * @return The morphology, or an empty pointer if the store does not hold
+     *         it or if it is corrupted
+     */
+    BRAYNS_API MorphologyDataPtr get( const std::string& uri ) const;
+
+    /** Returns the number of morphologies in the store */
+    BRAYNS_API size_t getSize() const { return _offsets.size(); }
+
+private:
+    void _close();
+
+    const char* _data;
+    size_t _size;
+    std::unordered_map< std::string, uint64_t > _offsets;
+};
+
+}
+
+#endif // MORPHOLOGYSTORE_H
@@ -443,28 +443,28 @@ bool ProteinLoader::importPDBFile(
                     ++i;
                 }
 
-                SpherePtr sphere(new Sphere(
-                    0, Vector3f(
+                const Sphere sphere(
+                    Vector3f(
                         position[0] + 0.01f*atom.position[0],
                         position[1] + 0.01f*atom.position[1],
                         position[2] + 0.01f*atom.position[2]),
                     0.0001f * atom.radius *
                     _geometryParameters.getRadiusMultiplier(),
-                    0.f, 0.f));
+                    0.f, 0.f);
 
                 if( colorScheme == CS_PROTEIN_BACKBONE )
                 {
-                    Vector3f inView( sphere->getCenter() - inViewPos );
+                    Vector3f inView( sphere.center - inViewPos );
                     float dist = inView.length();
                     if( dist > inViewRadius )
                     {
                         atom.materialId = ( dist < (inViewRadius+0.1) ) ? 1 : 0;
-                        scene.getPrimitives()[atom.materialId].push_back(sphere);
+                        scene.getSpheres()[atom.materialId].push_back(sphere);
                     }
                 }
                 else
-                    scene.getPrimitives()[atom.materialId].push_back(sphere);
-                scene.getWorldBounds().merge(sphere->getCenter());
+                    scene.getSpheres()[atom.materialId].push_back(sphere);
+                scene.getWorldBounds().merge(sphere.center);
             }
         }
         file.close();
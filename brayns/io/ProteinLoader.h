@@ -23,7 +23,6 @@
 
 #include <brayns/common/types.h>
 #include <brayns/common/material/Material.h>
-#include <brayns/common/geometry/Primitive.h>
 #include <brayns/parameters/GeometryParameters.h>
 #include <string>
 
@@ -0,0 +1,408 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SWCParser.h"
+
+#include <cmath>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace brayns
+{
+
+namespace
+{
+const int64_t SWC_NO_PARENT = -1;
+const size_t SWC_SOMA = 1;
+const int64_t NO_POINT = -1;
+
+struct SWCPoint
+{
+    int64_t id;
+    size_t type;
+    Vector3f position;
+    float radius;
+    int64_t parent;
+};
+typedef std::vector< SWCPoint > SWCPoints;
+
+const double POWERS_OF_TEN[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+    1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+const int MAX_POWER_OF_TEN = 22;
+
+inline bool _isSpace( const char c )
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool _isDigit( const char c )
+{
+    return c >= '0' && c <= '9';
+}
+
+inline void _skipSpaces( const char*& cursor, const char* end )
+{
+    while( cursor < end && _isSpace( *cursor ))
+        ++cursor;
+}
+
+inline void _skipLine( const char*& cursor, const char* end )
+{
+    while( cursor < end && *cursor != '\n' )
+        ++cursor;
+    if( cursor < end )
+        ++cursor;
+}
+
+/** Parses an optionally signed integer */
+bool _parseInteger( const char*& cursor, const char* end, int64_t& value )
+{
+    _skipSpaces( cursor, end );
+    bool negative = false;
+    if( cursor < end && ( *cursor == '-' || *cursor == '+' ))
+        negative = *cursor++ == '-';
+    if( cursor == end || !_isDigit( *cursor ))
+        return false;
+
+    value = 0;
+    while( cursor < end && _isDigit( *cursor ))
+        value = value * 10 + ( *cursor++ - '0' );
+    if( negative )
+        value = -value;
+    return true;
+}
+
+/** Parses a decimal number with an optional sign, fraction and exponent */
+bool _parseFloat( const char*& cursor, const char* end, float& value )
+{
+    _skipSpaces( cursor, end );
+    bool negative = false;
+    if( cursor < end && ( *cursor == '-' || *cursor == '+' ))
+        negative = *cursor++ == '-';
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    bool digits = false;
+    while( cursor < end && _isDigit( *cursor ))
+    {
+        mantissa = mantissa * 10.0 + ( *cursor++ - '0' );
+        digits = true;
+    }
+    if( cursor < end && *cursor == '.' )
+    {
+        ++cursor;
+        while( cursor < end && _isDigit( *cursor ))
+        {
+            mantissa = mantissa * 10.0 + ( *cursor++ - '0' );
+            --exponent;
+            digits = true;
+        }
+    }
+    if( !digits )
+        return false;
+
+    if( cursor < end && ( *cursor == 'e' || *cursor == 'E' ))
+    {
+        ++cursor;
+        int64_t power = 0;
+        if( !_parseInteger( cursor, end, power ))
+            return false;
+        exponent += int( power );
+    }
+
+    double result = mantissa;
+    if( exponent < 0 )
+    {
+        if( -exponent <= MAX_POWER_OF_TEN )
+            result /= POWERS_OF_TEN[-exponent];
+        else
+            result *= std::pow( 10.0, exponent );
+    }
+    else if( exponent > 0 )
+    {
+        if( exponent <= MAX_POWER_OF_TEN )
+            result *= POWERS_OF_TEN[exponent];
+        else
+            result *= std::pow( 10.0, exponent );
+    }
+    value = float( negative ? -result : result );
+    return true;
+}
+
+/** Reads the points of the file, in file order */
+SWCPoints _parsePoints( const char* cursor, const char* end )
+{
+    SWCPoints points;
+    size_t line = 1;
+    while( cursor < end )
+    {
+        _skipSpaces( cursor, end );
+        if( cursor == end )
+            break;
+        if( *cursor == '#' || *cursor == '\n' )
+        {
+            _skipLine( cursor, end );
+            ++line;
+            continue;
+        }
+
+        SWCPoint point;
+        int64_t type = 0;
+        if( !_parseInteger( cursor, end, point.id ) ||
+            !_parseInteger( cursor, end, type ) ||
+            !_parseFloat( cursor, end, point.position.x( )) ||
+            !_parseFloat( cursor, end, point.position.y( )) ||
+            !_parseFloat( cursor, end, point.position.z( )) ||
+            !_parseFloat( cursor, end, point.radius ) ||
+            !_parseInteger( cursor, end, point.parent ))
+        {
+            throw std::runtime_error(
+                "Invalid SWC point at line " + std::to_string( line ));
+        }
+        point.type = type < 0 ? 0 : size_t( type );
+        points.push_back( point );
+        _skipLine( cursor, end );
+        ++line;
+    }
+    return points;
+}
+
+/** Returns the index of the parent of every point, NO_POINT for roots */
+std::vector< int64_t > _parentIndices( const SWCPoints& points )
+{
+    std::vector< int64_t > parents( points.size(), NO_POINT );
+
+    // Identifiers are usually the line numbers of the points, starting at 1
+    bool sequential = true;
+    for( size_t i = 0; sequential && i < points.size(); ++i )
+        sequential = points[i].id == int64_t( i + 1 );
+
+    std::unordered_map< int64_t, int64_t > indices;
+    if( !sequential )
+        for( size_t i = 0; i < points.size(); ++i )
+            indices[points[i].id] = i;
+
+    for( size_t i = 0; i < points.size(); ++i )
+    {
+        const int64_t parent = points[i].parent;
+        if( parent == SWC_NO_PARENT )
+            continue;
+        if( sequential )
+        {
+            if( parent >= 1 && parent <= int64_t( points.size( )))
+                parents[i] = parent - 1;
+        }
+        else
+        {
+            const auto index = indices.find( parent );
+            if( index != indices.end( ))
+                parents[i] = index->second;
+        }
+        if( parents[i] == int64_t( i ))
+            parents[i] = NO_POINT;
+    }
+    return parents;
+}
+}
+
+MorphologyDataPtr SWCParser::parseFile( const std::string& filename )
+{
+    const int fd = ::open( filename.c_str(), O_RDONLY );
+    if( fd == -1 )
+        throw std::runtime_error( "Could not open " + filename );
+
+    struct stat sb;
+    if( ::fstat( fd, &sb ) == -1 )
+    {
+        ::close( fd );
+        throw std::runtime_error( "Could not open " + filename );
+    }
+    if( sb.st_size == 0 )
+    {
+        ::close( fd );
+        return parse( 0, 0 );
+    }
+
+    void* memoryMap = ::mmap( 0, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if( memoryMap == MAP_FAILED )
+        throw std::runtime_error( "Could not map " + filename );
+    ::madvise( memoryMap, sb.st_size, MADV_SEQUENTIAL );
+
+    const char* begin = static_cast< const char* >( memoryMap );
+    try
+    {
+        MorphologyDataPtr morphology = parse( begin, begin + sb.st_size );
+        ::munmap( memoryMap, sb.st_size );
+        return morphology;
+    }
+    catch( const std::runtime_error& e )
+    {
+        ::munmap( memoryMap, sb.st_size );
+        throw std::runtime_error( filename + ": " + e.what( ));
+    }
+}
+
+MorphologyDataPtr SWCParser::parse( const char* begin, const char* end )
+{
+    const SWCPoints points = _parsePoints( begin, end );
+    const std::vector< int64_t > parents = _parentIndices( points );
+    const size_t nbPoints = points.size();
+
+    // Children of every point, in file order
+    std::vector< size_t > firstChild( nbPoints + 1, 0 );
+    for( size_t i = 0; i < nbPoints; ++i )
+        if( parents[i] != NO_POINT )
+            ++firstChild[parents[i] + 1];
+    for( size_t i = 0; i < nbPoints; ++i )
+        firstChild[i + 1] += firstChild[i];
+    std::vector< size_t > children( firstChild[nbPoints] );
+    {
+        std::vector< size_t > position( firstChild.begin(),
+                                        firstChild.end() - 1 );
+        for( size_t i = 0; i < nbPoints; ++i )
+            if( parents[i] != NO_POINT )
+                children[position[parents[i]]++] = i;
+    }
+    const auto nbChildren = [&firstChild]( const size_t i )
+        { return firstChild[i + 1] - firstChild[i]; };
+    const auto isSoma = [&points]( const int64_t i )
+        { return i != NO_POINT && points[i].type == SWC_SOMA; };
+
+    std::shared_ptr< MorphologyData > data( new MorphologyData );
+
+    // Soma
+    size_t nbSomaPoints = 0;
+    Vector3f centroid;
+    for( const auto& point: points )
+    {
+        data->bounds.merge( point.position );
+        if( point.type == SWC_SOMA )
+        {
+            centroid += point.position;
+            ++nbSomaPoints;
+        }
+    }
+    if( nbSomaPoints > 0 )
+    {
+        centroid = centroid / float( nbSomaPoints );
+        float meanDistance = 0.f;
+        float meanRadius = 0.f;
+        for( const auto& point: points )
+            if( point.type == SWC_SOMA )
+            {
+                meanDistance += ( point.position - centroid ).length();
+                meanRadius += point.radius;
+            }
+        meanDistance /= float( nbSomaPoints );
+        meanRadius /= float( nbSomaPoints );
+        data->somaCentroid = centroid;
+        data->somaMeanRadius = meanDistance > 0.f ? meanDistance : meanRadius;
+    }
+    else if( nbPoints > 0 )
+    {
+        data->somaCentroid = points[0].position;
+        data->somaMeanRadius = points[0].radius;
+    }
+    else
+        data->somaMeanRadius = 0.f;
+
+    // Path length from the soma to every point. Points are visited from the
+    // roots, whatever the order of the file
+    floats distances( nbPoints, 0.f );
+    std::vector< size_t > stack;
+    for( size_t i = 0; i < nbPoints; ++i )
+        if( parents[i] == NO_POINT )
+            stack.push_back( i );
+    while( !stack.empty( ))
+    {
+        const size_t i = stack.back();
+        stack.pop_back();
+        const int64_t parent = parents[i];
+        if( parent != NO_POINT && !isSoma( parent ) && !isSoma( i ))
+            distances[i] = distances[parent] +
+                ( points[i].position - points[parent].position ).length();
+        for( size_t c = firstChild[i]; c < firstChild[i + 1]; ++c )
+            stack.push_back( children[c] );
+    }
+
+    const auto addSample = [&data, &points, &distances](
+        const size_t i, const float distanceToSoma )
+    {
+        const SWCPoint& point = points[i];
+        data->samples.push_back( Vector4f( point.position.x(),
+            point.position.y(), point.position.z(), point.radius * 2.f ));
+        data->sampleDistancesToSoma.push_back( distances[i] - distanceToSoma );
+    };
+
+    // The soma section holds the soma points when the soma has a contour
+    if( nbSomaPoints > 1 )
+    {
+        MorphologySection section = { SWC_SOMA, 0.f, 0, 0 };
+        for( size_t i = 0; i < nbPoints; ++i )
+            if( points[i].type == SWC_SOMA )
+                addSample( i, 0.f );
+        section.nbSamples = data->samples.size();
+        data->sections.push_back( section );
+    }
+
+    // Neurite sections, in the order of their first point in the file
+    for( size_t i = 0; i < nbPoints; ++i )
+    {
+        if( points[i].type == SWC_SOMA )
+            continue;
+        const int64_t parent = parents[i];
+        const bool startsSection =
+            parent == NO_POINT || isSoma( parent ) ||
+            nbChildren( parent ) > 1 || points[parent].type != points[i].type;
+        if( !startsSection )
+            continue;
+
+        const bool attached = parent != NO_POINT && !isSoma( parent );
+        const float distanceToSoma = attached ? distances[parent] : 0.f;
+        MorphologySection section =
+            { points[i].type, distanceToSoma, data->samples.size(), 0 };
+        if( attached )
+            addSample( parent, distanceToSoma );
+
+        size_t point = i;
+        addSample( point, distanceToSoma );
+        while( nbChildren( point ) == 1 )
+        {
+            const size_t child = children[firstChild[point]];
+            if( points[child].type != points[point].type )
+                break;
+            point = child;
+            addSample( point, distanceToSoma );
+        }
+        section.nbSamples = data->samples.size() - section.firstSample;
+        data->sections.push_back( section );
+    }
+    return data;
+}
+
+}
@@ -0,0 +1,65 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef SWCPARSER_H
+#define SWCPARSER_H
+
+#include <brayns/api.h>
+#include <brayns/common/types.h>
+#include <brayns/io/MorphologyCache.h>
+
+#include <string>
+
+namespace brayns
+{
+
+/** Parses SWC morphology files without Brion. Files are memory mapped and
+ * parsed in place, with a number parser limited to the syntax of SWC files.
+ *
+ * Points of type 1 form the soma. Sections start at the points attached to
+ * the soma and after every branching point, and end at the next branching
+ * point or at a leaf. A section attached to another section starts with the
+ * last point of its parent, so that consecutive sections are connected.
+ */
+class SWCParser
+{
+public:
+    /** Parses an SWC file
+     *
+     * @param filename SWC file
+     * @return the parsed morphology
+     * @throw std::runtime_error if the file cannot be read or is invalid
+     */
+    BRAYNS_API static MorphologyDataPtr parseFile( const std::string& filename );
+
+    /** Parses the content of an SWC file held in memory
+     *
+     * @param begin Start of the content
+     * @param end End of the content
+     * @return the parsed morphology
+     * @throw std::runtime_error if the content is invalid
+     */
+    BRAYNS_API static MorphologyDataPtr parse( const char* begin,
+                                               const char* end );
+};
+
+}
+
+#endif // SWCPARSER_H
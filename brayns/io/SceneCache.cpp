@@ -0,0 +1,663 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SceneCache.h"
+
+#include <brayns/common/log.h>
+#include <brayns/common/geometry/Sphere.h>
+#include <brayns/common/geometry/Cylinder.h>
+#include <brayns/common/geometry/Cone.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef BRAYNS_USE_ZLIB
+#  include <zlib.h>
+#endif
+
+namespace brayns
+{
+
+// Alignment of the primitive sections of uncompressed cache files. Sections
+// start on a page boundary so that they can be memory mapped and shared with
+// the rendering engine as is
+const uint64_t CACHE_SECTION_ALIGNMENT = 4096;
+
+// Size of the chunks of compressed cache files, in uncompressed bytes
+const uint64_t COMPRESSED_CACHE_CHUNK_SIZE = 1 << 22;
+
+namespace
+{
+/** Returns the offset of the first cache section starting at or after the
+ * given offset */
+uint64_t _alignCacheOffset( const uint64_t offset )
+{
+    return ( offset + CACHE_SECTION_ALIGNMENT - 1 ) /
+        CACHE_SECTION_ALIGNMENT * CACHE_SECTION_ALIGNMENT;
+}
+
+/** Writes the number of timestamp indices of a primitive array, followed by
+ * the indices */
+void _writeTimestampIndices(
+    std::ofstream& file,
+    const TimestampIndices& timestampIndices )
+{
+    const size_t nbIndices = timestampIndices.size();
+    file.write( ( char* )&nbIndices, sizeof( size_t ));
+    for( const auto& index: timestampIndices )
+    {
+        file.write( ( char* )&index.first, sizeof( size_t ));
+        file.write( ( char* )&index.second, sizeof( size_t ));
+    }
+}
+
+/** Writes the timestamp indices of a primitive array, followed by the
+ * location of the primitives in the cache file
+ *
+ * @param offset Offset of the section in the file. Returns the offset of the
+ *        next section
+ */
+void _writeCacheSectionHeader(
+    std::ofstream& file,
+    const TimestampIndices& timestampIndices,
+    const uint64_t size,
+    uint64_t& offset )
+{
+    _writeTimestampIndices( file, timestampIndices );
+    file.write( ( char* )&offset, sizeof( uint64_t ));
+    file.write( ( char* )&size, sizeof( uint64_t ));
+    offset = _alignCacheOffset( offset + size );
+}
+
+/** Pads the file up to the next section boundary and writes the section */
+void _writeCacheSection( std::ofstream& file, const void* data,
+                         const uint64_t size )
+{
+    const uint64_t position = file.tellp();
+    const std::vector< char > padding( _alignCacheOffset( position ) - position );
+    file.write( padding.data(), padding.size( ));
+    file.write( ( const char* )data, size );
+}
+
+/** Reads a value from the header of a cache file held in memory
+ *
+ * @return False if the value lies beyond the end of the file
+ */
+template< typename T >
+bool _readCacheValue( const char*& cursor, const char* end, T& value )
+{
+    if( cursor + sizeof( T ) > end )
+        return false;
+    memcpy( &value, cursor, sizeof( T ));
+    cursor += sizeof( T );
+    return true;
+}
+
+/** Reads the timestamp indices and the location of a primitive array from the
+ * header of a cache file held in memory
+ *
+ * @param begin Start of the file in memory
+ * @param end End of the file in memory
+ * @return False if the header or the primitives lie beyond the end of the file
+ */
+bool _readCacheSectionHeader(
+    const char*& cursor,
+    const char* begin,
+    const char* end,
+    SceneCacheSection& section )
+{
+    size_t nbIndices = 0;
+    if( !_readCacheValue( cursor, end, nbIndices ))
+        return false;
+    for( size_t i = 0; i < nbIndices; ++i )
+    {
+        size_t ts = 0;
+        size_t index = 0;
+        if( !_readCacheValue( cursor, end, ts ) ||
+            !_readCacheValue( cursor, end, index ))
+            return false;
+        section.timestampIndices[ts] = index;
+    }
+
+    uint64_t offset = 0;
+    if( !_readCacheValue( cursor, end, offset ) ||
+        !_readCacheValue( cursor, end, section.size ))
+        return false;
+    if( offset % CACHE_SECTION_ALIGNMENT != 0 ||
+        offset > uint64_t( end - begin ) ||
+        section.size > uint64_t( end - begin ) - offset )
+        return false;
+    section.data = begin + offset;
+    return true;
+}
+
+bool _save(
+    const std::string& filename,
+    const SceneCacheContainer& container,
+    const size_t nbMaterials,
+    const Boxf& bounds )
+{
+    BRAYNS_INFO << "Saving scene to binary file: " << filename << std::endl;
+    std::ofstream file( filename, std::ios::out | std::ios::binary );
+    if( !file.good( ))
+    {
+        BRAYNS_ERROR << "Could not create cache file " << filename
+                     << std::endl;
+        return false;
+    }
+
+    // The header holds the version, the scene bounds and, for every material
+    // and type of primitive, the timestamp indices and the location of the
+    // primitives. Primitives follow in page aligned sections so that they can
+    // be memory mapped when the cache is loaded
+    uint64_t headerSize = 2 * sizeof( size_t ) + sizeof( Boxf );
+    for( size_t materialId = 0; materialId < nbMaterials; ++materialId )
+    {
+        const size_t nbIndices =
+            container.timestampSpheresIndices[materialId].size() +
+            container.timestampCylindersIndices[materialId].size() +
+            container.timestampConesIndices[materialId].size();
+        headerSize += 3 * ( sizeof( size_t ) + 2 * sizeof( uint64_t )) +
+                      nbIndices * 2 * sizeof( size_t );
+    }
+
+    const size_t version = CACHE_VERSION;
+    file.write( ( char* )&version, sizeof( size_t ));
+    BRAYNS_INFO << "Version: " << version << std::endl;
+
+    file.write( ( char* )&nbMaterials, sizeof( size_t ));
+    BRAYNS_INFO << nbMaterials << " materials" << std::endl;
+
+    file.write( ( char* )&bounds, sizeof( Boxf ));
+    BRAYNS_INFO << bounds << std::endl;
+
+    uint64_t offset = _alignCacheOffset( headerSize );
+    for( size_t materialId = 0; materialId < nbMaterials; ++materialId )
+    {
+        _writeCacheSectionHeader( file,
+            container.timestampSpheresIndices[materialId],
+            container.spheres[materialId].size() * sizeof( Sphere ), offset );
+        _writeCacheSectionHeader( file,
+            container.timestampCylindersIndices[materialId],
+            container.cylinders[materialId].size() * sizeof( Cylinder ),
+            offset );
+        _writeCacheSectionHeader( file,
+            container.timestampConesIndices[materialId],
+            container.cones[materialId].size() * sizeof( Cone ), offset );
+    }
+
+    for( size_t materialId = 0; materialId < nbMaterials; ++materialId )
+    {
+        const Spheres& spheres = container.spheres[materialId];
+        _writeCacheSection( file, spheres.data(),
+                            spheres.size() * sizeof( Sphere ));
+        if( !spheres.empty( ))
+            BRAYNS_DEBUG << "[" << materialId << "] " << spheres.size()
+                         << " Spheres" << std::endl;
+
+        const Cylinders& cylinders = container.cylinders[materialId];
+        _writeCacheSection( file, cylinders.data(),
+                            cylinders.size() * sizeof( Cylinder ));
+        if( !cylinders.empty( ))
+            BRAYNS_DEBUG << "[" << materialId << "] " << cylinders.size()
+                         << " Cylinders" << std::endl;
+
+        const Cones& cones = container.cones[materialId];
+        _writeCacheSection( file, cones.data(), cones.size() * sizeof( Cone ));
+        if( !cones.empty( ))
+            BRAYNS_DEBUG << "[" << materialId << "] " << cones.size()
+                         << " Cones" << std::endl;
+    }
+
+    file.close();
+    BRAYNS_INFO << "Scene successfully saved"<< std::endl;
+    return true;
+}
+
+#ifdef BRAYNS_USE_ZLIB
+// Upper bound of the ratio between the uncompressed and the compressed size
+// of a zlib stream
+const uint64_t ZLIB_MAX_COMPRESSION_RATIO = 1032;
+
+/** Independently compressed chunk of a primitive array */
+struct CacheChunk
+{
+    char* data;              // Uncompressed data in memory
+    uint64_t size;           // Uncompressed size, in bytes
+    uint64_t offset;         // Offset of the compressed data in the file
+    uint64_t compressedSize; // Compressed size, in bytes
+    uint32_t checksum;       // CRC32 of the uncompressed data
+};
+
+/** Primitive array of a compressed cache file */
+struct CacheSection
+{
+    const TimestampIndices* timestampIndices;
+    uint64_t size;
+    size_t firstChunk;
+    size_t nbChunks;
+};
+
+/** Splits a primitive array into chunks to be compressed */
+void _addCompressedCacheSection(
+    const TimestampIndices& timestampIndices,
+    char* data,
+    const uint64_t size,
+    std::vector< CacheSection >& sections,
+    std::vector< CacheChunk >& chunks )
+{
+    CacheSection section;
+    section.timestampIndices = &timestampIndices;
+    section.size = size;
+    section.firstChunk = chunks.size();
+    for( uint64_t offset = 0; offset < size;
+         offset += COMPRESSED_CACHE_CHUNK_SIZE )
+    {
+        CacheChunk chunk;
+        chunk.data = data + offset;
+        chunk.size = std::min( COMPRESSED_CACHE_CHUNK_SIZE, size - offset );
+        chunk.offset = 0;
+        chunk.compressedSize = 0;
+        chunk.checksum = 0;
+        chunks.push_back( chunk );
+    }
+    section.nbChunks = chunks.size() - section.firstChunk;
+    sections.push_back( section );
+}
+
+/** Compresses a chunk of a primitive array. Can be called concurrently for
+ * different chunks
+ *
+ * @return False if the chunk could not be compressed
+ */
+bool _compressCacheChunk( CacheChunk& chunk, std::vector< Bytef >& compressed )
+{
+    const Bytef* source = reinterpret_cast< const Bytef* >( chunk.data );
+    uLongf compressedSize = compressBound( chunk.size );
+    compressed.resize( compressedSize );
+    if( compress2( compressed.data(), &compressedSize, source, chunk.size,
+                   Z_DEFAULT_COMPRESSION ) != Z_OK )
+        return false;
+    compressed.resize( compressedSize );
+    chunk.compressedSize = compressedSize;
+    chunk.checksum = crc32( 0, source, chunk.size );
+    return true;
+}
+
+/** Reads the timestamp indices and the chunk index of a primitive array from
+ * the header of a compressed cache file, and allocates the primitives. Chunks
+ * are validated before the primitives are allocated: they must follow each
+ * other within the file, and their compressed size must not be smaller than
+ * zlib can achieve, so that the allocation is bounded by the file size
+ *
+ * @param fileSize Size of the file, in bytes
+ * @param nextChunkOffset Offset at which the next chunk may start in the file
+ * @param chunks Returned chunks, pointing to the allocated primitives
+ * @return False if the header is inconsistent
+ */
+template< typename T >
+bool _readCompressedCacheSection(
+    std::ifstream& file,
+    const uint64_t fileSize,
+    uint64_t& nextChunkOffset,
+    TimestampIndices& timestampIndices,
+    std::vector< T >& primitives,
+    std::vector< CacheChunk >& chunks )
+{
+    size_t nbIndices = 0;
+    file.read( ( char* )&nbIndices, sizeof( size_t ));
+    timestampIndices.clear();
+    for( size_t i = 0; i < nbIndices && file.good(); ++i )
+    {
+        size_t ts = 0;
+        size_t index = 0;
+        file.read( ( char* )&ts, sizeof( size_t ));
+        file.read( ( char* )&index, sizeof( size_t ));
+        timestampIndices[ts] = index;
+    }
+
+    uint64_t size = 0;
+    uint64_t nbChunks = 0;
+    file.read( ( char* )&size, sizeof( uint64_t ));
+    file.read( ( char* )&nbChunks, sizeof( uint64_t ));
+    if( !file.good() || size % sizeof( T ) != 0 ||
+        nbChunks != ( size + COMPRESSED_CACHE_CHUNK_SIZE - 1 ) /
+                    COMPRESSED_CACHE_CHUNK_SIZE )
+        return false;
+
+    std::vector< CacheChunk > sectionChunks;
+    for( uint64_t i = 0; i < nbChunks; ++i )
+    {
+        CacheChunk chunk;
+        chunk.data = 0;
+        chunk.size = std::min( COMPRESSED_CACHE_CHUNK_SIZE,
+                               size - i * COMPRESSED_CACHE_CHUNK_SIZE );
+        file.read( ( char* )&chunk.offset, sizeof( uint64_t ));
+        file.read( ( char* )&chunk.compressedSize, sizeof( uint64_t ));
+        file.read( ( char* )&chunk.checksum, sizeof( uint32_t ));
+        if( !file.good() || chunk.compressedSize > compressBound( chunk.size ) ||
+            chunk.size / ZLIB_MAX_COMPRESSION_RATIO > chunk.compressedSize ||
+            chunk.offset < nextChunkOffset || chunk.offset > fileSize ||
+            chunk.compressedSize > fileSize - chunk.offset )
+        {
+            return false;
+        }
+        nextChunkOffset = chunk.offset + chunk.compressedSize;
+        sectionChunks.push_back( chunk );
+    }
+
+    primitives.resize( size / sizeof( T ));
+    char* data = ( char* )primitives.data();
+    for( uint64_t i = 0; i < nbChunks; ++i )
+    {
+        sectionChunks[i].data = data + i * COMPRESSED_CACHE_CHUNK_SIZE;
+        chunks.push_back( sectionChunks[i] );
+    }
+    return true;
+}
+
+/** Reads, decompresses and verifies a chunk of a compressed cache file. Can be
+ * called concurrently for different chunks
+ *
+ * @return False if the chunk could not be read or is corrupted
+ */
+bool _decompressCacheChunk( const int fd, const CacheChunk& chunk )
+{
+    std::vector< Bytef > compressed( chunk.compressedSize );
+    if( ::pread( fd, compressed.data(), compressed.size(), chunk.offset ) !=
+        ssize_t( compressed.size( )))
+        return false;
+
+    Bytef* data = reinterpret_cast< Bytef* >( chunk.data );
+    uLongf size = chunk.size;
+    return uncompress( data, &size, compressed.data(),
+                       compressed.size( )) == Z_OK &&
+           size == chunk.size && crc32( 0, data, size ) == chunk.checksum;
+}
+
+bool _saveCompressed(
+    const std::string& filename,
+    const SceneCacheContainer& container,
+    const size_t nbMaterials,
+    const Boxf& bounds )
+{
+    BRAYNS_INFO << "Saving compressed scene to binary file: " << filename
+                << std::endl;
+
+    std::vector< CacheSection > sections;
+    std::vector< CacheChunk > chunks;
+    for( size_t materialId = 0; materialId < nbMaterials; ++materialId )
+    {
+        Spheres& spheres = container.spheres[materialId];
+        _addCompressedCacheSection(
+            container.timestampSpheresIndices[materialId],
+            ( char* )spheres.data(), spheres.size() * sizeof( Sphere ),
+            sections, chunks );
+        Cylinders& cylinders = container.cylinders[materialId];
+        _addCompressedCacheSection(
+            container.timestampCylindersIndices[materialId],
+            ( char* )cylinders.data(), cylinders.size() * sizeof( Cylinder ),
+            sections, chunks );
+        Cones& cones = container.cones[materialId];
+        _addCompressedCacheSection(
+            container.timestampConesIndices[materialId],
+            ( char* )cones.data(), cones.size() * sizeof( Cone ),
+            sections, chunks );
+    }
+
+    std::vector< std::vector< Bytef >> compressed( chunks.size( ));
+    int nbFailures = 0;
+    #pragma omp parallel for reduction( +:nbFailures )
+    for( int64_t i = 0; i < int64_t( chunks.size( )); ++i )
+        if( !_compressCacheChunk( chunks[i], compressed[i] ))
+            ++nbFailures;
+
+    if( nbFailures != 0 )
+    {
+        BRAYNS_ERROR << "Failed to compress " << nbFailures << " chunks of "
+                     << filename << std::endl;
+        return false;
+    }
+
+    // The header holds the version, the scene bounds and, for every material
+    // and type of primitive, the timestamp indices and the index of the
+    // compressed chunks. Chunks follow, in the same order
+    uint64_t offset = 2 * sizeof( size_t ) + sizeof( Boxf ) +
+                      sizeof( uint64_t );
+    for( const auto& section: sections )
+        offset += sizeof( size_t ) + 2 * sizeof( uint64_t ) +
+                  section.timestampIndices->size() * 2 * sizeof( size_t ) +
+                  section.nbChunks * ( 2 * sizeof( uint64_t ) +
+                                       sizeof( uint32_t ));
+    for( auto& chunk: chunks )
+    {
+        chunk.offset = offset;
+        offset += chunk.compressedSize;
+    }
+
+    std::ofstream file( filename, std::ios::out | std::ios::binary );
+    if( !file.good( ))
+    {
+        BRAYNS_ERROR << "Could not create cache file " << filename
+                     << std::endl;
+        return false;
+    }
+
+    const size_t version = COMPRESSED_CACHE_VERSION;
+    file.write( ( char* )&version, sizeof( size_t ));
+    BRAYNS_INFO << "Version: " << version << std::endl;
+
+    file.write( ( char* )&nbMaterials, sizeof( size_t ));
+    BRAYNS_INFO << nbMaterials << " materials" << std::endl;
+
+    file.write( ( char* )&bounds, sizeof( Boxf ));
+    BRAYNS_INFO << bounds << std::endl;
+
+    const uint64_t chunkSize = COMPRESSED_CACHE_CHUNK_SIZE;
+    file.write( ( char* )&chunkSize, sizeof( uint64_t ));
+
+    for( const auto& section: sections )
+    {
+        _writeTimestampIndices( file, *section.timestampIndices );
+        const uint64_t nbChunks = section.nbChunks;
+        file.write( ( char* )&section.size, sizeof( uint64_t ));
+        file.write( ( char* )&nbChunks, sizeof( uint64_t ));
+        for( size_t i = 0; i < section.nbChunks; ++i )
+        {
+            const CacheChunk& chunk = chunks[section.firstChunk + i];
+            file.write( ( char* )&chunk.offset, sizeof( uint64_t ));
+            file.write( ( char* )&chunk.compressedSize, sizeof( uint64_t ));
+            file.write( ( char* )&chunk.checksum, sizeof( uint32_t ));
+        }
+    }
+
+    for( const auto& buffer: compressed )
+        file.write( ( char* )buffer.data(), buffer.size( ));
+
+    file.close();
+    BRAYNS_INFO << chunks.size() << " chunks, " << offset << " bytes"
+                << std::endl;
+    BRAYNS_INFO << "Scene successfully saved"<< std::endl;
+    return true;
+}
+#endif
+}
+
+size_t SceneCache::getVersion( const std::string& filename )
+{
+    std::ifstream file( filename, std::ios::in | std::ios::binary );
+    size_t version = 0;
+    if( file.good( ))
+        file.read( ( char* )&version, sizeof( size_t ));
+    return file.good() ? version : 0;
+}
+
+bool SceneCache::save(
+    const std::string& filename,
+    const SceneCacheContainer& container,
+    const size_t nbMaterials,
+    const Boxf& bounds,
+    const bool compress )
+{
+    if( compress )
+    {
+#ifdef BRAYNS_USE_ZLIB
+        return _saveCompressed( filename, container, nbMaterials, bounds );
+#else
+        BRAYNS_WARN << "Brayns is built without zlib, the scene is saved "
+                    << "uncompressed" << std::endl;
+#endif
+    }
+    return _save( filename, container, nbMaterials, bounds );
+}
+
+bool SceneCache::parse(
+    const char* begin,
+    const char* end,
+    const size_t maxMaterials,
+    SceneCacheMaterials& materials,
+    Boxf& bounds )
+{
+    const char* cursor = begin;
+    size_t version = 0;
+    size_t nbMaterials = 0;
+    if( !_readCacheValue( cursor, end, version ) ||
+        version != CACHE_VERSION ||
+        !_readCacheValue( cursor, end, nbMaterials ) ||
+        nbMaterials > maxMaterials ||
+        !_readCacheValue( cursor, end, bounds ))
+        return false;
+
+    materials.clear();
+    for( size_t materialId = 0; materialId < nbMaterials; ++materialId )
+    {
+        materials.push_back( SceneCacheMaterial( ));
+        SceneCacheMaterial& material = materials.back();
+        if( !_readCacheSectionHeader( cursor, begin, end, material.spheres ) ||
+            !_readCacheSectionHeader( cursor, begin, end,
+                                      material.cylinders ) ||
+            !_readCacheSectionHeader( cursor, begin, end, material.cones ) ||
+            material.spheres.size % sizeof( Sphere ) != 0 ||
+            material.cylinders.size % sizeof( Cylinder ) != 0 ||
+            material.cones.size % sizeof( Cone ) != 0 )
+        {
+            materials.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SceneCache::loadCompressed(
+    const std::string& filename,
+    const size_t maxMaterials,
+    SceneCacheContainer& container,
+    size_t& nbMaterials,
+    Boxf& bounds )
+{
+#ifdef BRAYNS_USE_ZLIB
+    std::ifstream file( filename, std::ios::in | std::ios::binary |
+                                  std::ios::ate );
+    const uint64_t fileSize = file.good() ? uint64_t( file.tellg( )) : 0;
+    file.seekg( 0 );
+
+    size_t version = 0;
+    uint64_t chunkSize = 0;
+    nbMaterials = 0;
+    file.read( ( char* )&version, sizeof( size_t ));
+    file.read( ( char* )&nbMaterials, sizeof( size_t ));
+    file.read( ( char* )&bounds, sizeof( Boxf ));
+    file.read( ( char* )&chunkSize, sizeof( uint64_t ));
+    if( !file.good() || version != COMPRESSED_CACHE_VERSION ||
+        chunkSize != COMPRESSED_CACHE_CHUNK_SIZE )
+    {
+        BRAYNS_ERROR << "Corrupted cache file " << filename << std::endl;
+        nbMaterials = 0;
+        return false;
+    }
+    if( nbMaterials > maxMaterials )
+    {
+        BRAYNS_ERROR << "Cache file " << filename << " has " << nbMaterials
+                     << " materials, the scene only has " << maxMaterials
+                     << std::endl;
+        nbMaterials = 0;
+        return false;
+    }
+    BRAYNS_INFO << nbMaterials << " materials" << std::endl;
+
+    // Primitives are allocated while reading the header, then decompressed
+    // in place by all threads
+    std::vector< CacheChunk > chunks;
+    uint64_t nextChunkOffset = 0;
+    bool valid = true;
+    for( size_t materialId = 0; valid && materialId < nbMaterials;
+         ++materialId )
+        valid = _readCompressedCacheSection( file, fileSize, nextChunkOffset,
+                    container.timestampSpheresIndices[materialId],
+                    container.spheres[materialId], chunks ) &&
+                _readCompressedCacheSection( file, fileSize, nextChunkOffset,
+                    container.timestampCylindersIndices[materialId],
+                    container.cylinders[materialId], chunks ) &&
+                _readCompressedCacheSection( file, fileSize, nextChunkOffset,
+                    container.timestampConesIndices[materialId],
+                    container.cones[materialId], chunks );
+    file.close();
+
+    int nbFailures = 0;
+    if( valid )
+    {
+        const int fd = ::open( filename.c_str(), O_RDONLY );
+        #pragma omp parallel for reduction( +:nbFailures )
+        for( int64_t i = 0; i < int64_t( chunks.size( )); ++i )
+            if( !_decompressCacheChunk( fd, chunks[i] ))
+                ++nbFailures;
+        if( fd != -1 )
+            ::close( fd );
+    }
+
+    if( !valid || nbFailures != 0 )
+    {
+        BRAYNS_ERROR << "Corrupted cache file " << filename << std::endl;
+        for( size_t materialId = 0; materialId < nbMaterials; ++materialId )
+        {
+            Spheres().swap( container.spheres[materialId] );
+            Cylinders().swap( container.cylinders[materialId] );
+            Cones().swap( container.cones[materialId] );
+            container.timestampSpheresIndices.erase( materialId );
+            container.timestampCylindersIndices.erase( materialId );
+            container.timestampConesIndices.erase( materialId );
+        }
+        return false;
+    }
+
+    BRAYNS_INFO << chunks.size() << " chunks decompressed" << std::endl;
+    return true;
+#else
+    BRAYNS_ERROR << "Version " << COMPRESSED_CACHE_VERSION
+                 << " requires Brayns to be built with zlib" << std::endl;
+    nbMaterials = 0;
+    return false;
+#endif
+}
+
+}
@@ -0,0 +1,143 @@
+/* Copyright (c) 2015-2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Cyrille Favreau <cyrille.favreau@epfl.ch>
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef SCENECACHE_H
+#define SCENECACHE_H
+
+#include <brayns/api.h>
+#include <brayns/common/types.h>
+
+#include <string>
+
+namespace brayns
+{
+
+// Version of the cache files whose primitives are stored uncompressed, in
+// page aligned sections that can be memory mapped
+const size_t CACHE_VERSION = 7;
+
+// Version of the cache files in which every primitive array is split into
+// independently compressed chunks
+const size_t COMPRESSED_CACHE_VERSION = 8;
+
+/** Primitives of a scene and their timestamp indices, organized per material
+ * and per type of primitive. Primitives of every material are expected to be
+ * sorted according to their timestamp indices.
+ */
+struct SceneCacheContainer
+{
+    SpheresMap& spheres;
+    CylindersMap& cylinders;
+    ConesMap& cones;
+    TimestampIndicesMap& timestampSpheresIndices;
+    TimestampIndicesMap& timestampCylindersIndices;
+    TimestampIndicesMap& timestampConesIndices;
+};
+
+/** Primitives of one material and type of primitive in a cache file held in
+ * memory
+ */
+struct SceneCacheSection
+{
+    TimestampIndices timestampIndices;
+    const char* data;
+    uint64_t size;
+};
+
+struct SceneCacheMaterial
+{
+    SceneCacheSection spheres;
+    SceneCacheSection cylinders;
+    SceneCacheSection cones;
+};
+typedef std::vector< SceneCacheMaterial > SceneCacheMaterials;
+
+/** Reads and writes binary containers of scene primitives
+ */
+class SceneCache
+{
+public:
+    /** Returns the version of a cache file
+     *
+     * @param filename Cache file
+     * @return Version of the file, 0 if the file could not be read
+     */
+    BRAYNS_API static size_t getVersion( const std::string& filename );
+
+    /** Saves primitives to a cache file
+     *
+     * @param filename Cache file
+     * @param container Primitives to save
+     * @param nbMaterials Number of materials of the scene
+     * @param bounds Bounds of the scene
+     * @param compress Defines if the file should be saved with version
+     *        COMPRESSED_CACHE_VERSION rather than CACHE_VERSION
+     * @return True if the file was successfully saved, false otherwise
+     */
+    BRAYNS_API static bool save(
+        const std::string& filename,
+        const SceneCacheContainer& container,
+        size_t nbMaterials,
+        const Boxf& bounds,
+        bool compress );
+
+    /** Parses a cache file of version CACHE_VERSION held in memory, typically
+     * memory mapped. Primitives are not copied: sections point to the
+     * given memory
+     *
+     * @param begin Start of the file in memory
+     * @param end End of the file in memory
+     * @param maxMaterials Number of materials of the scene. Files with more
+     *        materials are rejected
+     * @param materials Returned primitives of every material
+     * @param bounds Returned bounds of the scene
+     * @return True if the file is valid, false otherwise
+     */
+    BRAYNS_API static bool parse(
+        const char* begin,
+        const char* end,
+        size_t maxMaterials,
+        SceneCacheMaterials& materials,
+        Boxf& bounds );
+
+    /** Loads a cache file of version COMPRESSED_CACHE_VERSION. Chunks are
+     * decompressed in parallel
+     *
+     * @param filename Cache file
+     * @param maxMaterials Number of materials of the scene. Files with more
+     *        materials are rejected
+     * @param container Returned primitives. Primitives of the materials
+     *        stored in the file are replaced, and left empty if the file is
+     *        corrupted
+     * @param nbMaterials Returned number of materials
+     * @param bounds Returned bounds of the scene
+     * @return True if the file was successfully loaded, false otherwise
+     */
+    BRAYNS_API static bool loadCompressed(
+        const std::string& filename,
+        size_t maxMaterials,
+        SceneCacheContainer& container,
+        size_t& nbMaterials,
+        Boxf& bounds );
+};
+
+}
+
+#endif // SCENECACHE_H
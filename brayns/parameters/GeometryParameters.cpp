@@ -46,9 +46,26 @@ const std::string PARAM_START_SIMULATION_TIME = "start-simulation-time";
 const std::string PARAM_END_SIMULATION_TIME = "end-simulation-time";
 const std::string PARAM_SIMULATION_RANGE = "simulation-values-range";
 const std::string PARAM_SIMULATION_CACHE_FILENAME = "simulation-cache-file";
+const std::string PARAM_SIMULATION_CACHE_ENCODING = "simulation-cache-encoding";
+const std::string PARAM_SIMULATION_CACHE_THREADS = "simulation-cache-threads";
 const std::string PARAM_MORPHOLOGY_SECTION_TYPES = "morphology-section-types";
 const std::string PARAM_MORPHOLOGY_LAYOUT = "morphology-layout";
 const std::string PARAM_GENERATE_MULTIPLE_MODELS = "generate-multiple-models";
+const std::string PARAM_COMPACT_SCENE = "compact-scene";
+const std::string PARAM_MERGE_MATERIALS = "merge-materials";
+const std::string PARAM_MORPHOLOGY_INSTANCING = "morphology-instancing";
+const std::string PARAM_MORPHOLOGY_LEVELS_OF_DETAIL =
+    "morphology-levels-of-detail";
+const std::string PARAM_COMPRESS_CACHE = "compress-cache";
+const std::string PARAM_LOADING_BATCH_SIZE = "loading-batch-size";
+const std::string PARAM_MORPHOLOGY_CACHE_SIZE = "morphology-cache-size";
+const std::string PARAM_MORPHOLOGY_PREFETCH_DEPTH =
+    "morphology-prefetch-depth";
+const std::string PARAM_MORPHOLOGY_IO_THREADS = "morphology-io-threads";
+const std::string PARAM_MORPHOLOGY_STORE = "morphology-store";
+const std::string PARAM_SIMULATION_PREFETCH_FRAMES =
+    "simulation-prefetch-frames";
+const std::string PARAM_SIMULATION_LOCKED_FRAMES = "simulation-locked-frames";
 
 }
 
@@ -68,7 +85,20 @@ GeometryParameters::GeometryParameters( )
     , _endSimulationTime( std::numeric_limits<float>::max() )
     , _simulationValuesRange( Vector2f(
         std::numeric_limits<float>::max(), std::numeric_limits<float>::min() ))
+    , _simulationCacheEncoding( FE_FLOAT32 )
+    , _simulationCacheThreads( 4 )
     , _generateMultipleModels( false )
+    , _compactScene( false )
+    , _mergeMaterials( false )
+    , _morphologyInstancing( false )
+    , _morphologyLevelsOfDetail( false )
+    , _compressCache( false )
+    , _loadingBatchSize( 0 )
+    , _morphologyCacheSize( 512 )
+    , _morphologyPrefetchDepth( 64 )
+    , _morphologyIOThreads( 4 )
+    , _simulationPrefetchFrames( 8 )
+    , _simulationLockedFrames( 0 )
 {
     _parameters.add_options()
         ( PARAM_MORPHOLOGY_FOLDER.c_str(), po::value< std::string >( ),
@@ -116,8 +146,53 @@ GeometryParameters::GeometryParameters( )
             "Minimum and maximum values for the simulation" )
         ( PARAM_SIMULATION_CACHE_FILENAME.c_str(), po::value< std::string >(),
             "Cache file containing simulation data" )
+        ( PARAM_SIMULATION_CACHE_ENCODING.c_str(), po::value< size_t >(),
+            "Encoding of the values of simulation cache files created from "
+            "reports (0: 32-bit floats, 1: 16-bit, 2: 8-bit)" )
+        ( PARAM_SIMULATION_CACHE_THREADS.c_str(), po::value< size_t >(),
+            "Number of threads reading report frames when simulation cache "
+            "files are created" )
         ( PARAM_GENERATE_MULTIPLE_MODELS.c_str(), po::value< bool >(),
-            "Generated multiple models based on geometry timestamps" );
+            "Split geometry according to primitive timestamps so that "
+            "geometry that is not visible yet can be skipped" )
+        ( PARAM_COMPACT_SCENE.c_str(), po::value< bool >(),
+            "Release scene primitives once they have been handed over to the "
+            "rendering engine" )
+        ( PARAM_MERGE_MATERIALS.c_str(), po::value< bool >(),
+            "Share geometries between materials, using a per-primitive "
+            "material index" )
+        ( PARAM_MORPHOLOGY_INSTANCING.c_str(), po::value< bool >(),
+            "Build every unique morphology of a circuit once, and place cells "
+            "as instances of it" )
+        ( PARAM_MORPHOLOGY_LEVELS_OF_DETAIL.c_str(), po::value< bool >(),
+            "Build coarse and soma-only representations of instanced "
+            "morphologies, selected according to their size on screen" )
+        ( PARAM_COMPRESS_CACHE.c_str(), po::value< bool >(),
+            "Save the binary container of the scene as compressed chunks, "
+            "decompressed in parallel when loaded" )
+        ( PARAM_LOADING_BATCH_SIZE.c_str(), po::value< size_t >(),
+            "Load circuits in the background, in batches of the given number "
+            "of cells that are rendered as soon as they are loaded. 0 loads "
+            "the circuit before the first frame" )
+        ( PARAM_MORPHOLOGY_CACHE_SIZE.c_str(), po::value< size_t >(),
+            "Maximum memory used to keep parsed morphologies, so that cells "
+            "sharing a morphology file only parse it once, in MB. 0 disables "
+            "the cache" )
+        ( PARAM_MORPHOLOGY_PREFETCH_DEPTH.c_str(), po::value< size_t >(),
+            "Number of morphology files read ahead of the cells being built "
+            "during circuit loading. 0 disables prefetching" )
+        ( PARAM_MORPHOLOGY_IO_THREADS.c_str(), po::value< size_t >(),
+            "Number of threads reading morphology files ahead of the cells "
+            "being built" )
+        ( PARAM_MORPHOLOGY_STORE.c_str(), po::value< std::string >(),
+            "Binary morphology store, built by braynsCacheBuilder, from which "
+            "morphologies are read instead of their original files" )
+        ( PARAM_SIMULATION_PREFETCH_FRAMES.c_str(), po::value< size_t >(),
+            "Number of simulation frames read ahead of the current frame, in "
+            "the direction of the playback. 0 disables prefetching" )
+        ( PARAM_SIMULATION_LOCKED_FRAMES.c_str(), po::value< size_t >(),
+            "Number of the most recently rendered simulation frames locked in "
+            "memory, so that looping over them never reads the cache file" );
 }
 
 bool GeometryParameters::_parse( const po::variables_map& vm )
@@ -183,9 +258,55 @@ bool GeometryParameters::_parse( const po::variables_map& vm )
     if( vm.count( PARAM_SIMULATION_CACHE_FILENAME ))
         _simulationCacheFile =
             vm[PARAM_SIMULATION_CACHE_FILENAME].as< std::string >( );
+    if( vm.count( PARAM_SIMULATION_CACHE_ENCODING ))
+    {
+        const size_t encoding =
+            vm[PARAM_SIMULATION_CACHE_ENCODING].as< size_t >( );
+        if( encoding > FE_UINT8 )
+            BRAYNS_ERROR << "Invalid simulation cache encoding " << encoding
+                         << ", the encoding is kept to "
+                         << static_cast< size_t >( _simulationCacheEncoding )
+                         << std::endl;
+        else
+            _simulationCacheEncoding = static_cast< FrameEncoding >( encoding );
+    }
+    if( vm.count( PARAM_SIMULATION_CACHE_THREADS ))
+        _simulationCacheThreads =
+            vm[PARAM_SIMULATION_CACHE_THREADS].as< size_t >( );
     if( vm.count( PARAM_GENERATE_MULTIPLE_MODELS ))
         _generateMultipleModels =
             vm[PARAM_GENERATE_MULTIPLE_MODELS].as< bool >( );
+    if( vm.count( PARAM_COMPACT_SCENE ))
+        _compactScene = vm[PARAM_COMPACT_SCENE].as< bool >( );
+    if( vm.count( PARAM_MERGE_MATERIALS ))
+        _mergeMaterials = vm[PARAM_MERGE_MATERIALS].as< bool >( );
+    if( vm.count( PARAM_MORPHOLOGY_INSTANCING ))
+        _morphologyInstancing =
+            vm[PARAM_MORPHOLOGY_INSTANCING].as< bool >( );
+    if( vm.count( PARAM_MORPHOLOGY_LEVELS_OF_DETAIL ))
+        _morphologyLevelsOfDetail =
+            vm[PARAM_MORPHOLOGY_LEVELS_OF_DETAIL].as< bool >( );
+    if( vm.count( PARAM_COMPRESS_CACHE ))
+        _compressCache = vm[PARAM_COMPRESS_CACHE].as< bool >( );
+    if( vm.count( PARAM_LOADING_BATCH_SIZE ))
+        _loadingBatchSize = vm[PARAM_LOADING_BATCH_SIZE].as< size_t >( );
+    if( vm.count( PARAM_MORPHOLOGY_CACHE_SIZE ))
+        _morphologyCacheSize =
+            vm[PARAM_MORPHOLOGY_CACHE_SIZE].as< size_t >( );
+    if( vm.count( PARAM_MORPHOLOGY_PREFETCH_DEPTH ))
+        _morphologyPrefetchDepth =
+            vm[PARAM_MORPHOLOGY_PREFETCH_DEPTH].as< size_t >( );
+    if( vm.count( PARAM_MORPHOLOGY_IO_THREADS ))
+        _morphologyIOThreads =
+            vm[PARAM_MORPHOLOGY_IO_THREADS].as< size_t >( );
+    if( vm.count( PARAM_MORPHOLOGY_STORE ))
+        _morphologyStore = vm[PARAM_MORPHOLOGY_STORE].as< std::string >( );
+    if( vm.count( PARAM_SIMULATION_PREFETCH_FRAMES ))
+        _simulationPrefetchFrames =
+            vm[PARAM_SIMULATION_PREFETCH_FRAMES].as< size_t >( );
+    if( vm.count( PARAM_SIMULATION_LOCKED_FRAMES ))
+        _simulationLockedFrames =
+            vm[PARAM_SIMULATION_LOCKED_FRAMES].as< size_t >( );
 
     return true;
 }
@@ -229,6 +350,10 @@ void GeometryParameters::print( )
         _simulationValuesRange << std::endl;
     BRAYNS_INFO << "- Simulation cache file    : " <<
         _simulationCacheFile << std::endl;
+    BRAYNS_INFO << "- Simulation cache encoding: " <<
+        static_cast<size_t>( _simulationCacheEncoding ) << std::endl;
+    BRAYNS_INFO << "- Simulation cache threads : " <<
+        _simulationCacheThreads << std::endl;
     BRAYNS_INFO << "Morphology section types   : " <<
         _morphologySectionTypes << std::endl;
     BRAYNS_INFO << "Morphology Layout          : " << std::endl;
@@ -240,6 +365,30 @@ void GeometryParameters::print( )
         _morphologyLayout.horizontalSpacing << std::endl;
     BRAYNS_INFO << "Generate multiple models   : " <<
         (_generateMultipleModels ? "on" : "off") << std::endl;
+    BRAYNS_INFO << "Compact scene              : " <<
+        (_compactScene ? "on" : "off") << std::endl;
+    BRAYNS_INFO << "Merge materials            : " <<
+        (_mergeMaterials ? "on" : "off") << std::endl;
+    BRAYNS_INFO << "Morphology instancing      : " <<
+        (_morphologyInstancing ? "on" : "off") << std::endl;
+    BRAYNS_INFO << "Morphology levels of detail: " <<
+        (_morphologyLevelsOfDetail ? "on" : "off") << std::endl;
+    BRAYNS_INFO << "Compress cache             : " <<
+        (_compressCache ? "on" : "off") << std::endl;
+    BRAYNS_INFO << "Loading batch size         : " <<
+        _loadingBatchSize << std::endl;
+    BRAYNS_INFO << "Morphology cache size (MB) : " <<
+        _morphologyCacheSize << std::endl;
+    BRAYNS_INFO << "Morphology prefetch depth  : " <<
+        _morphologyPrefetchDepth << std::endl;
+    BRAYNS_INFO << "Morphology I/O threads     : " <<
+        _morphologyIOThreads << std::endl;
+    BRAYNS_INFO << "Morphology store           : " <<
+        _morphologyStore << std::endl;
+    BRAYNS_INFO << "Simulation prefetch frames : " <<
+        _simulationPrefetchFrames << std::endl;
+    BRAYNS_INFO << "Simulation locked frames   : " <<
+        _simulationLockedFrames << std::endl;
 }
 
 }
@@ -64,27 +64,34 @@ public:
 
     /** folder containing SWC and H5 files */
     std::string getMorphologyFolder( ) const { return _morphologyFolder; }
+    void setMorphologyFolder( const std::string& value ) { _morphologyFolder = value; }
 
     /** PDB file */
     std::string getPDBFile( ) const { return _pdbFile; }
+    void setPDBFile( const std::string& value ) { _pdbFile = value; }
 
     /** folder containing mesh files */
     std::string getMeshFolder( ) const { return _meshFolder; }
+    void setMeshFolder( const std::string& value ) { _meshFolder = value; }
 
     /** file containing circuit configuration */
     std::string getCircuitConfiguration( ) const { return _circuitConfig; }
+    void setCircuitConfiguration( const std::string& value ) { _circuitConfig = value; }
 
     /** Binary representation of a scene to load */
     std::string getLoadCacheFile( ) const { return _loadCacheFile; }
+    void setLoadCacheFile( const std::string& value ) { _loadCacheFile = value; }
 
     /** Binary representation of a scene to save */
     std::string getSaveCacheFile( ) const { return _saveCacheFile; }
 
     /** Circuit target */
     std::string getTarget( ) const { return _target; }
+    void setTarget( const std::string& value ) { _target = value; }
 
     /** Circuit compartment report */
     std::string getReport( ) const { return _report; }
+    void setReport( const std::string& value ) { _report = value; }
 
     /** Radius multiplier applied to spheres, cones and cylinders.
      * @param value Radius multiplier. Multiplies the radius contained in the
@@ -134,11 +141,79 @@ public:
 
     /** File containing simulation data */
     const std::string& getSimulationCacheFile() const { return _simulationCacheFile; }
+    void setSimulationCacheFile( const std::string& value ) { _simulationCacheFile = value; }
 
-    /** Defines if multiple models should be generated to increase the
-        rendering performance */
+    /** Encoding of the values of the simulation cache files created from
+        reports */
+    FrameEncoding getSimulationCacheEncoding() const { return _simulationCacheEncoding; }
+
+    /** Number of threads reading report frames when simulation cache files
+        are created */
+    size_t getSimulationCacheThreads() const { return _simulationCacheThreads; }
+
+    /** Defines if geometry should be split according to primitive timestamps
+        to increase the rendering performance when only part of the scene is
+        visible at the current timestamp */
     bool getGenerateMultipleModels() const { return _generateMultipleModels; }
 
+    /** Defines if scene primitives should be released once they have been
+        handed over to the rendering engine */
+    bool getCompactScene() const { return _compactScene; }
+
+    /** Defines if primitives of all materials should share the same
+        geometries, each primitive holding the index of its material */
+    bool getMergeMaterials() const { return _mergeMaterials; }
+
+    /** Defines if cells of a circuit sharing the same morphology should be
+        instances of a single geometry */
+    bool getMorphologyInstancing() const { return _morphologyInstancing; }
+
+    /** Defines if instanced morphologies should also be built as coarse
+        skeletons and somas only, for instances that are small on screen */
+    bool getMorphologyLevelsOfDetail() const
+    {
+        return _morphologyLevelsOfDetail;
+    }
+
+    /** Defines if the binary container of the scene should be saved as
+        independently compressed chunks */
+    bool getCompressCache() const { return _compressCache; }
+
+    /** Number of cells per batch when circuits are loaded in the background.
+        0 if circuits are loaded before the first frame */
+    size_t getLoadingBatchSize() const { return _loadingBatchSize; }
+
+    /** Maximum memory used to keep parsed morphologies during circuit
+        loading, in MB. 0 if morphologies are parsed for every cell */
+    size_t getMorphologyCacheSize() const { return _morphologyCacheSize; }
+
+    /** Number of morphology files read ahead of the cells being built during
+        circuit loading, by getMorphologyIOThreads() threads. 0 if files are
+        only read when cells are built */
+    size_t getMorphologyPrefetchDepth() const
+    {
+        return _morphologyPrefetchDepth;
+    }
+    size_t getMorphologyIOThreads() const { return _morphologyIOThreads; }
+
+    /** Binary morphology store from which morphologies are read instead of
+        their original files */
+    const std::string& getMorphologyStore() const { return _morphologyStore; }
+
+    /** Number of simulation frames read ahead of the current frame during
+        playback. 0 if frames are only read when rendered */
+    size_t getSimulationPrefetchFrames() const
+    {
+        return _simulationPrefetchFrames;
+    }
+
+    /** Number of the most recently rendered simulation frames that are
+        locked in memory */
+    size_t getSimulationLockedFrames() const
+    {
+        return _simulationLockedFrames;
+    }
+
 protected:
 
     bool _parse( const po::variables_map& vm ) final;
@@ -164,7 +239,21 @@ protected:
     float _endSimulationTime;
     Vector2f _simulationValuesRange;
     std::string _simulationCacheFile;
+    FrameEncoding _simulationCacheEncoding;
+    size_t _simulationCacheThreads;
     bool _generateMultipleModels;
+    bool _compactScene;
+    bool _mergeMaterials;
+    bool _morphologyInstancing;
+    bool _morphologyLevelsOfDetail;
+    bool _compressCache;
+    size_t _loadingBatchSize;
+    size_t _morphologyCacheSize;
+    size_t _morphologyPrefetchDepth;
+    size_t _morphologyIOThreads;
+    std::string _morphologyStore;
+    size_t _simulationPrefetchFrames;
+    size_t _simulationLockedFrames;
 };
 
 }
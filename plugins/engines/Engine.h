@@ -38,6 +38,7 @@ class Engine
 {
 public:
 
+    Engine() : _sceneLoadRequested( false ), _sceneLoading( false ) {}
     virtual ~Engine() {}
 
     /**
@@ -61,9 +62,40 @@ public:
     /** Executes engine specific post-render operations */
     virtual void postRender() {}
 
+    /**
+       Creates a new and empty scene, rendered by the renderers of the engine.
+       No rendering engine object is created until the geometry of the scene
+       is built, so that the scene can be populated in a background thread
+       @param parametersManager Parameters defining how the scene is built
+       @return the new scene
+    */
+    virtual ScenePtr createScene( ParametersManager& parametersManager ) = 0;
+
     /** Gets the scene */
     ScenePtr getScene() { return _scene; }
 
+    /**
+       Replaces the scene rendered by the engine. The engine must be committed
+       for the renderers to use the new scene. The previous scene is released
+       as soon as it is not referenced anymore
+    */
+    void setScene( ScenePtr scene ) { _scene = scene; }
+
+    /**
+       Requests the data specified by the geometry parameters to be loaded
+       into a new scene, that replaces the current one once loaded
+    */
+    void setSceneLoadRequested( const bool value ) { _sceneLoadRequested = value; }
+    bool isSceneLoadRequested() const { return _sceneLoadRequested; }
+
+    /**
+       True while a requested scene is being loaded, and until it replaces the
+       current one. The geometry parameters then describe the scene being
+       loaded and must not be modified
+    */
+    void setSceneLoading( const bool value ) { _sceneLoading = value; }
+    bool isSceneLoading() const { return _sceneLoading; }
+
     /** Gets the frame buffer */
     FrameBufferPtr getFrameBuffer() { return _frameBuffer; }
 
@@ -85,6 +117,8 @@ protected:
     RendererMap _renderers;
     Vector2i _frameSize;
     FrameBufferPtr _frameBuffer;
+    bool _sceneLoadRequested;
+    bool _sceneLoading;
 
 };
 
@@ -52,20 +52,12 @@ OSPRayEngine::OSPRayEngine(
 
     _rendererNames = parametersManager->getRenderingParameters().getRenderers();
 
-    Renderers renderersForScene;
     for( std::string renderer: _rendererNames )
-    {
         _renderers[renderer].reset(
             new OSPRayRenderer( renderer, *parametersManager ));
-        renderersForScene.push_back( _renderers[renderer] );
-    }
 
     BRAYNS_INFO << "Initializing scene" << std::endl;
-    _scene.reset( new OSPRayScene( renderersForScene,
-        parametersManager->getSceneParameters(),
-        parametersManager->getGeometryParameters()));
-
-    _scene->setMaterials( MT_DEFAULT, NB_MAX_MATERIALS );
+    _scene = createScene( *parametersManager );
 
     BRAYNS_INFO << "Initializing frame buffer" << std::endl;
     _frameSize =
@@ -88,6 +80,20 @@ std::string OSPRayEngine::name() const
     return "ospray";
 }
 
+ScenePtr OSPRayEngine::createScene( ParametersManager& parametersManager )
+{
+    Renderers renderersForScene;
+    for( std::string renderer: _rendererNames )
+        renderersForScene.push_back( _renderers[renderer] );
+
+    ScenePtr scene( new OSPRayScene( renderersForScene,
+        parametersManager.getSceneParameters(),
+        parametersManager.getGeometryParameters()));
+
+    scene->setMaterials( MT_DEFAULT, NB_MAX_MATERIALS );
+    return scene;
+}
+
 void OSPRayEngine::commit()
 {
     for( std::string renderer: _rendererNames )
@@ -44,6 +44,9 @@ public:
     /** @copydoc Engine::name */
     std::string name() const final;
 
+    /** @copydoc Engine::createScene */
+    ScenePtr createScene( ParametersManager& parametersManager ) final;
+
     /** @copydoc Engine::commit */
     void commit() final;
 
@@ -18,6 +18,9 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <limits>
+#include <vector>
+
 // ospray
 #include "ExtendedCones.h"
 #include "ospray/common/Data.h"
@@ -36,6 +39,8 @@ void ExtendedCones::finalize(ospray::Model *model)
 {
     radius              = getParam1f("radius",0.01f);
     length              = getParam1f("length",0.01f);
+    minTimestamp        = getParam1f("min_timestamp",
+                                     -std::numeric_limits<float>::max());
     materialID          = getParam1i("materialID",0);
     bytesPerCone        = getParam1i("bytes_per_extended_cone",10*sizeof(float));
     offset_center       = getParam1i("offset_center",0);
@@ -46,19 +51,36 @@ void ExtendedCones::finalize(ospray::Model *model)
     offset_value        = getParam1i("offset_value",9*sizeof(float));
     offset_materialID   = getParam1i("offset_materialID",-1);
     data                = getParamData("extendedcones",nullptr);
+    materialList        = getParamData("materialList",nullptr);
 
     if (data.ptr == nullptr || bytesPerCone == 0)
         throw std::runtime_error( "#ospray:geometry/extendedcones: " \
                                   "no 'extendedcones' data specified");
     numExtendedCones = data->numBytes / bytesPerCone;
+
+    void *ispcMaterialList = nullptr;
+
+    if (materialList)
+    {
+        ispcMaterials_.clear();
+        ispcMaterials_.resize(materialList->numItems);
+        for (size_t i=0; i<materialList->numItems; ++i)
+        {
+            ospray::Material *m = static_cast<ospray::Material**>(materialList->data)[i];
+            ispcMaterials_[i] = m ? m->getIE() : nullptr;
+        }
+        ispcMaterialList = static_cast<void*>(ispcMaterials_.data());
+    }
     ispc::ExtendedConesGeometry_set(
                 getIE(),
                 model->getIE(),
                 data->data,
+                ispcMaterialList,
                 numExtendedCones,
                 bytesPerCone,
                 radius,
                 length,
+                minTimestamp,
                 materialID,
                 offset_center,
                 offset_up,
@@ -33,6 +33,7 @@ struct ExtendedCones : public ospray::Geometry
 
     float radius;
     float length;
+    float minTimestamp;
     int32 materialID;
 
     size_t numExtendedCones;
@@ -46,8 +47,12 @@ struct ExtendedCones : public ospray::Geometry
     int64 offset_materialID;
 
     ospray::Ref<ospray::Data> data;
+    ospray::Ref<ospray::Data> materialList;
 
     ExtendedCones();
+
+private:
+    std::vector<void *> ispcMaterials_;
 };
 
 } // ::brayns
@@ -17,6 +17,9 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <limits>
+#include <vector>
+
 // ospray
 #include "ExtendedCylinders.h"
 #include "ospray/common/Data.h"
@@ -34,8 +37,11 @@ ExtendedCylinders::ExtendedCylinders()
 void ExtendedCylinders::finalize(ospray::Model *model)
 {
     radius            = getParam1f("radius",0.01f);
+    minTimestamp      = getParam1f("min_timestamp",
+                                   -std::numeric_limits<float>::max());
     materialID        = getParam1i("materialID",0);
-    bytesPerCylinder  = getParam1i("bytes_per_cylinder",9*sizeof(float));
+    bytesPerCylinder  = getParam1i("bytes_per_extended_cylinder",
+                                    9*sizeof(float));
     offset_v0         = getParam1i("offset_v0",0);
     offset_v1         = getParam1i("offset_v1",3*sizeof(float));
     offset_radius     = getParam1i("offset_radius",6*sizeof(float));
@@ -43,18 +49,35 @@ void ExtendedCylinders::finalize(ospray::Model *model)
     offset_value      = getParam1i("offset_value",8*sizeof(float));
     offset_materialID = getParam1i("offset_materialID",-1);
     data              = getParamData("extendedcylinders",nullptr);
+    materialList      = getParamData("materialList",nullptr);
 
     if (data.ptr == nullptr || bytesPerCylinder == 0)
         throw std::runtime_error("#ospray:geometry/extendedcylinders: " \
                                  "no 'extendedcylinders' data specified");
     numExtendedCylinders = data->numBytes / bytesPerCylinder;
+
+    void *ispcMaterialList = nullptr;
+
+    if (materialList)
+    {
+        ispcMaterials_.clear();
+        ispcMaterials_.resize(materialList->numItems);
+        for (size_t i=0; i<materialList->numItems; ++i)
+        {
+            ospray::Material *m = static_cast<ospray::Material**>(materialList->data)[i];
+            ispcMaterials_[i] = m ? m->getIE() : nullptr;
+        }
+        ispcMaterialList = static_cast<void*>(ispcMaterials_.data());
+    }
     ispc::ExtendedCylindersGeometry_set(
                 getIE(),
                 model->getIE(),
                 data->data,
+                ispcMaterialList,
                 numExtendedCylinders,
                 bytesPerCylinder,
                 radius,
+                minTimestamp,
                 materialID,
                 offset_v0,
                 offset_v1,
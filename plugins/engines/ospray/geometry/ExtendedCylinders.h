@@ -30,6 +30,7 @@ struct ExtendedCylinders : public ospray::Geometry
     void finalize(ospray::Model *model) final;
 
     float radius;
+    float minTimestamp;
     int32 materialID;
 
     size_t numExtendedCylinders;
@@ -42,8 +43,12 @@ struct ExtendedCylinders : public ospray::Geometry
     int64 offset_materialID;
 
     ospray::Ref<ospray::Data> data;
+    ospray::Ref<ospray::Data> materialList;
 
     ExtendedCylinders();
+
+private:
+    std::vector<void *> ispcMaterials_;
 };
 
 } // ::brayns
@@ -17,6 +17,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <limits>
 #include <vector>
 
 // ospray
@@ -37,6 +38,8 @@ ExtendedSpheres::ExtendedSpheres()
 void ExtendedSpheres::finalize(ospray::Model *model)
 {
     radius            = getParam1f("radius",0.01f);
+    minTimestamp      = getParam1f("min_timestamp",
+                                   -std::numeric_limits<float>::max());
     materialID        = getParam1i("materialID",0);
     bytesPerExtendedSphere =
             getParam1i("bytes_per_extended_sphere",5*sizeof(float));
@@ -53,17 +56,12 @@ void ExtendedSpheres::finalize(ospray::Model *model)
                                  "no 'extendedspheres' data specified");
     numExtendedSpheres = data->numBytes / bytesPerExtendedSphere;
 
-    if (numExtendedSpheres >= (1ULL << 30))
-    {
+    // Primitives are addressed per page in the ISPC code, so the only limit
+    // is the 32 bit primitive ID. Brayns splits primitives into bricks that
+    // remain far below that limit
+    if (numExtendedSpheres > size_t(std::numeric_limits<int32_t>::max()))
         throw std::runtime_error("#brayns::ExtendedSpheres: too many extended "\
-                                 "spheres in this sphere geometry. Consider "\
-                                 "splitting this geometry in multiple "\
-                                 "geometries with fewer extended spheres (you "\
-                                 "can still put all those geometries into a "\
-                                 "single model, but you can't put that many "\
-                                 "extended spheres into a single geometry "\
-                                 "without causing address overflows)");
-    }
+                                 "spheres in this sphere geometry");
 
     void *ispcMaterialList = nullptr;
 
@@ -81,7 +79,7 @@ void ExtendedSpheres::finalize(ospray::Model *model)
     ispc::ExtendedSpheresGeometry_set(getIE(),model->getIE(),
                                       data->data,ispcMaterialList,
                                       numExtendedSpheres, bytesPerExtendedSphere,
-                                      radius, materialID,
+                                      radius, minTimestamp, materialID,
                                       offset_center,offset_radius,
                                       offset_timestamp, offset_value,
                                       offset_materialID);
@@ -32,6 +32,7 @@ struct ExtendedSpheres : public ospray::Geometry
     void finalize(ospray::Model *model) final;
 
     float radius;
+    float minTimestamp;
     int32 materialID;
 
     size_t numExtendedSpheres;
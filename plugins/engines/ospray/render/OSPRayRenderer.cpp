@@ -44,6 +44,7 @@ OSPRayRenderer::OSPRayRenderer(
     ParametersManager& parametersManager )
     : Renderer( parametersManager )
     , _camera( 0 )
+    , _simulationScene( 0 )
 {
     RenderingParameters& rp = _parametersManager.getRenderingParameters();
     if( rp.getModule( ) != "" )
@@ -97,15 +98,14 @@ void OSPRayRenderer::commit()
     OSPRayScene* osprayScene = static_cast< OSPRayScene* >( _scene.get( ));
     assert( osprayScene );
 
-    const size_t ts = _scene->getSceneParameters().getTimestamp();
-    OSPModel* model = osprayScene->modelImpl( ts );
+    OSPModel model = osprayScene->modelImpl();
     if( model )
     {
-        ospSetObject( _renderer, "world", *model );
+        ospSetObject( _renderer, "world", model );
         ospCommit( _renderer );
     }
     else
-        BRAYNS_ERROR << "No model found for timestamp " << ts << std::endl;
+        BRAYNS_ERROR << "No model found" << std::endl;
 
 }
 
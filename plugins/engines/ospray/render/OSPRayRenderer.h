@@ -44,9 +44,15 @@ public:
 
     OSPRenderer impl() { return _renderer; }
 
+    /** Scene owning the simulation and transfer function data shared with the
+        renderer, which must reset them before releasing that data */
+    void setSimulationScene( const Scene* scene ) { _simulationScene = scene; }
+    const Scene* getSimulationScene() const { return _simulationScene; }
+
 private:
     OSPRayCamera* _camera;
     OSPRenderer _renderer;
+    const Scene* _simulationScene;
 };
 
 }
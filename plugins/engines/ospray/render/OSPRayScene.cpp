@@ -22,18 +22,245 @@
 #include "OSPRayRenderer.h"
 
 #include <brayns/common/log.h>
+#include <brayns/common/camera/Camera.h>
 #include <brayns/parameters/SceneParameters.h>
 #include <brayns/parameters/GeometryParameters.h>
 #include <brayns/common/material/Texture2D.h>
 #include <brayns/common/light/PointLight.h>
 #include <brayns/common/light/DirectionalLight.h>
 #include <brayns/common/simulation/SimulationDescriptor.h>
+#include <brayns/common/geometry/Bricking.h>
 #include <brayns/io/TextureLoader.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 namespace brayns
 {
 
-const size_t CACHE_VERSION = 5;
+static_assert( sizeof( MaterialPrimitive< Sphere >) ==
+               sizeof( Sphere ) + sizeof( uint32_t ),
+               "Unexpected material sphere memory layout" );
+static_assert( sizeof( MaterialPrimitive< Cylinder >) ==
+               sizeof( Cylinder ) + sizeof( uint32_t ),
+               "Unexpected material cylinder memory layout" );
+static_assert( sizeof( MaterialPrimitive< Cone >) ==
+               sizeof( Cone ) + sizeof( uint32_t ),
+               "Unexpected material cone memory layout" );
+
+// Maximum number of geometries created per material and type of primitive
+// when geometry is split according to timestamps
+const size_t MAX_TIME_BUCKETS = 64;
+
+// Maximum number of primitives per geometry. Larger ranges of primitives are
+// split into bricks so that byte offsets of every geometry remain within 32
+// bits, and so that every brick covers a compact region of space
+const size_t MAX_PRIMITIVES_PER_BRICK = 1 << 22;
+
+// Vertical field of view of the OSPRay cameras, in degrees
+const float DEFAULT_FIELD_OF_VIEW = 60.f;
+
+// Size of instances on screen, relative to the height of the view, below which
+// the next, less detailed, level of detail is used
+const size_t NB_LEVELS_OF_DETAIL_THRESHOLDS = 2;
+const float LEVELS_OF_DETAIL_THRESHOLDS[NB_LEVELS_OF_DETAIL_THRESHOLDS] =
+    { 0.05f, 0.01f };
+
+namespace
+{
+/** Groups consecutive timestamp ranges so that primitives are split into at
+ * most MAX_TIME_BUCKETS geometries
+ *
+ * @param timestampIndices Index of the last primitive (exclusive) for every
+ *        timestamp. Primitives are expected to be sorted by timestamp
+ * @return Index of the last primitive (exclusive) of every bucket
+ */
+size_ts _getTimeBuckets( const std::map< size_t, size_t >& timestampIndices )
+{
+    size_ts buckets;
+    if( timestampIndices.empty( ))
+        return buckets;
+
+    const size_t nbPrimitives = timestampIndices.rbegin()->second;
+    const size_t bucketSize =
+        std::max( size_t( 1 ), nbPrimitives / MAX_TIME_BUCKETS );
+    size_t begin = 0;
+    for( const auto& index: timestampIndices )
+        if( index.second - begin >= bucketSize )
+        {
+            buckets.push_back( index.second );
+            begin = index.second;
+        }
+    if( begin != nbPrimitives )
+        buckets.push_back( nbPrimitives );
+    return buckets;
+}
+
+/** Splits primitives into the ranges that become OSPRay geometries: one or
+ * several bricks per time bucket
+ *
+ * @param timestampIndices Index of the last primitive (exclusive) for every
+ *        timestamp. Primitives are expected to be sorted by timestamp
+ * @return Index of the last primitive (exclusive) of every range
+ */
+size_ts _getGeometryRanges( const std::map< size_t, size_t >& timestampIndices )
+{
+    size_ts ranges;
+    size_t begin = 0;
+    for( const size_t end: _getTimeBuckets( timestampIndices ))
+    {
+        const size_ts bricks =
+            getBricks( begin, end, MAX_PRIMITIVES_PER_BRICK );
+        ranges.insert( ranges.end(), bricks.begin(), bricks.end( ));
+        begin = end;
+    }
+    return ranges;
+}
+
+template< typename T >
+float _getMinTimestamp( const T* primitives, const size_t nbPrimitives )
+{
+    float minTimestamp = std::numeric_limits< float >::max();
+    #pragma omp parallel for reduction( min:minTimestamp )
+    for( size_t i = 0; i < nbPrimitives; ++i )
+        minTimestamp = std::min( minTimestamp, primitives[i].timestamp );
+    return minTimestamp;
+}
+
+/** Gathers the primitives of all materials in a single array, sorted the same
+ * way as the primitives of every material
+ *
+ * @param primitives Primitives per material
+ * @param timeBuckets Defines if primitives should be sorted by timestamp
+ * @param timestampIndices Returned index of the last primitive (exclusive)
+ *        for every timestamp
+ * @return Primitives of all materials, with their material index
+ */
+template< typename T >
+std::vector< MaterialPrimitive< T >> _mergePrimitives(
+    const std::map< size_t, std::vector< T >>& primitives,
+    const bool timeBuckets,
+    std::map< size_t, size_t >& timestampIndices )
+{
+    size_t nbPrimitives = 0;
+    for( const auto& material: primitives )
+        nbPrimitives += material.second.size();
+
+    // Output offsets are computed upfront so that materials are copied in
+    // parallel while keeping the layout of a serial merge
+    std::vector< std::pair< size_t, const std::vector< T >* >> materials;
+    size_ts offsets;
+    size_t offset = 0;
+    for( const auto& material: primitives )
+    {
+        materials.push_back( std::make_pair( material.first, &material.second ));
+        offsets.push_back( offset );
+        offset += material.second.size();
+    }
+
+    std::vector< MaterialPrimitive< T >> merged( nbPrimitives );
+    #pragma omp parallel for schedule( dynamic )
+    for( size_t i = 0; i < materials.size(); ++i )
+    {
+        const std::vector< T >& material = *materials[i].second;
+        for( size_t j = 0; j < material.size(); ++j )
+            merged[offsets[i] + j] = MaterialPrimitive< T >(
+                material[j], materials[i].first );
+    }
+
+    sortPrimitives( merged, timeBuckets, timestampIndices );
+    return merged;
+}
+
+/** Creates an extended spheres geometry from an array of records starting
+ * with a sphere. The geometry still has to be given a material and committed
+ */
+template< typename T >
+OSPGeometry _createExtendedSpheres( const T* spheres, const size_t nbSpheres,
+                                    const uint32_t dataFlags )
+{
+    OSPGeometry extendedSpheres = ospNewGeometry( "extendedspheres" );
+    assert( extendedSpheres );
+
+    OSPData data = ospNewData( nbSpheres * sizeof( T ) / sizeof( float ),
+                               OSP_FLOAT, spheres, dataFlags );
+
+    ospSetObject( extendedSpheres, "extendedspheres", data );
+    ospSet1i( extendedSpheres, "bytes_per_extended_sphere", sizeof( T ));
+    ospSet1i( extendedSpheres, "offset_radius", 3 * sizeof( float ));
+    ospSet1i( extendedSpheres, "offset_timestamp", 4 * sizeof( float ));
+    ospSet1i( extendedSpheres, "offset_value", 5 * sizeof( float ));
+    ospSet1f( extendedSpheres, "min_timestamp",
+        _getMinTimestamp( spheres, nbSpheres ));
+    return extendedSpheres;
+}
+
+/** Creates an extended cylinders geometry from an array of records starting
+ * with a cylinder. The geometry still has to be given a material and committed
+ */
+template< typename T >
+OSPGeometry _createExtendedCylinders( const T* cylinders, const size_t nbCylinders,
+                                      const uint32_t dataFlags )
+{
+    OSPGeometry extendedCylinders = ospNewGeometry( "extendedcylinders" );
+    assert( extendedCylinders );
+
+    OSPData data = ospNewData( nbCylinders * sizeof( T ) / sizeof( float ),
+                               OSP_FLOAT, cylinders, dataFlags );
+
+    ospSetObject( extendedCylinders, "extendedcylinders", data );
+    ospSet1i( extendedCylinders, "bytes_per_extended_cylinder", sizeof( T ));
+    ospSet1i( extendedCylinders, "offset_timestamp", 7 * sizeof( float ));
+    ospSet1i( extendedCylinders, "offset_value", 8 * sizeof( float ));
+    ospSet1f( extendedCylinders, "min_timestamp",
+        _getMinTimestamp( cylinders, nbCylinders ));
+    return extendedCylinders;
+}
+
+/** Creates an extended cones geometry from an array of records starting
+ * with a cone. The geometry still has to be given a material and committed
+ */
+template< typename T >
+OSPGeometry _createExtendedCones( const T* cones, const size_t nbCones,
+                                  const uint32_t dataFlags )
+{
+    OSPGeometry extendedCones = ospNewGeometry( "extendedcones" );
+    assert( extendedCones );
+
+    OSPData data = ospNewData( nbCones * sizeof( T ) / sizeof( float ),
+                               OSP_FLOAT, cones, dataFlags );
+
+    ospSetObject( extendedCones, "extendedcones", data );
+    ospSet1i( extendedCones, "bytes_per_extended_cone", sizeof( T ));
+    ospSet1i( extendedCones, "offset_timestamp", 8 * sizeof( float ));
+    ospSet1i( extendedCones, "offset_value", 9 * sizeof( float ));
+    ospSet1f( extendedCones, "min_timestamp",
+        _getMinTimestamp( cones, nbCones ));
+    return extendedCones;
+}
+
+/** Converts a brayns transformation into an OSPRay affine transformation */
+osp::affine3f _toAffine( const Matrix4f& transformation )
+{
+    osp::affine3f affine;
+    affine.l.vx = { transformation( 0, 0 ), transformation( 1, 0 ),
+                    transformation( 2, 0 ) };
+    affine.l.vy = { transformation( 0, 1 ), transformation( 1, 1 ),
+                    transformation( 2, 1 ) };
+    affine.l.vz = { transformation( 0, 2 ), transformation( 1, 2 ),
+                    transformation( 2, 2 ) };
+    affine.p = { transformation( 0, 3 ), transformation( 1, 3 ),
+                 transformation( 2, 3 ) };
+    return affine;
+}
+
+}
 
 struct TextureTypeMaterialAttribute
 {
@@ -56,127 +283,131 @@ OSPRayScene::OSPRayScene(
     SceneParameters& sceneParameters,
     GeometryParameters& geometryParameters )
     : Scene( renderers, sceneParameters, geometryParameters )
+    , _model( 0 )
     , _ospLightData( 0 )
     , _ospMaterialData( 0 )
     , _ospSimulationData( 0 )
     , _ospTransferFunctionDiffuseData( 0 )
     , _ospTransferFunctionEmissionData( 0 )
+    , _ospSimulationFrame( 0 )
+    , _levelsOfDetailPosition( std::numeric_limits< float >::max( ))
+    , _cacheMemoryMap( 0 )
+    , _cacheMemoryMapSize( 0 )
 {
 }
 
-void OSPRayScene::commit()
+OSPRayScene::~OSPRayScene()
 {
-    for( auto model: _models)
-        ospCommit( model.second );
+    // Geometries may share the memory mapped cache file, they are therefore
+    // released before the file is unmapped
+    if( _model )
+    {
+        for( auto& geometries: _materialGeometries )
+        {
+            _removeGeometries( geometries.second.spheres );
+            _removeGeometries( geometries.second.cylinders );
+            _removeGeometries( geometries.second.cones );
+            _removeGeometries( geometries.second.meshes );
+        }
+        for( auto& geometries: _batchGeometries )
+        {
+            _removeGeometries( geometries.second.spheres );
+            _removeGeometries( geometries.second.cylinders );
+            _removeGeometries( geometries.second.cones );
+        }
+        _removeGeometries( _mergedGeometries );
+        _removeGeometries( _instanceGeometries );
+        for( const auto& models: _templateModels )
+            for( OSPModel model: models )
+                ospRelease( model );
+        ospRelease( _model );
+    }
+
+    // Renderers share the simulation frames of the memory mapped cache file
+    // and the transfer function of the scene, they are therefore reset before
+    // both are released
+    for( const auto& renderer: _renderers )
+    {
+        OSPRayRenderer* osprayRenderer =
+            dynamic_cast< OSPRayRenderer* >( renderer.lock().get( ));
+        if( osprayRenderer && osprayRenderer->getSimulationScene() == this )
+            _resetSimulationParameters( *osprayRenderer );
+    }
+    _releaseData( _ospSimulationData );
+    _releaseData( _ospTransferFunctionDiffuseData );
+    _releaseData( _ospTransferFunctionEmissionData );
+    _unmapCacheFile();
 }
 
-OSPModel* OSPRayScene::modelImpl( const size_t timestamp )
+void OSPRayScene::commit()
 {
-    if( _models.find( timestamp ) != _models.end())
-        return &_models[timestamp];
-
-    int index = -1;
-    for( const auto& model: _models )
-        if( model.first <= timestamp )
-            index = model.first;
-    BRAYNS_DEBUG << "Request model for timestamp " << timestamp
-                 << ", returned " << index << std::endl;
-    return index == -1 ? nullptr : &_models[index];
+    if( _model )
+        ospCommit( _model );
 }
 
+SceneCacheContainer OSPRayScene::_getCacheContainer()
+{
+    SceneCacheContainer container =
+    {
+        _spheres, _cylinders, _cones,
+        _timestampSpheresIndices,
+        _timestampCylindersIndices,
+        _timestampConesIndices
+    };
+    return container;
+}
 
 void OSPRayScene::_saveCacheFile()
 {
-    const std::string& filename = _geometryParameters.getSaveCacheFile();
-    BRAYNS_INFO << "Saving scene to binary file: " << filename << std::endl;
-    std::ofstream file( filename, std::ios::out | std::ios::binary );
-
-    const size_t version = CACHE_VERSION;
-    file.write( ( char* )&version, sizeof( size_t ));
-    BRAYNS_INFO << "Version: " << version << std::endl;
-
-    const size_t nbModels = _models.size();
-    file.write( ( char* )&nbModels, sizeof( size_t ));
-    BRAYNS_INFO << nbModels << " models" << std::endl;
-    for( const auto& model: _models )
-        file.write( ( char* )&model.first, sizeof( size_t ));
+    if( !_instances.empty( ))
+        BRAYNS_WARN << "Instanced geometry is not saved to the cache"
+                    << std::endl;
+    SceneCache::save( _geometryParameters.getSaveCacheFile(),
+                      _getCacheContainer(), _materials.size(), _bounds,
+                      _geometryParameters.getCompressCache( ));
+}
 
-    const size_t nbMaterials = _materials.size();
-    file.write( ( char* )&nbMaterials, sizeof( size_t ));
-    BRAYNS_INFO << nbMaterials << " materials" << std::endl;
+bool OSPRayScene::_mapCacheFile( const std::string& filename )
+{
+    _unmapCacheFile();
 
-    for( size_t materialId = 0; materialId < nbMaterials; ++materialId )
+    const int fd = ::open( filename.c_str(), O_RDONLY );
+    if( fd == -1 )
     {
-        size_t bufferSize;
-
-        // Spheres
-        bufferSize = _timestampSpheresIndices[materialId].size();
-        file.write( ( char* )&bufferSize, sizeof( size_t ));
-        for( const auto& index: _timestampSpheresIndices[materialId] )
-        {
-            file.write( ( char* )&index.first, sizeof( size_t ));
-            file.write( ( char* )&index.second, sizeof( size_t ));
-        }
-
-        bufferSize =
-            _serializedSpheresDataSize[materialId] *
-            Sphere::getSerializationSize() *
-            sizeof( float );
-        file.write( ( char* )&bufferSize, sizeof( size_t ));
-        file.write( ( char* )_serializedSpheresData[materialId].data(),
-            bufferSize );
-        if( bufferSize != 0 )
-            BRAYNS_DEBUG << "[" << materialId << "] "
-                         << _serializedSpheresDataSize[materialId]
-                         << " Spheres" << std::endl;
-
-        // Cylinders
-        bufferSize = _timestampCylindersIndices[materialId].size();
-        file.write( ( char* )&bufferSize, sizeof( size_t ));
-        for( const auto& index: _timestampCylindersIndices[materialId] )
-        {
-            file.write( ( char* )&index.first, sizeof( size_t ));
-            file.write( ( char* )&index.second, sizeof( size_t ));
-        }
-
-        bufferSize =
-            _serializedCylindersDataSize[materialId] *
-            Cylinder::getSerializationSize() *
-            sizeof( float );
-        file.write( ( char* )&bufferSize, sizeof( size_t ));
-        file.write( ( char* )_serializedCylindersData[materialId].data(),
-            bufferSize );
-        if( bufferSize != 0 )
-            BRAYNS_DEBUG << "[" << materialId << "] "
-                         << _serializedCylindersDataSize[materialId]
-                         << " Cylinders" << std::endl;
+        BRAYNS_ERROR << "Could not open cache file " << filename << std::endl;
+        return false;
+    }
 
-        // Cones
-        bufferSize = _timestampConesIndices[materialId].size();
-        file.write( ( char* )&bufferSize, sizeof( size_t ));
-        for( const auto& index: _timestampConesIndices[materialId] )
-        {
-            file.write( ( char* )&index.first, sizeof( size_t ));
-            file.write( ( char* )&index.second, sizeof( size_t ));
-        }
+    struct stat sb;
+    if( ::fstat( fd, &sb ) == -1 || sb.st_size == 0 )
+    {
+        BRAYNS_ERROR << "Could not open cache file " << filename << std::endl;
+        ::close( fd );
+        return false;
+    }
 
-        bufferSize =
-            _serializedConesDataSize[materialId] *
-            Cone::getSerializationSize() *
-            sizeof( float );
-        file.write( ( char* )&bufferSize, sizeof( size_t ));
-        file.write( ( char* )_serializedConesData[materialId].data(),
-            bufferSize );
-        if( bufferSize != 0 )
-            BRAYNS_DEBUG << "[" << materialId << "] "
-                         << _serializedConesDataSize[materialId]
-                         << " Cones" << std::endl;
+    // The mapping is shared so that several processes loading the same cache
+    // file share the same physical pages
+    void* memoryMap = ::mmap( 0, sb.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if( memoryMap == MAP_FAILED )
+    {
+        BRAYNS_ERROR << "Could not map cache file " << filename << std::endl;
+        return false;
     }
 
-    file.write( ( char* )&_bounds, sizeof( Boxf ));
-    BRAYNS_INFO << _bounds << std::endl;
-    file.close();
-    BRAYNS_INFO << "Scene successfully saved"<< std::endl;
+    _cacheMemoryMap = memoryMap;
+    _cacheMemoryMapSize = sb.st_size;
+    return true;
+}
+
+void OSPRayScene::_unmapCacheFile()
+{
+    if( !_cacheMemoryMap )
+        return;
+    ::munmap( _cacheMemoryMap, _cacheMemoryMapSize );
+    _cacheMemoryMap = 0;
+    _cacheMemoryMapSize = 0;
 }
 
 void OSPRayScene::_loadCacheFile()
@@ -185,234 +416,483 @@ void OSPRayScene::_loadCacheFile()
 
     const std::string& filename = _geometryParameters.getLoadCacheFile();
     BRAYNS_INFO << "Loading scene from binary file: " << filename << std::endl;
-    std::ifstream file( filename, std::ios::in | std::ios::binary );
-    if( !file.good( ))
-    {
-        BRAYNS_ERROR << "Could not open cache file " << filename << std::endl;
-        return;
-    }
 
-    size_t version;
-    file.read( (char*)&version, sizeof( size_t ));
+    const size_t version = SceneCache::getVersion( filename );
     BRAYNS_INFO << "Version: " << version << std::endl;
 
-    if( version != CACHE_VERSION )
-    {
-        BRAYNS_ERROR << "Only version " << CACHE_VERSION
-                     << " is supported" << std::endl;
+    if( version == CACHE_VERSION )
+        _loadMappedCacheFile( filename );
+    else if( version == COMPRESSED_CACHE_VERSION )
+        _loadCompressedCacheFile( filename );
+    else
+        BRAYNS_ERROR << "Only versions " << CACHE_VERSION << " and "
+                     << COMPRESSED_CACHE_VERSION << " are supported"
+                     << std::endl;
+}
+
+void OSPRayScene::_loadMappedCacheFile( const std::string& filename )
+{
+    if( !_mapCacheFile( filename ))
         return;
-    }
 
-    _models.clear();
-    size_t nbModels;
-    file.read( (char*)&nbModels, sizeof( size_t ));
-    BRAYNS_INFO << nbModels << " models" << std::endl;
-    for( size_t model = 0; model < nbModels; ++model )
+    const char* begin = static_cast< const char* >( _cacheMemoryMap );
+    SceneCacheMaterials materials;
+    Boxf bounds;
+    if( !SceneCache::parse( begin, begin + _cacheMemoryMapSize,
+                            _ospMaterials.size(), materials, bounds ))
     {
-        size_t ts;
-        file.read( (char*)&ts, sizeof( size_t ));
-        BRAYNS_INFO << "Model for ts " << ts << " created" << std::endl;
-        _models[ts] = ospNewModel();
+        BRAYNS_ERROR << "Corrupted cache file " << filename << std::endl;
+        _unmapCacheFile();
+        return;
     }
+    BRAYNS_INFO << materials.size() << " materials" << std::endl;
 
-    size_t nbMaterials;
-    file.read( (char*)&nbMaterials, sizeof( size_t ));
-    BRAYNS_INFO << nbMaterials << " materials" << std::endl;
-    for( size_t materialId = 0; materialId < nbMaterials; ++materialId )
-    {
-        // Spheres
-        size_t bufferSize = 0;
+    // Primitives are shared with OSPRay straight from the memory mapped file.
+    // They are only copied to the scene arrays when they have to be merged
+    // or saved to another cache file
+    const bool copyPrimitives =
+        _isMerged() || !_geometryParameters.getSaveCacheFile().empty();
 
-        file.read( ( char* )&bufferSize, sizeof( size_t ));
-        for( size_t i = 0; i<bufferSize; ++i)
-        {
-            size_t ts;
-            file.read( ( char* )&ts, sizeof( size_t ));
-            size_t index;
-            file.read( ( char* )&index, sizeof( size_t ));
-            _timestampSpheresIndices[materialId][ts] = index;
-        }
-
-        file.read( ( char* )&bufferSize, sizeof( size_t ));
-        _serializedSpheresDataSize[materialId] = bufferSize /
-            ( Sphere::getSerializationSize() * sizeof( float ));
-        if( bufferSize != 0 )
-        {
+    for( size_t materialId = 0; materialId < materials.size(); ++materialId )
+    {
+        const SceneCacheMaterial& material = materials[materialId];
+        _timestampSpheresIndices[materialId] =
+            material.spheres.timestampIndices;
+        _timestampCylindersIndices[materialId] =
+            material.cylinders.timestampIndices;
+        _timestampConesIndices[materialId] = material.cones.timestampIndices;
+
+        const Sphere* spheres =
+            reinterpret_cast< const Sphere* >( material.spheres.data );
+        const Cylinder* cylinders =
+            reinterpret_cast< const Cylinder* >( material.cylinders.data );
+        const Cone* cones =
+            reinterpret_cast< const Cone* >( material.cones.data );
+        _spheresCount[materialId] = material.spheres.size / sizeof( Sphere );
+        _cylindersCount[materialId] =
+            material.cylinders.size / sizeof( Cylinder );
+        _conesCount[materialId] = material.cones.size / sizeof( Cone );
+
+        if( _spheresCount[materialId] != 0 )
             BRAYNS_DEBUG << "[" << materialId << "] "
-                         << _serializedSpheresDataSize[materialId]
+                         << _spheresCount[materialId]
                          << " Spheres" << std::endl;
-            _serializedSpheresData[materialId].resize( bufferSize );
-            file.read( (char*)_serializedSpheresData[materialId].data(),
-                bufferSize );
-        }
-
-        // Cylinders
-        bufferSize = 0;
-        file.read( ( char* )&bufferSize, sizeof( size_t ));
-        for( size_t i = 0; i<bufferSize; ++i)
-        {
-            size_t ts;
-            file.read( ( char* )&ts, sizeof( size_t ));
-            size_t index;
-            file.read( ( char* )&index, sizeof( size_t ));
-            _timestampCylindersIndices[materialId][ts] = index;
-        }
-
-        file.read( (char*)&bufferSize, sizeof( size_t ));
-        _serializedCylindersDataSize[materialId] = bufferSize /
-            ( Cylinder::getSerializationSize() * sizeof( float ));
-        if( bufferSize != 0 )
-        {
+        if( _cylindersCount[materialId] != 0 )
             BRAYNS_DEBUG << "[" << materialId << "] "
-                         << _serializedCylindersDataSize[materialId]
+                         << _cylindersCount[materialId]
                          << " Cylinders" << std::endl;
-            _serializedCylindersData[materialId].reserve( bufferSize );
-            file.read( (char*)_serializedCylindersData[materialId].data(),
-                bufferSize );
-        }
+        if( _conesCount[materialId] != 0 )
+            BRAYNS_DEBUG << "[" << materialId << "] "
+                         << _conesCount[materialId]
+                         << " Cones" << std::endl;
 
-        // Cones
-        bufferSize = 0;
-        file.read( ( char* )&bufferSize, sizeof( size_t ));
-        for( size_t i = 0; i<bufferSize; ++i)
+        if( copyPrimitives )
         {
-            size_t ts;
-            file.read( ( char* )&ts, sizeof( size_t ));
-            size_t index;
-            file.read( ( char* )&index, sizeof( size_t ));
-            _timestampConesIndices[materialId][ts] = index;
+            _spheres[materialId].assign(
+                spheres, spheres + _spheresCount[materialId] );
+            _cylinders[materialId].assign(
+                cylinders, cylinders + _cylindersCount[materialId] );
+            _cones[materialId].assign(
+                cones, cones + _conesCount[materialId] );
+            spheres = _spheres[materialId].data();
+            cylinders = _cylinders[materialId].data();
+            cones = _cones[materialId].data();
         }
 
-        file.read( (char*)&bufferSize, sizeof( size_t ));
-        _serializedConesDataSize[materialId] = bufferSize /
-            ( Cone::getSerializationSize() * sizeof( float ));
-        if( bufferSize != 0 )
+        if( !_isMerged( ))
+            _buildParametricOSPGeometry( materialId, spheres, cylinders,
+                                         cones );
+    }
+
+    if( _isMerged( ))
+        _buildMergedOSPGeometry();
+
+    // In compact mode, OSPRay holds its own copy of the primitives. The
+    // mapping is otherwise referenced by the geometries and kept until the
+    // scene is destroyed
+    if( copyPrimitives || _isCompact( ))
+        _unmapCacheFile();
+
+    _bounds = bounds;
+    BRAYNS_INFO << _bounds << std::endl;
+    BRAYNS_INFO << "Scene successfully loaded"<< std::endl;
+}
+
+void OSPRayScene::_loadCompressedCacheFile( const std::string& filename )
+{
+    SceneCacheContainer container = _getCacheContainer();
+    size_t nbMaterials = 0;
+    Boxf bounds;
+    if( !SceneCache::loadCompressed( filename, _ospMaterials.size(),
+                                     container, nbMaterials, bounds ))
+        return;
+
+    for( size_t materialId = 0; materialId < nbMaterials; ++materialId )
+    {
+        _spheresCount[materialId] = _spheres[materialId].size();
+        _cylindersCount[materialId] = _cylinders[materialId].size();
+        _conesCount[materialId] = _cones[materialId].size();
+
+        if( !_isMerged( ))
         {
-            BRAYNS_DEBUG << "[" << materialId << "] "
-                         << _serializedConesDataSize[materialId]
-                         << " Cones" << std::endl;
-            _serializedConesData[materialId].reserve( bufferSize );
-            file.read( (char*)_serializedConesData[materialId].data(),
-                bufferSize );
+            _buildParametricOSPGeometry( materialId,
+                _spheres[materialId].data(), _cylinders[materialId].data(),
+                _cones[materialId].data( ));
+            if( _isCompact() &&
+                _geometryParameters.getSaveCacheFile().empty( ))
+                _releasePrimitives( materialId );
         }
-
-        _buildParametricOSPGeometry( materialId );
     }
 
-    // Scene bounds
-    file.read( ( char* )&_bounds, sizeof( Boxf ));
+    if( _isMerged( ))
+        _buildMergedOSPGeometry();
 
+    _bounds = bounds;
     BRAYNS_INFO << _bounds << std::endl;
     BRAYNS_INFO << "Scene successfully loaded"<< std::endl;
-    file.close();
 }
 
-void OSPRayScene::_buildParametricOSPGeometry( const size_t materialId )
+bool OSPRayScene::_isCompact() const
 {
-    // Extended spheres
-    for( const auto& timestampSpheresIndex: _timestampSpheresIndices[materialId] )
+    return _geometryParameters.getCompactScene();
+}
+
+bool OSPRayScene::_isMerged() const
+{
+    return _geometryParameters.getMergeMaterials();
+}
+
+void OSPRayScene::_releasePrimitives( const size_t materialId )
+{
+    Spheres().swap( _spheres[materialId] );
+    Cylinders().swap( _cylinders[materialId] );
+    Cones().swap( _cones[materialId] );
+}
+
+OSPGeometry OSPRayScene::_addGeometry(
+    OSPModel model,
+    OSPGeometry geometry,
+    const size_t materialId )
+{
+    if( _ospMaterials[materialId] )
+        ospSetMaterial( geometry, _ospMaterials[materialId] );
+    ospCommit( geometry );
+    ospAddGeometry( model, geometry );
+    return geometry;
+}
+
+void OSPRayScene::_removeGeometries( std::vector< OSPGeometry >& geometries )
+{
+    for( OSPGeometry geometry: geometries )
     {
-        const size_t spheresBufferSize =
-            timestampSpheresIndex.second * Sphere::getSerializationSize();
+        ospRemoveGeometry( _model, geometry );
+        ospRelease( geometry );
+    }
+    geometries.clear();
+}
 
-        for( const auto& model: _models )
-        {
-            if( timestampSpheresIndex.first <= model.first )
-            {
-                OSPGeometry extendedSpheres =
-                    ospNewGeometry("extendedspheres");
-                OSPData data = ospNewData( spheresBufferSize, OSP_FLOAT,
-                    &_serializedSpheresData[materialId][0],
-                    OSP_DATA_SHARED_BUFFER );
+void OSPRayScene::_buildParametricOSPGeometry(
+    const size_t materialId,
+    const Sphere* spheres,
+    const Cylinder* cylinders,
+    const Cone* cones )
+{
+    _buildParametricOSPGeometry(
+        materialId,
+        spheres, _timestampSpheresIndices[materialId],
+        cylinders, _timestampCylindersIndices[materialId],
+        cones, _timestampConesIndices[materialId],
+        _materialGeometries[materialId] );
+}
 
-                ospSetObject(extendedSpheres,
-                    "extendedspheres", data );
-                ospSet1i(extendedSpheres, "bytes_per_extended_sphere",
-                    Sphere::getSerializationSize() * sizeof(float));
-                ospSet1i(extendedSpheres,
-                    "offset_radius", 3 * sizeof(float));
-                ospSet1i(extendedSpheres,
-                    "offset_timestamp", 4 * sizeof(float));
-                ospSet1i(extendedSpheres,
-                    "offset_value", 5 * sizeof(float));
-
-                if(_ospMaterials[materialId])
-                    ospSetMaterial( extendedSpheres, _ospMaterials[materialId]);
-
-                ospCommit( extendedSpheres );
-                ospAddGeometry( model.second, extendedSpheres );
-            }
-        }
+void OSPRayScene::_buildParametricOSPGeometry(
+    const size_t materialId,
+    const Sphere* spheres,
+    const TimestampIndices& timestampSpheresIndices,
+    const Cylinder* cylinders,
+    const TimestampIndices& timestampCylindersIndices,
+    const Cone* cones,
+    const TimestampIndices& timestampConesIndices,
+    OSPGeometries& geometries )
+{
+    // In compact mode, OSPRay gets its own copy of the primitives so that the
+    // scene arrays can be released
+    const uint32_t dataFlags = _isCompact() ? 0 : OSP_DATA_SHARED_BUFFER;
+
+    // Primitives are sorted by timestamp. Every time bucket is a contiguous
+    // range of the primitive array, split into bricks of at most
+    // MAX_PRIMITIVES_PER_BRICK primitives. Every brick becomes a geometry that
+    // knows the smallest timestamp of its primitives. Geometries that are not
+    // visible yet at the current timestamp are then skipped as a whole
+
+    // Extended spheres
+    size_t begin = 0;
+    for( const size_t end: _getGeometryRanges( timestampSpheresIndices ))
+    {
+        geometries.spheres.push_back( _addGeometry( _model,
+            _createExtendedSpheres( spheres + begin, end - begin, dataFlags ),
+            materialId ));
+        begin = end;
     }
 
     // Extended cylinders
-    for( const auto& timestampCylindersIndex: _timestampCylindersIndices[materialId] )
+    begin = 0;
+    for( const size_t end: _getGeometryRanges( timestampCylindersIndices ))
     {
-        const size_t cylindersBufferSize =
-            timestampCylindersIndex.second * Cylinder::getSerializationSize();
+        geometries.cylinders.push_back( _addGeometry( _model,
+            _createExtendedCylinders( cylinders + begin, end - begin,
+                                      dataFlags ), materialId ));
+        begin = end;
+    }
 
-        for( const auto& model: _models )
-        {
-            if( timestampCylindersIndex.first <= model.first )
-            {
-                OSPGeometry extendedCylinders =
-                    ospNewGeometry("extendedcylinders");
-                assert( extendedCylinders );
+    // Extended cones
+    begin = 0;
+    for( const size_t end: _getGeometryRanges( timestampConesIndices ))
+    {
+        geometries.cones.push_back( _addGeometry( _model,
+            _createExtendedCones( cones + begin, end - begin, dataFlags ),
+            materialId ));
+        begin = end;
+    }
+}
 
-                OSPData data = ospNewData(
-                    cylindersBufferSize, OSP_FLOAT,
-                    &_serializedCylindersData[materialId][0],
-                    OSP_DATA_SHARED_BUFFER );
+void OSPRayScene::_buildGeometryBatch( GeometryBatch& batch )
+{
+    // Batches always have their own geometries per material, even when
+    // materials of the rest of the scene are merged
+    std::set< size_t > materialIds;
+    for( const auto& spheres: batch.spheres )
+        materialIds.insert( spheres.first );
+    for( const auto& cylinders: batch.cylinders )
+        materialIds.insert( cylinders.first );
+    for( const auto& cones: batch.cones )
+        materialIds.insert( cones.first );
+
+    for( const size_t materialId: materialIds )
+    {
+        const Spheres& spheres = batch.spheres[materialId];
+        const Cylinders& cylinders = batch.cylinders[materialId];
+        const Cones& cones = batch.cones[materialId];
+        if( spheres.empty() && cylinders.empty() && cones.empty( ))
+            continue;
+
+        _buildParametricOSPGeometry(
+            materialId,
+            spheres.data(), batch.timestampSpheresIndices[materialId],
+            cylinders.data(), batch.timestampCylindersIndices[materialId],
+            cones.data(), batch.timestampConesIndices[materialId],
+            _batchGeometries[&batch] );
+        _isEmpty = false;
+    }
 
-                ospSetObject( extendedCylinders, "extendedcylinders", data);
-                ospSet1i(extendedCylinders, "bytes_per_extended_cylinder",
-                    Cylinder::getSerializationSize() * sizeof(float));
-                ospSet1i(extendedCylinders,
-                    "offset_timestamp", 7 * sizeof(float));
-                ospSet1i(extendedCylinders, "offset_value", 8 * sizeof(float));
+    // In compact mode, OSPRay holds its own copy of the primitives
+    if( _isCompact( ))
+    {
+        batch.spheres.clear();
+        batch.cylinders.clear();
+        batch.cones.clear();
+    }
+}
 
-                if( _ospMaterials[materialId] )
-                    ospSetMaterial( extendedCylinders,
-                                    _ospMaterials[materialId]);
+void OSPRayScene::_removeGeometryBatch( GeometryBatch& batch )
+{
+    auto it = _batchGeometries.find( &batch );
+    if( it == _batchGeometries.end( ))
+        return;
 
-                ospCommit(extendedCylinders);
-                ospAddGeometry( model.second, extendedCylinders);
-            }
-        }
+    _removeGeometries( it->second.spheres );
+    _removeGeometries( it->second.cylinders );
+    _removeGeometries( it->second.cones );
+    _batchGeometries.erase( it );
+}
+
+void OSPRayScene::_buildMergedOSPGeometry()
+{
+    const bool timeBuckets = _geometryParameters.getGenerateMultipleModels();
+    const uint32_t dataFlags = _isCompact() ? 0 : OSP_DATA_SHARED_BUFFER;
+
+    // Primitives of all materials share the same geometries. Every primitive
+    // holds the index of its material in the material list of the geometry
+    OSPData materialList = ospNewData(
+        _ospMaterials.size(), OSP_OBJECT, _ospMaterials.data( ));
+    ospCommit( materialList );
+
+    // Extended spheres
+    std::map< size_t, size_t > timestampIndices;
+    _materialSpheres = _mergePrimitives( _spheres, timeBuckets,
+                                         timestampIndices );
+    size_t begin = 0;
+    for( const size_t end: _getGeometryRanges( timestampIndices ))
+    {
+        OSPGeometry extendedSpheres = _createExtendedSpheres(
+            &_materialSpheres[begin], end - begin, dataFlags );
+        ospSetObject( extendedSpheres, "materialList", materialList );
+        ospSet1i( extendedSpheres, "offset_materialID", sizeof( Sphere ));
+        ospCommit( extendedSpheres );
+        ospAddGeometry( _model, extendedSpheres );
+        _mergedGeometries.push_back( extendedSpheres );
+        begin = end;
+    }
+
+    // Extended cylinders
+    timestampIndices.clear();
+    _materialCylinders = _mergePrimitives( _cylinders, timeBuckets,
+                                           timestampIndices );
+    begin = 0;
+    for( const size_t end: _getGeometryRanges( timestampIndices ))
+    {
+        OSPGeometry extendedCylinders = _createExtendedCylinders(
+            &_materialCylinders[begin], end - begin, dataFlags );
+        ospSetObject( extendedCylinders, "materialList", materialList );
+        ospSet1i( extendedCylinders, "offset_materialID", sizeof( Cylinder ));
+        ospCommit( extendedCylinders );
+        ospAddGeometry( _model, extendedCylinders );
+        _mergedGeometries.push_back( extendedCylinders );
+        begin = end;
     }
 
     // Extended cones
-    for( const auto& timestampConesIndex: _timestampConesIndices[materialId] )
+    timestampIndices.clear();
+    _materialCones = _mergePrimitives( _cones, timeBuckets, timestampIndices );
+    begin = 0;
+    for( const size_t end: _getGeometryRanges( timestampIndices ))
     {
-        const size_t conesBufferSize =
-            timestampConesIndex.second * Cone::getSerializationSize();
+        OSPGeometry extendedCones = _createExtendedCones(
+            &_materialCones[begin], end - begin, dataFlags );
+        ospSetObject( extendedCones, "materialList", materialList );
+        ospSet1i( extendedCones, "offset_materialID", sizeof( Cone ));
+        ospCommit( extendedCones );
+        ospAddGeometry( _model, extendedCones );
+        _mergedGeometries.push_back( extendedCones );
+        begin = end;
+    }
 
-        for( const auto& model: _models )
-        {
-            if( timestampConesIndex.first <= model.first )
-            {
-                OSPGeometry extendedCones = ospNewGeometry("extendedcones");
-                assert(extendedCones);
+    // The geometries hold their own reference to the material list
+    ospRelease( materialList );
 
-                OSPData data = ospNewData(
-                    conesBufferSize, OSP_FLOAT,
-                    &_serializedConesData[materialId][0],
-                    OSP_DATA_SHARED_BUFFER );
+    // In compact mode, OSPRay holds its own copy of the merged primitives
+    if( _isCompact( ))
+    {
+        MaterialSpheres().swap( _materialSpheres );
+        MaterialCylinders().swap( _materialCylinders );
+        MaterialCones().swap( _materialCones );
+    }
+}
+
+OSPModel OSPRayScene::_buildTemplateOSPModel( GeometryLevel& geometryLevel )
+{
+    const uint32_t dataFlags = _isCompact() ? 0 : OSP_DATA_SHARED_BUFFER;
+
+    // Templates are small enough to be built as one geometry per material
+    // and type of primitive
+    OSPModel model = ospNewModel();
+    for( auto& spheres: geometryLevel.spheres )
+        if( !spheres.second.empty( ))
+            _addGeometry( model, _createExtendedSpheres(
+                spheres.second.data(), spheres.second.size(), dataFlags ),
+                spheres.first );
+
+    for( auto& cylinders: geometryLevel.cylinders )
+        if( !cylinders.second.empty( ))
+            _addGeometry( model, _createExtendedCylinders(
+                cylinders.second.data(), cylinders.second.size(), dataFlags ),
+                cylinders.first );
+
+    for( auto& cones: geometryLevel.cones )
+        if( !cones.second.empty( ))
+            _addGeometry( model, _createExtendedCones(
+                cones.second.data(), cones.second.size(), dataFlags ),
+                cones.first );
+
+    ospCommit( model );
+
+    if( _isCompact( ))
+    {
+        SpheresMap().swap( geometryLevel.spheres );
+        CylindersMap().swap( geometryLevel.cylinders );
+        ConesMap().swap( geometryLevel.cones );
+    }
+    return model;
+}
 
-                ospSetObject(extendedCones, "extendedcones", data);
-                ospSet1i(extendedCones, "bytes_per_extended_cone",
-                    Cone::getSerializationSize() * sizeof(float));
-                ospSet1i(extendedCones, "offset_timestamp", 8 * sizeof(float));
-                ospSet1i(extendedCones, "offset_value", 9 * sizeof(float));
+void OSPRayScene::_buildInstances()
+{
+    if( _instances.empty( ))
+        return;
+
+    _templateModels.resize( _geometryTemplates.size( ));
+    for( size_t i = 0; i < _geometryTemplates.size(); ++i )
+        for( auto& geometryLevel: _geometryTemplates[i].levels )
+            _templateModels[i].push_back(
+                _buildTemplateOSPModel( geometryLevel ));
+
+    // Instances start with the most detailed level of their template, until
+    // levels of detail are committed for a camera
+    _instanceGeometries.reserve( _instances.size( ));
+    _instanceLevels.resize( _instances.size(), 0 );
+    for( const auto& instance: _instances )
+    {
+        OSPGeometry geometry = ospNewInstance(
+            _templateModels[instance.templateId][0],
+            _toAffine( instance.transformation ));
+        ospCommit( geometry );
+        ospAddGeometry( _model, geometry );
+        _instanceGeometries.push_back( geometry );
+    }
+
+    BRAYNS_INFO << _instances.size() << " instances of "
+                << _templateModels.size() << " geometry templates" << std::endl;
+}
+
+void OSPRayScene::commitLevelsOfDetail( const Camera& camera )
+{
+    const Vector3f& position = camera.getPosition();
+    if( _instances.empty() || position == _levelsOfDetailPosition )
+        return;
+    _levelsOfDetailPosition = position;
 
-                if( _ospMaterials[materialId] )
-                    ospSetMaterial( extendedCones, _ospMaterials[materialId]);
+    const float tanHalfFieldOfView =
+        std::tan( DEFAULT_FIELD_OF_VIEW * 0.5f * M_PI / 180.f );
 
-                ospCommit( extendedCones );
-                ospAddGeometry( model.second, extendedCones );
-           }
-       }
+    bool modified = false;
+    for( size_t i = 0; i < _instances.size(); ++i )
+    {
+        const Instance& instance = _instances[i];
+        const std::vector< OSPModel >& models =
+            _templateModels[instance.templateId];
+        if( models.size() < 2 )
+            continue;
+
+        // Size of the instance, relative to the height of the view at the
+        // distance of the instance. Circuit transformations are rigid, so the
+        // radius of the template is also the radius of the instance
+        const Boxf& bounds = _geometryTemplates[instance.templateId].bounds;
+        const Vector3f center = instance.transformation * bounds.getCenter();
+        const float radius = bounds.getSize().length() * 0.5f;
+        const float distance = ( center - position ).length();
+        const float projectedSize = distance > radius ?
+            radius / ( distance * tanHalfFieldOfView ) : 1.f;
+
+        size_t level = 0;
+        while( level < NB_LEVELS_OF_DETAIL_THRESHOLDS &&
+               projectedSize < LEVELS_OF_DETAIL_THRESHOLDS[level] )
+            ++level;
+        level = std::min( level, models.size() - 1 );
+        if( level == _instanceLevels[i] )
+            continue;
+
+        ospRemoveGeometry( _model, _instanceGeometries[i] );
+        ospRelease( _instanceGeometries[i] );
+        _instanceGeometries[i] = ospNewInstance(
+            models[level], _toAffine( instance.transformation ));
+        ospCommit( _instanceGeometries[i] );
+        ospAddGeometry( _model, _instanceGeometries[i] );
+        _instanceLevels[i] = level;
+        modified = true;
     }
+
+    if( modified )
+        ospCommit( _model );
 }
 
 void OSPRayScene::buildGeometry()
@@ -423,79 +903,84 @@ void OSPRayScene::buildGeometry()
 
     BRAYNS_INFO << "Building OSPRay geometry" << std::endl;
 
-    if( _geometryParameters.getGenerateMultipleModels() )
+    // The geometry of every material is replaced when the scene is built
+    // again, which happens when the default scene is added to an empty scene.
+    // Geometry added afterwards goes through geometry batches
+    const bool firstBuild = !_model;
+    if( firstBuild )
+        _model = ospNewModel();
+    else if( !_isEmpty && ( _isCompact() || _isMerged() || _cacheMemoryMap ))
     {
-        // Initialize models according to timestamps
-        for( size_t materialId = 0; materialId < _materials.size(); ++materialId )
-        {
-            for( const PrimitivePtr& primitive: _primitives[materialId] )
-            {
-                const size_t ts = primitive->getTimestamp();
-                if( _models.find(ts) == _models.end())
-                {
-                    _models[ts] = ospNewModel();
-                    BRAYNS_INFO << "Model created for timestamp " << ts
-                                << ": " << _models[ts] << std::endl;
-                }
-            }
-        }
+        BRAYNS_WARN << "Geometry cannot be rebuilt in compact or merged mode, "
+                    << "or when the scene is mapped from a cache file"
+                    << std::endl;
+        return;
     }
-    if( _models.size() == 0 )
-        // If no timestamp is available, create a default model at timestamp 0
-        _models[0] = ospNewModel();
 
-    BRAYNS_INFO << "Models to process: " << _models.size() << std::endl;
+    // Primitives are only split according to their timestamps if requested.
+    // Otherwise, one single geometry is created per material and type of
+    // primitive
+    const bool timeBuckets = _geometryParameters.getGenerateMultipleModels();
 
-    size_t totalNbVertices = 0;
-    size_t totalNbIndices = 0;
-
-    // Process geometries
-    for( size_t materialId = 0; materialId < _materials.size(); ++materialId )
+    // Containers are created upfront so that sorting threads never modify
+    // the structure of the maps
+    const size_t nbMaterials = _materials.size();
+    for( size_t materialId = 0; materialId < nbMaterials; ++materialId )
     {
-        _serializedSpheresDataSize[materialId] = 0;
-        _serializedCylindersDataSize[materialId] = 0;
-        _serializedConesDataSize[materialId] = 0;
+        _spheres[materialId];
+        _cylinders[materialId];
+        _cones[materialId];
+        _timestampSpheresIndices[materialId].clear();
+        _timestampCylindersIndices[materialId].clear();
+        _timestampConesIndices[materialId].clear();
+    }
 
-        size_t sphereCount = 0;
-        size_t cylinderCount = 0;
-        size_t coneCount = 0;
-        if( _primitives.find(materialId) != _primitives.end() )
+    // Sorting is independent for every material and type of primitive. The
+    // result does not depend on the number of threads
+    #pragma omp parallel for schedule( dynamic )
+    for( size_t task = 0; task < 3 * nbMaterials; ++task )
+    {
+        const size_t materialId = task / 3;
+        switch( task % 3 )
         {
-            for( const PrimitivePtr& primitive: _primitives[materialId] )
-            {
-                const float ts =
-                    ( _models.size() == 1 ) ? 0.f : primitive->getTimestamp();
-                switch(primitive->getGeometryType())
-                {
-                    case GT_SPHERE:
-                    {
-                        primitive->serializeData(_serializedSpheresData[materialId]);
-                        ++_serializedSpheresDataSize[materialId];
-                        ++sphereCount;
-                        _timestampSpheresIndices[materialId][ts] = sphereCount;
-                    }
-                    break;
-                    case GT_CYLINDER:
-                    {
-                        primitive->serializeData(_serializedCylindersData[materialId]);
-                        ++_serializedCylindersDataSize[materialId];
-                        ++cylinderCount;
-                        _timestampCylindersIndices[materialId][ts] = cylinderCount;
-                    }
-                    break;
-                    case GT_CONE:
-                    {
-                        primitive->serializeData(_serializedConesData[materialId]);
-                        ++_serializedConesDataSize[materialId];
-                        ++coneCount;
-                        _timestampConesIndices[materialId][ts] = coneCount;
-                    }
-                    default:
-                        break;
-                }
-            }
+        case 0:
+            sortPrimitives( _spheres[materialId], timeBuckets,
+                            _timestampSpheresIndices[materialId] );
+            break;
+        case 1:
+            sortPrimitives( _cylinders[materialId], timeBuckets,
+                            _timestampCylindersIndices[materialId] );
+            break;
+        default:
+            sortPrimitives( _cones[materialId], timeBuckets,
+                            _timestampConesIndices[materialId] );
+        }
+    }
 
-            _buildParametricOSPGeometry( materialId );
+    // OSPRay objects are created from a single thread since the API is not
+    // thread safe
+    for( size_t materialId = 0; materialId < nbMaterials; ++materialId )
+    {
+        OSPGeometries& geometries = _materialGeometries[materialId];
+        _removeGeometries( geometries.spheres );
+        _removeGeometries( geometries.cylinders );
+        _removeGeometries( geometries.cones );
+        _removeGeometries( geometries.meshes );
+
+        const Spheres& spheres = _spheres[materialId];
+        _spheresCount[materialId] = spheres.size();
+        const Cylinders& cylinders = _cylinders[materialId];
+        _cylindersCount[materialId] = cylinders.size();
+        const Cones& cones = _cones[materialId];
+        _conesCount[materialId] = cones.size();
+
+        if( !_isMerged( ))
+        {
+            _buildParametricOSPGeometry( materialId, spheres.data(),
+                                         cylinders.data(), cones.data( ));
+            if( _isCompact() &&
+                _geometryParameters.getSaveCacheFile().empty( ))
+                _releasePrimitives( materialId );
         }
 
         // Triangle mesh
@@ -508,7 +993,6 @@ void OSPRayScene::buildGeometry()
                 OSP_FLOAT3A,
                 &_trianglesMeshes[materialId].getVertices()[0],
                 OSP_DATA_SHARED_BUFFER);
-            totalNbVertices += _trianglesMeshes[materialId].getVertices().size();
 
             OSPData normals = ospNewData(
                 _trianglesMeshes[materialId].getNormals().size(),
@@ -520,7 +1004,6 @@ void OSPRayScene::buildGeometry()
                 OSP_INT3,
                 &_trianglesMeshes[materialId].getIndices()[0],
                 OSP_DATA_SHARED_BUFFER);
-            totalNbIndices += _trianglesMeshes[materialId].getIndices().size();
 
             OSPData colors = ospNewData(
                 _trianglesMeshes[materialId].getColors().size(),
@@ -545,25 +1028,42 @@ void OSPRayScene::buildGeometry()
 
             ospCommit(mesh);
 
-            // Meshes are by default added to all timestamps
-            for( const auto& model: _models )
-                ospAddGeometry( model.second, mesh);
+            ospAddGeometry( _model, mesh );
+            geometries.meshes.push_back( mesh );
         }
     }
 
-    commitLights();
+    if( _isMerged( ))
+    {
+        _removeGeometries( _mergedGeometries );
+        _buildMergedOSPGeometry();
+    }
+
+    if( firstBuild )
+    {
+        _buildInstances();
+
+        commitLights();
 
-    if(!_geometryParameters.getLoadCacheFile().empty())
-        _loadCacheFile();
+        if(!_geometryParameters.getLoadCacheFile().empty())
+            _loadCacheFile();
+    }
 
     size_t totalNbSpheres = 0;
     size_t totalNbCylinders = 0;
     size_t totalNbCones = 0;
     for( size_t i = 0; i < _materials.size(); ++i )
     {
-        totalNbSpheres += _serializedSpheresDataSize[i];
-        totalNbCylinders += _serializedCylindersDataSize[i];
-        totalNbCones += _serializedConesDataSize[i];
+        totalNbSpheres += _spheresCount[i];
+        totalNbCylinders += _cylindersCount[i];
+        totalNbCones += _conesCount[i];
+    }
+    size_t totalNbVertices = 0;
+    size_t totalNbIndices = 0;
+    for( auto& trianglesMesh: _trianglesMeshes )
+    {
+        totalNbVertices += trianglesMesh.second.getVertices().size();
+        totalNbIndices += trianglesMesh.second.getIndices().size();
     }
 
     BRAYNS_INFO << "--------------------" << std::endl;
@@ -571,15 +1071,30 @@ void OSPRayScene::buildGeometry()
     BRAYNS_INFO << "Spheres  : " << totalNbSpheres << std::endl;
     BRAYNS_INFO << "Cylinders: " << totalNbCylinders << std::endl;
     BRAYNS_INFO << "Cones    : " << totalNbCones << std::endl;
+    BRAYNS_INFO << "Instances: " << _instances.size() << std::endl;
     BRAYNS_INFO << "Vertices : " << totalNbVertices << std::endl;
     BRAYNS_INFO << "Indices  : " << totalNbIndices << std::endl;
     BRAYNS_INFO << "--------------------" << std::endl;
 
-    if(!_geometryParameters.getSaveCacheFile().empty())
-        _saveCacheFile();
+    if( firstBuild )
+    {
+        if(!_geometryParameters.getSaveCacheFile().empty())
+            _saveCacheFile();
 
-    _isEmpty = ( totalNbSpheres + totalNbCylinders +
-                 totalNbCones + totalNbVertices ) == 0;
+        // Merged geometries hold their own copy of the primitives, so the
+        // per-material arrays are not needed anymore
+        if( _isCompact() || _isMerged( ))
+        {
+            for( size_t materialId = 0; materialId < _materials.size();
+                 ++materialId )
+                _releasePrimitives( materialId );
+            BRAYNS_INFO << "Scene primitives released" << std::endl;
+        }
+    }
+
+    _isEmpty = ( totalNbSpheres + totalNbCylinders + totalNbCones +
+                 _instances.size() + totalNbVertices ) == 0 &&
+               _batchGeometries.empty();
 }
 
 void OSPRayScene::commitLights()
@@ -721,49 +1236,126 @@ void OSPRayScene::commitSimulationData()
 {
     SimulationDescriptorPtr simulationDescriptor = getSimulationDescriptor();
     if( !simulationDescriptor )
+    {
+        // Renderers may still use the simulation of the scene this one
+        // replaced, which does not apply anymore
+        _resetSimulationParametersOfOtherScenes();
         return;
+    }
 
-    for( const auto& renderer: _renderers )
-    {
-        OSPRayRenderer* osprayRenderer = dynamic_cast<OSPRayRenderer*>( renderer.lock().get( ));
+    // Data objects share the memory of the simulation frame, they are only
+    // replaced when another frame is requested
+    const uint64_t frame = _sceneParameters.getTimestamp();
+    if( _ospSimulationData && frame == _ospSimulationFrame )
+        return;
 
-        // Simulation data
-        const uint64_t frame = _sceneParameters.getTimestamp();
+    if( !_ospTransferFunctionDiffuseData )
+        commitTransferFunctionData();
 
+    // Quantized frames are passed as raw bytes, renderers decode them
+    // according to the encoding
+    const FrameEncoding encoding = simulationDescriptor->getFrameEncoding();
+    _releaseData( _ospSimulationData );
+    if( encoding == FE_FLOAT32 )
         _ospSimulationData = ospNewData(
             simulationDescriptor->getFrameSize( frame ), OSP_FLOAT,
             simulationDescriptor->getFramePointer( frame ), OSP_DATA_SHARED_BUFFER );
-        ospCommit( _ospSimulationData );
+    else
+        _ospSimulationData = ospNewData(
+            simulationDescriptor->getFrameBytes(), OSP_UCHAR,
+            simulationDescriptor->getFramePointer( frame ), OSP_DATA_SHARED_BUFFER );
+    ospCommit( _ospSimulationData );
+    _ospSimulationFrame = frame;
+
+    for( const auto& renderer: _renderers )
+    {
+        OSPRayRenderer* osprayRenderer = dynamic_cast<OSPRayRenderer*>( renderer.lock().get( ));
         ospSetData( osprayRenderer->impl(), "simulationData", _ospSimulationData );
+        ospSet1i( osprayRenderer->impl(), "simulationDataEncoding", encoding );
+        ospCommit( osprayRenderer->impl() );
+        osprayRenderer->setSimulationScene( this );
+    }
+}
+
+void OSPRayScene::commitTransferFunctionData()
+{
+    Vector4fs& diffuseColors = _transferFunction.getDiffuseColors();
+    floats& emissionIntensities = _transferFunction.getEmissionIntensities();
+    if( diffuseColors.empty() || emissionIntensities.empty( ))
+    {
+        // Renderers must not keep the transfer function of another scene
+        _resetSimulationParametersOfOtherScenes();
+        return;
+    }
+
+    // Transfer function Diffuse colors
+    _releaseData( _ospTransferFunctionDiffuseData );
+    _ospTransferFunctionDiffuseData = ospNewData(
+        diffuseColors.size(), OSP_FLOAT4,
+        &diffuseColors[0], OSP_DATA_SHARED_BUFFER );
+    ospCommit( _ospTransferFunctionDiffuseData );
+
+    // Transfer function emission data
+    _releaseData( _ospTransferFunctionEmissionData );
+    _ospTransferFunctionEmissionData = ospNewData(
+        emissionIntensities.size(), OSP_FLOAT,
+        &emissionIntensities[0], OSP_DATA_SHARED_BUFFER );
+    ospCommit( _ospTransferFunctionEmissionData );
+
+    for( const auto& renderer: _renderers )
+    {
+        OSPRayRenderer* osprayRenderer = dynamic_cast<OSPRayRenderer*>( renderer.lock().get( ));
 
-        // Transfer function Diffuse colors
-        _ospTransferFunctionDiffuseData = ospNewData(
-            _transferFunction.getDiffuseColors().size(), OSP_FLOAT4,
-            &_transferFunction.getDiffuseColors()[0], OSP_DATA_SHARED_BUFFER );
-        ospCommit( _ospTransferFunctionDiffuseData );
         ospSetData( osprayRenderer->impl(),
             "transferFunctionDiffuseData", _ospTransferFunctionDiffuseData );
-
-        // Transfer function emission data
-        _ospTransferFunctionEmissionData = ospNewData(
-            _transferFunction.getEmissionIntensities().size(), OSP_FLOAT,
-            &_transferFunction.getEmissionIntensities()[0], OSP_DATA_SHARED_BUFFER );
-        ospCommit( _ospTransferFunctionEmissionData );
         ospSetData( osprayRenderer->impl(),
             "transferFunctionEmissionData", _ospTransferFunctionEmissionData );
 
         // Transfer function size
         ospSet1i( osprayRenderer->impl(),
-            "transferFunctionSize", _transferFunction.getDiffuseColors().size() );
+            "transferFunctionSize", diffuseColors.size() );
 
         // Transfer function range
         ospSet1f( osprayRenderer->impl(),
             "transferFunctionMinValue", _transferFunction.getValuesRange().x() );
         ospSet1f( osprayRenderer->impl(),  "transferFunctionRange",
             _transferFunction.getValuesRange().y() - _transferFunction.getValuesRange().x() );
+        ospCommit( osprayRenderer->impl() );
+        osprayRenderer->setSimulationScene( this );
+    }
+}
+
+void OSPRayScene::_resetSimulationParametersOfOtherScenes()
+{
+    for( const auto& renderer: _renderers )
+    {
+        OSPRayRenderer* osprayRenderer =
+            dynamic_cast< OSPRayRenderer* >( renderer.lock().get( ));
+        if( osprayRenderer && osprayRenderer->getSimulationScene() &&
+            osprayRenderer->getSimulationScene() != this )
+        {
+            _resetSimulationParameters( *osprayRenderer );
+        }
     }
 }
 
+void OSPRayScene::_resetSimulationParameters( OSPRayRenderer& renderer )
+{
+    ospSetData( renderer.impl(), "simulationData", 0 );
+    ospSetData( renderer.impl(), "transferFunctionDiffuseData", 0 );
+    ospSetData( renderer.impl(), "transferFunctionEmissionData", 0 );
+    ospSet1i( renderer.impl(), "transferFunctionSize", 0 );
+    ospCommit( renderer.impl() );
+    renderer.setSimulationScene( 0 );
+}
+
+void OSPRayScene::_releaseData( OSPData& data )
+{
+    if( data )
+        ospRelease( data );
+    data = 0;
+}
+
 OSPTexture2D OSPRayScene::_createTexture2D(const std::string& textureName)
 {
     if(_ospTextures.find(textureName) != _ospTextures.end())
@@ -23,6 +23,7 @@
 
 #include <brayns/common/types.h>
 #include <brayns/common/scene/Scene.h>
+#include <brayns/io/SceneCache.h>
 #include <ospray/ospray.h>
 #include <ospray/common/OSPCommon.h>
 #include <fstream>
@@ -30,6 +31,36 @@
 namespace brayns
 {
 
+class OSPRayRenderer;
+
+/** Primitive followed by the index of its material, so that primitives of
+ *  all materials can share the same geometry */
+template< typename T >
+struct MaterialPrimitive : public T
+{
+    MaterialPrimitive() {}
+    MaterialPrimitive( const T& primitive, const uint32_t materialId_ )
+        : T( primitive )
+        , materialId( materialId_ )
+    {}
+
+    uint32_t materialId;
+};
+
+typedef std::vector< MaterialPrimitive< Sphere >> MaterialSpheres;
+typedef std::vector< MaterialPrimitive< Cylinder >> MaterialCylinders;
+typedef std::vector< MaterialPrimitive< Cone >> MaterialCones;
+
+/** OSPRay geometries built for a material or a batch, per type of primitive,
+ *  so that they can be replaced when primitives are modified */
+struct OSPGeometries
+{
+    std::vector< OSPGeometry > spheres;
+    std::vector< OSPGeometry > cylinders;
+    std::vector< OSPGeometry > cones;
+    std::vector< OSPGeometry > meshes;
+};
+
 class OSPRayScene: public brayns::Scene
 {
 public:
@@ -37,24 +68,61 @@ public:
         Renderers renderer,
         SceneParameters& sceneParameters,
         GeometryParameters& geometryParameters );
+    ~OSPRayScene();
 
     void commit() final;
     void buildGeometry() final;
     void commitLights() final;
     void commitMaterials( const bool updateOnly = false ) final;
     void commitSimulationData() final;
+    void commitTransferFunctionData() final;
+    void commitLevelsOfDetail( const Camera& camera ) final;
 
-    OSPModel* modelImpl( const size_t timestamp );
+    OSPModel modelImpl() { return _model; }
 
 private:
 
     OSPTexture2D _createTexture2D(const std::string& textureName);
 
-    void _buildParametricOSPGeometry( const size_t materialId );
+    OSPGeometry _addGeometry(
+        OSPModel model,
+        OSPGeometry geometry,
+        size_t materialId );
+    void _removeGeometries( std::vector< OSPGeometry >& geometries );
+    void _releaseData( OSPData& data );
+    void _resetSimulationParameters( OSPRayRenderer& renderer );
+    void _resetSimulationParametersOfOtherScenes();
+    void _buildParametricOSPGeometry(
+        size_t materialId,
+        const Sphere* spheres,
+        const Cylinder* cylinders,
+        const Cone* cones );
+    void _buildParametricOSPGeometry(
+        size_t materialId,
+        const Sphere* spheres,
+        const TimestampIndices& timestampSpheresIndices,
+        const Cylinder* cylinders,
+        const TimestampIndices& timestampCylindersIndices,
+        const Cone* cones,
+        const TimestampIndices& timestampConesIndices,
+        OSPGeometries& geometries );
+    void _buildGeometryBatch( GeometryBatch& batch ) final;
+    void _removeGeometryBatch( GeometryBatch& batch ) final;
+    void _buildMergedOSPGeometry();
+    OSPModel _buildTemplateOSPModel( GeometryLevel& geometryLevel );
+    void _buildInstances();
+    bool _isCompact() const;
+    bool _isMerged() const;
+    void _releasePrimitives( const size_t materialId );
+    SceneCacheContainer _getCacheContainer();
     void _loadCacheFile();
+    void _loadMappedCacheFile( const std::string& filename );
+    void _loadCompressedCacheFile( const std::string& filename );
     void _saveCacheFile();
+    bool _mapCacheFile( const std::string& filename );
+    void _unmapCacheFile();
 
-    std::map< size_t, OSPModel > _models;
+    OSPModel _model;
     std::vector<OSPMaterial> _ospMaterials;
     std::map<std::string, OSPTexture2D> _ospTextures;
 
@@ -64,19 +132,35 @@ private:
     OSPData _ospSimulationData;
     OSPData _ospTransferFunctionDiffuseData;
     OSPData _ospTransferFunctionEmissionData;
+    uint64_t _ospSimulationFrame;
 
     std::map< float, size_t > _timestamps;
 
-    std::map<size_t, floats> _serializedSpheresData;
-    std::map<size_t, floats> _serializedCylindersData;
-    std::map<size_t, floats> _serializedConesData;
-    std::map<size_t, size_t> _serializedSpheresDataSize;
-    std::map<size_t, size_t> _serializedCylindersDataSize;
-    std::map<size_t, size_t> _serializedConesDataSize;
+    std::map< size_t, size_t > _spheresCount;
+    std::map< size_t, size_t > _cylindersCount;
+    std::map< size_t, size_t > _conesCount;
+
+    TimestampIndicesMap _timestampSpheresIndices;
+    TimestampIndicesMap _timestampCylindersIndices;
+    TimestampIndicesMap _timestampConesIndices;
+
+    std::map< size_t, OSPGeometries > _materialGeometries;
+    std::map< const GeometryBatch*, OSPGeometries > _batchGeometries;
+    std::vector< OSPGeometry > _mergedGeometries;
+
+    std::vector< std::vector< OSPModel >> _templateModels;
+    std::vector< OSPGeometry > _instanceGeometries;
+    size_ts _instanceLevels;
+    Vector3f _levelsOfDetailPosition;
+
+    MaterialSpheres _materialSpheres;
+    MaterialCylinders _materialCylinders;
+    MaterialCones _materialCones;
 
-    std::map< size_t, std::map< size_t, size_t > > _timestampSpheresIndices;
-    std::map< size_t, std::map< size_t, size_t > > _timestampCylindersIndices;
-    std::map< size_t, std::map< size_t, size_t > > _timestampConesIndices;
+    // Memory mapped cache file. Its sections are shared with OSPRay, so the
+    // mapping lives as long as the geometries built from it
+    void* _cacheMemoryMap;
+    size_t _cacheMemoryMapSize;
 };
 
 }
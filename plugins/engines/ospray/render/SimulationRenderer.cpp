@@ -38,6 +38,7 @@ void SimulationRenderer::commit()
     AbstractRenderer::commit();
 
     _simulationData = getParamData( "simulationData" );
+    _simulationDataEncoding = getParam1i( "simulationDataEncoding", 0 );
     _transferFunctionDiffuseData = getParamData( "transferFunctionDiffuseData" );
     _transferFunctionEmissionData = getParamData( "transferFunctionEmissionData" );
     _transferFunctionSize = getParam1i( "transferFunctionSize", 0 );
@@ -58,7 +59,8 @@ void SimulationRenderer::commit()
                 _electronShadingEnabled,
                 _lightPtr, _lightArray.size(),
                 _materialPtr, _materialArray.size(),
-                _simulationData ? ( float* )_simulationData->data : NULL,
+                _simulationData ? _simulationData->data : NULL,
+                _simulationDataEncoding,
                 _transferFunctionDiffuseData ?
                     ( ispc::vec4f* )_transferFunctionDiffuseData->data : NULL,
                 _transferFunctionEmissionData ?
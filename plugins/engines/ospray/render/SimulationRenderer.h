@@ -48,6 +48,7 @@ public:
 private:
 
     ospray::Ref< ospray::Data > _simulationData;
+    ospray::int32 _simulationDataEncoding;
     ospray::Ref< ospray::Data > _transferFunctionDiffuseData;
     ospray::Ref< ospray::Data > _transferFunctionEmissionData;
     ospray::int32 _transferFunctionSize;
@@ -39,6 +39,8 @@ ZeroEQPlugin::ZeroEQPlugin(
     , _compressor( tjInitCompress( ))
     , _jpegCompression( applicationParameters.getJpegCompression( ))
     , _processingImageJpeg( false )
+    , _loadingCellSetRemoved( false )
+    , _cellSetThreadStopped( false )
 {
     _setupRequests( );
     _setupHTTPServer( );
@@ -46,6 +48,14 @@ ZeroEQPlugin::ZeroEQPlugin(
 
 ZeroEQPlugin::~ZeroEQPlugin( )
 {
+    {
+        std::lock_guard< std::mutex > lock( _cellSetMutex );
+        _cellSetThreadStopped = true;
+    }
+    _cellSetCondition.notify_one();
+    if( _cellSetThread.joinable( ))
+        _cellSetThread.join();
+
     if( _compressor )
         tjDestroy( _compressor );
 
@@ -112,6 +122,18 @@ void ZeroEQPlugin::_setupHTTPServer()
         std::bind( &ZeroEQPlugin::_transferFunction1DUpdated, this ));
     _remoteTransferFunction1D.registerSerializeCallback(
         std::bind( &ZeroEQPlugin::_requestTransferFunction1D, this ));
+
+    _httpServer->add( _remoteProgress );
+    _remoteProgress.registerSerializeCallback(
+        std::bind( &ZeroEQPlugin::_requestProgress, this ));
+
+    _httpServer->add( _remoteCellSet );
+    _remoteCellSet.registerDeserializedCallback(
+        std::bind( &ZeroEQPlugin::_cellSetUpdated, this ));
+
+    _httpServer->add( _remoteLoadScene );
+    _remoteLoadScene.registerDeserializedCallback(
+        std::bind( &ZeroEQPlugin::_loadSceneUpdated, this ));
 }
 
 void ZeroEQPlugin::_setupRequests()
@@ -133,6 +155,10 @@ void ZeroEQPlugin::_setupRequests()
     ::zerobuf::render::TransferFunction1D transferFunction1D;
     _requests[ transferFunction1D.getTypeIdentifier() ] =
         std::bind( &ZeroEQPlugin::_requestTransferFunction1D, this );
+
+    ::zerobuf::render::Progress progress;
+    _requests[ progress.getTypeIdentifier() ] =
+        std::bind( &ZeroEQPlugin::_requestProgress, this );
 }
 
 void ZeroEQPlugin::_cameraUpdated()
@@ -228,11 +254,149 @@ void ZeroEQPlugin::_transferFunction1DUpdated( )
         controlPoints.push_back( Vector2f(point.getX(), point.getY()));
     transferFunction.resample();
 
-    scene->commitSimulationData();
+    scene->commitTransferFunctionData();
     _extensionParameters.engine->getRenderer()->commit();
     _extensionParameters.engine->getFrameBuffer()->clear();
 }
 
+bool ZeroEQPlugin::_requestProgress()
+{
+    ScenePtr scene = _extensionParameters.engine->getScene();
+    _remoteProgress.setAmount( scene->getLoadingProgress( ));
+    return true;
+}
+
+void ZeroEQPlugin::_cellSetUpdated()
+{
+    ScenePtr scene = _extensionParameters.engine->getScene();
+    const std::string& name = _remoteCellSet.getNameString();
+    if( _remoteCellSet.getRemove( ))
+    {
+        BRAYNS_INFO << "Removing cell set <" << name << ">" << std::endl;
+        {
+            // Sets of that name that are queued or being loaded are dropped
+            std::lock_guard< std::mutex > lock( _cellSetMutex );
+            auto it = _cellSetRequests.begin();
+            while( it != _cellSetRequests.end( ))
+            {
+                if( it->name == name )
+                    it = _cellSetRequests.erase( it );
+                else
+                    ++it;
+            }
+            if( _loadingCellSet == name )
+                _loadingCellSetRemoved = true;
+        }
+        scene->removeGeometryBatches( name );
+        return;
+    }
+
+    const GeometryParameters& geometryParameters =
+        _extensionParameters.parametersManager->getGeometryParameters();
+    const std::string& circuitConfig =
+        geometryParameters.getCircuitConfiguration();
+    if( circuitConfig.empty( ))
+    {
+        BRAYNS_ERROR << "A circuit configuration is required to add cell "
+                     << "sets" << std::endl;
+        return;
+    }
+
+    const uints& gids = _remoteCellSet.getGidsVector();
+    BRAYNS_INFO << "Adding cell set <" << name << "> of " << gids.size()
+                << " cells" << std::endl;
+
+    // The cell set is loaded with the parameters of the request, whatever
+    // happens to the parameters in the meantime
+    const CellSetRequest request =
+    {
+        name, gids, scene,
+        std::make_shared< GeometryParameters >( geometryParameters )
+    };
+    {
+        std::lock_guard< std::mutex > lock( _cellSetMutex );
+        _cellSetRequests.push_back( request );
+        if( !_cellSetThread.joinable( ))
+            _cellSetThread = std::thread( &ZeroEQPlugin::_loadCellSets, this );
+    }
+    _cellSetCondition.notify_one();
+}
+
+void ZeroEQPlugin::_loadCellSets()
+{
+    std::unique_lock< std::mutex > lock( _cellSetMutex );
+    for( ;; )
+    {
+        _cellSetCondition.wait( lock, [this]
+            { return _cellSetThreadStopped || !_cellSetRequests.empty(); });
+        if( _cellSetThreadStopped )
+            return;
+
+        const CellSetRequest request = _cellSetRequests.front();
+        _cellSetRequests.pop_front();
+        _loadingCellSet = request.name;
+        _loadingCellSetRemoved = false;
+        lock.unlock();
+
+        GeometryBatch batch;
+        batch.name = request.name;
+        bool loaded = false;
+        try
+        {
+            MorphologyLoader morphologyLoader( *request.geometryParameters );
+            loaded = morphologyLoader.importCells(
+                request.geometryParameters->getCircuitConfiguration(),
+                request.gids, _cellSetSimulationOffsets, batch );
+        }
+        catch( const std::exception& e )
+        {
+            BRAYNS_ERROR << "Failed to load cell set <" << request.name
+                         << ">: " << e.what() << std::endl;
+        }
+
+        lock.lock();
+        _loadingCellSet.clear();
+
+        // The set replaces the batches of the same name in the scene, unless
+        // it was removed while being loaded
+        if( !loaded || _loadingCellSetRemoved )
+            continue;
+        request.scene->removeGeometryBatches( request.name );
+        request.scene->addGeometryBatch( batch );
+    }
+}
+
+void ZeroEQPlugin::_loadSceneUpdated()
+{
+    // The geometry parameters are read by the thread loading the new scene,
+    // so they are only modified once no scene is being loaded
+    EnginePtr engine = _extensionParameters.engine;
+    if( engine->isSceneLoadRequested() || engine->isSceneLoading( ))
+    {
+        BRAYNS_WARN << "A scene is already being loaded, the request is "
+                    << "ignored" << std::endl;
+        return;
+    }
+
+    // The data sources of the previous scene are replaced, including the
+    // cache files and the compartment report they were given with
+    GeometryParameters& geometryParameters =
+        _extensionParameters.parametersManager->getGeometryParameters();
+    geometryParameters.setMorphologyFolder(
+        _remoteLoadScene.getMorphologyFolderString( ));
+    geometryParameters.setPDBFile( _remoteLoadScene.getPdbFileString( ));
+    geometryParameters.setMeshFolder( _remoteLoadScene.getMeshFolderString( ));
+    geometryParameters.setCircuitConfiguration(
+        _remoteLoadScene.getCircuitConfigurationString( ));
+    geometryParameters.setTarget( _remoteLoadScene.getTargetString( ));
+    geometryParameters.setLoadCacheFile( "" );
+    geometryParameters.setReport( "" );
+    geometryParameters.setSimulationCacheFile( "" );
+
+    BRAYNS_INFO << "New scene requested" << std::endl;
+    engine->setSceneLoadRequested( true );
+}
+
 void ZeroEQPlugin::_resizeImage(
     unsigned int* srcData,
     const Vector2i& srcSize,
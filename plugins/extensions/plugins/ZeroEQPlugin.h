@@ -24,6 +24,7 @@
 #include "ExtensionPlugin.h"
 
 #include <brayns/api.h>
+#include <brayns/io/MorphologyLoader.h>
 #include <zeroeq/zeroeq.h>
 #include <turbojpeg.h>
 #include <lexis/render/imageJPEG.h>
@@ -32,6 +33,14 @@
 #include <zerobuf/render/reset.h>
 #include <zerobuf/render/material.h>
 #include <zerobuf/render/transferFunction1D.h>
+#include <zerobuf/render/progress.h>
+#include <zerobuf/render/cellSet.h>
+#include <zerobuf/render/loadScene.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 namespace brayns
 {
@@ -106,6 +115,30 @@ private:
      */
     bool _requestFrameBuffers();
 
+    /**
+     * @brief This method is called when the loading progress is requested by a ZeroEQ event
+     * @return True if the method was successfull, false otherwise
+     */
+    bool _requestProgress();
+
+    /**
+     * @brief This method is called when a set of cells is added to or removed from the scene by
+     *        a ZeroEQ event
+     */
+    void _cellSetUpdated();
+
+    /**
+     * @brief Loads the queued cell sets one after the other, in a background thread so that
+     *        the scene is rendered in the meantime
+     */
+    void _loadCellSets();
+
+    /**
+     * @brief This method is called when a new scene is requested by a ZeroEQ event. The scene is
+     *        loaded in the background and replaces the current one once loaded
+     */
+    void _loadSceneUpdated();
+
     /**
      * @brief Resizes an given image according to the new size
      * @param srcData Source buffer
@@ -148,7 +181,30 @@ private:
     ::zerobuf::render::Reset _remoteReset;
     ::zerobuf::render::Material _remoteMaterial;
     ::zerobuf::render::TransferFunction1D _remoteTransferFunction1D;
-
+    ::zerobuf::render::Progress _remoteProgress;
+    ::zerobuf::render::CellSet _remoteCellSet;
+    ::zerobuf::render::LoadScene _remoteLoadScene;
+
+    /** Cell set queued for the background loading thread */
+    struct CellSetRequest
+    {
+        std::string name;
+        uints gids;
+        ScenePtr scene;
+        GeometryParametersPtr geometryParameters;
+    };
+
+    std::thread _cellSetThread;
+    std::mutex _cellSetMutex;
+    std::condition_variable _cellSetCondition;
+    std::deque< CellSetRequest > _cellSetRequests;
+    std::string _loadingCellSet;
+    bool _loadingCellSetRemoved;
+    bool _cellSetThreadStopped;
+
+    // Simulation offsets of the circuit target, only used by the cell set
+    // thread, so that every cell set does not compute them again
+    TargetSimulationOffsets _cellSetSimulationOffsets;
 };
 
 }
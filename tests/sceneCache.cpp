@@ -0,0 +1,302 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include <brayns/io/SceneCache.h>
+#include <brayns/common/geometry/Cone.h>
+#include <brayns/common/geometry/Cylinder.h>
+#include <brayns/common/geometry/Sphere.h>
+
+#define BOOST_TEST_MODULE sceneCache
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+const size_t NB_MATERIALS = 3;
+
+/** Primitives referenced by a SceneCacheContainer */
+struct Primitives
+{
+    brayns::SpheresMap spheres;
+    brayns::CylindersMap cylinders;
+    brayns::ConesMap cones;
+    brayns::TimestampIndicesMap timestampSpheresIndices;
+    brayns::TimestampIndicesMap timestampCylindersIndices;
+    brayns::TimestampIndicesMap timestampConesIndices;
+
+    brayns::SceneCacheContainer container()
+    {
+        return { spheres, cylinders, cones, timestampSpheresIndices,
+                 timestampCylindersIndices, timestampConesIndices };
+    }
+};
+
+std::string tempFile()
+{
+    return ( boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path( "%%%%-%%%%.bin" )).string();
+}
+
+// Material 1 has no primitive, the others have primitives of every type
+// sorted by timestamp
+void createPrimitives( Primitives& primitives, brayns::Boxf& bounds )
+{
+    for( size_t materialId = 0; materialId < NB_MATERIALS; ++materialId )
+    {
+        primitives.spheres[materialId];
+        primitives.cylinders[materialId];
+        primitives.cones[materialId];
+        if( materialId == 1 )
+            continue;
+
+        for( size_t i = 0; i < 1000; ++i )
+        {
+            const float t = float( i / 100 );
+            const brayns::Vector3f center( float( i ), float( materialId ), 0.f );
+            const brayns::Vector3f up( float( i ), float( materialId ), 1.f );
+            primitives.spheres[materialId].push_back(
+                brayns::Sphere( center, 0.5f, t, float( i )));
+            primitives.cylinders[materialId].push_back(
+                brayns::Cylinder( center, up, 0.25f, t, float( i )));
+            primitives.cones[materialId].push_back(
+                brayns::Cone( center, up, 0.25f, 0.125f, t, float( i )));
+            bounds.merge( center );
+            bounds.merge( up );
+        }
+        for( size_t ts = 0; ts < 10; ++ts )
+        {
+            const size_t index = ( ts + 1 ) * 100;
+            primitives.timestampSpheresIndices[materialId][ts] = index;
+            primitives.timestampCylindersIndices[materialId][ts] = index;
+            primitives.timestampConesIndices[materialId][ts] = index;
+        }
+    }
+}
+
+void save( const std::string& filename, Primitives& primitives,
+           const bool compress )
+{
+    brayns::Boxf bounds;
+    createPrimitives( primitives, bounds );
+    BOOST_REQUIRE( brayns::SceneCache::save( filename, primitives.container(),
+                                             NB_MATERIALS, bounds, compress ));
+    BOOST_REQUIRE_EQUAL( brayns::SceneCache::getVersion( filename ),
+                         compress ? brayns::COMPRESSED_CACHE_VERSION :
+                                    brayns::CACHE_VERSION );
+}
+
+void checkBounds( const brayns::Boxf& bounds )
+{
+    BOOST_CHECK_EQUAL( bounds.getMin(), brayns::Vector3f( 0.f, 0.f, 0.f ));
+    BOOST_CHECK_EQUAL( bounds.getMax(), brayns::Vector3f( 999.f, 2.f, 1.f ));
+}
+
+template< typename T >
+std::vector< T > sectionPrimitives( const brayns::SceneCacheSection& section )
+{
+    const T* primitives = reinterpret_cast< const T* >( section.data );
+    return std::vector< T >( primitives, primitives + section.size / sizeof( T ));
+}
+
+void checkSpheres( const brayns::Spheres& loaded, const brayns::Spheres& saved )
+{
+    BOOST_REQUIRE_EQUAL( loaded.size(), saved.size( ));
+    for( size_t i = 0; i < loaded.size(); ++i )
+    {
+        BOOST_CHECK_EQUAL( loaded[i].center, saved[i].center );
+        BOOST_CHECK_EQUAL( loaded[i].radius, saved[i].radius );
+        BOOST_CHECK_EQUAL( loaded[i].timestamp, saved[i].timestamp );
+        BOOST_CHECK_EQUAL( loaded[i].value, saved[i].value );
+    }
+}
+
+void checkCylinders( const brayns::Cylinders& loaded,
+                     const brayns::Cylinders& saved )
+{
+    BOOST_REQUIRE_EQUAL( loaded.size(), saved.size( ));
+    for( size_t i = 0; i < loaded.size(); ++i )
+    {
+        BOOST_CHECK_EQUAL( loaded[i].center, saved[i].center );
+        BOOST_CHECK_EQUAL( loaded[i].up, saved[i].up );
+        BOOST_CHECK_EQUAL( loaded[i].radius, saved[i].radius );
+        BOOST_CHECK_EQUAL( loaded[i].timestamp, saved[i].timestamp );
+        BOOST_CHECK_EQUAL( loaded[i].value, saved[i].value );
+    }
+}
+
+void checkCones( const brayns::Cones& loaded, const brayns::Cones& saved )
+{
+    BOOST_REQUIRE_EQUAL( loaded.size(), saved.size( ));
+    for( size_t i = 0; i < loaded.size(); ++i )
+    {
+        BOOST_CHECK_EQUAL( loaded[i].center, saved[i].center );
+        BOOST_CHECK_EQUAL( loaded[i].up, saved[i].up );
+        BOOST_CHECK_EQUAL( loaded[i].centerRadius, saved[i].centerRadius );
+        BOOST_CHECK_EQUAL( loaded[i].upRadius, saved[i].upRadius );
+        BOOST_CHECK_EQUAL( loaded[i].timestamp, saved[i].timestamp );
+        BOOST_CHECK_EQUAL( loaded[i].value, saved[i].value );
+    }
+}
+
+#ifdef BRAYNS_USE_ZLIB
+void checkEmpty( Primitives& primitives )
+{
+    for( size_t materialId = 0; materialId < NB_MATERIALS; ++materialId )
+    {
+        BOOST_CHECK( primitives.spheres[materialId].empty( ));
+        BOOST_CHECK( primitives.cylinders[materialId].empty( ));
+        BOOST_CHECK( primitives.cones[materialId].empty( ));
+        BOOST_CHECK( primitives.timestampSpheresIndices[materialId].empty( ));
+        BOOST_CHECK( primitives.timestampCylindersIndices[materialId].empty( ));
+        BOOST_CHECK( primitives.timestampConesIndices[materialId].empty( ));
+    }
+}
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( uncompressed_round_trip )
+{
+    const std::string filename = tempFile();
+    Primitives saved;
+    save( filename, saved, false );
+
+    std::ifstream file( filename, std::ios::in | std::ios::binary );
+    const std::vector< char > content(( std::istreambuf_iterator< char >( file )),
+                                      std::istreambuf_iterator< char >( ));
+    const char* begin = content.data();
+    const char* end = begin + content.size();
+
+    brayns::SceneCacheMaterials materials;
+    brayns::Boxf bounds;
+    BOOST_REQUIRE( brayns::SceneCache::parse( begin, end, NB_MATERIALS,
+                                              materials, bounds ));
+    BOOST_REQUIRE_EQUAL( materials.size(), NB_MATERIALS );
+    checkBounds( bounds );
+
+    for( size_t materialId = 0; materialId < NB_MATERIALS; ++materialId )
+    {
+        const auto& material = materials[materialId];
+        checkSpheres( sectionPrimitives< brayns::Sphere >( material.spheres ),
+                      saved.spheres[materialId] );
+        checkCylinders(
+            sectionPrimitives< brayns::Cylinder >( material.cylinders ),
+            saved.cylinders[materialId] );
+        checkCones( sectionPrimitives< brayns::Cone >( material.cones ),
+                    saved.cones[materialId] );
+        BOOST_CHECK( material.spheres.timestampIndices ==
+                     saved.timestampSpheresIndices[materialId] );
+        BOOST_CHECK( material.cylinders.timestampIndices ==
+                     saved.timestampCylindersIndices[materialId] );
+        BOOST_CHECK( material.cones.timestampIndices ==
+                     saved.timestampConesIndices[materialId] );
+    }
+
+    // Files with more materials than the scene are rejected
+    BOOST_CHECK( !brayns::SceneCache::parse( begin, end, NB_MATERIALS - 1,
+                                             materials, bounds ));
+
+    boost::filesystem::remove( filename );
+}
+
+#ifdef BRAYNS_USE_ZLIB
+BOOST_AUTO_TEST_CASE( compressed_round_trip )
+{
+    const std::string filename = tempFile();
+    Primitives saved;
+    save( filename, saved, true );
+
+    Primitives loaded;
+    auto container = loaded.container();
+    size_t nbMaterials = 0;
+    brayns::Boxf bounds;
+    BOOST_REQUIRE( brayns::SceneCache::loadCompressed(
+        filename, NB_MATERIALS, container, nbMaterials, bounds ));
+    BOOST_CHECK_EQUAL( nbMaterials, NB_MATERIALS );
+    checkBounds( bounds );
+
+    for( size_t materialId = 0; materialId < NB_MATERIALS; ++materialId )
+    {
+        checkSpheres( loaded.spheres[materialId], saved.spheres[materialId] );
+        checkCylinders( loaded.cylinders[materialId],
+                        saved.cylinders[materialId] );
+        checkCones( loaded.cones[materialId], saved.cones[materialId] );
+        BOOST_CHECK( loaded.timestampSpheresIndices[materialId] ==
+                     saved.timestampSpheresIndices[materialId] );
+        BOOST_CHECK( loaded.timestampCylindersIndices[materialId] ==
+                     saved.timestampCylindersIndices[materialId] );
+        BOOST_CHECK( loaded.timestampConesIndices[materialId] ==
+                     saved.timestampConesIndices[materialId] );
+    }
+
+    boost::filesystem::remove( filename );
+}
+
+BOOST_AUTO_TEST_CASE( compressed_corrupted_chunk )
+{
+    const std::string filename = tempFile();
+    Primitives saved;
+    save( filename, saved, true );
+
+    // Flip a byte of the last compressed chunk, which ends the file
+    const auto fileSize = boost::filesystem::file_size( filename );
+    {
+        std::fstream file( filename, std::ios::in | std::ios::out |
+                                     std::ios::binary );
+        file.seekg( fileSize - 16 );
+        char byte = 0;
+        file.read( &byte, 1 );
+        byte = ~byte;
+        file.seekp( fileSize - 16 );
+        file.write( &byte, 1 );
+    }
+
+    Primitives loaded;
+    auto container = loaded.container();
+    size_t nbMaterials = 0;
+    brayns::Boxf bounds;
+    BOOST_CHECK( !brayns::SceneCache::loadCompressed(
+        filename, NB_MATERIALS, container, nbMaterials, bounds ));
+    checkEmpty( loaded );
+
+    boost::filesystem::remove( filename );
+}
+
+BOOST_AUTO_TEST_CASE( compressed_too_many_materials )
+{
+    const std::string filename = tempFile();
+    Primitives saved;
+    save( filename, saved, true );
+
+    Primitives loaded;
+    auto container = loaded.container();
+    size_t nbMaterials = 0;
+    brayns::Boxf bounds;
+    BOOST_CHECK( !brayns::SceneCache::loadCompressed(
+        filename, NB_MATERIALS - 1, container, nbMaterials, bounds ));
+    BOOST_CHECK_EQUAL( nbMaterials, 0 );
+    checkEmpty( loaded );
+
+    boost::filesystem::remove( filename );
+}
+#endif
@@ -0,0 +1,260 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include <brayns/common/simulation/SimulationDescriptor.h>
+
+#define BOOST_TEST_MODULE simulationCache
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace
+{
+// Three cells of 2, 3 and 1 values
+const brayns::SimulationCells CELLS = {{ 10, 0, 2 }, { 20, 2, 3 }, { 30, 5, 1 }};
+const uint64_t FRAME_SIZE = 6;
+const uint64_t NB_FRAMES = 5;
+const float START_TIME = 2.f;
+const float TIMESTEP = 0.5f;
+
+std::string tempFile()
+{
+    return ( boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path( "%%%%-%%%%.cache" )).string();
+}
+
+// Value of a given frame, unique across the cache
+float frameValue( const uint64_t frame, const uint64_t index )
+{
+    return float( frame * 100 + index );
+}
+
+void writeCache( const std::string& filename, const brayns::FrameEncoding encoding )
+{
+    std::ofstream file( filename, std::ios::out | std::ios::binary );
+    brayns::SimulationDescriptor::writeHeader( file, NB_FRAMES, FRAME_SIZE, encoding,
+                                               START_TIME, TIMESTEP, CELLS );
+    for( uint64_t frame = 0; frame < NB_FRAMES; ++frame )
+    {
+        brayns::floats values;
+        for( uint64_t i = 0; i < FRAME_SIZE; ++i )
+            values.push_back( frameValue( frame, i ));
+        brayns::SimulationDescriptor::writeFrame( file, values, encoding );
+    }
+}
+
+template< typename T >
+brayns::floats decode( const uint8_t* data, const size_t size )
+{
+    float scale, offset;
+    ::memcpy( &scale, data, sizeof( float ));
+    ::memcpy( &offset, data + sizeof( float ), sizeof( float ));
+
+    const T* quantizedValues = reinterpret_cast< const T* >( data + 2 * sizeof( float ));
+    brayns::floats values;
+    for( size_t i = 0; i < size; ++i )
+        values.push_back( offset + scale * quantizedValues[i] );
+    return values;
+}
+
+template< typename T >
+void checkQuantization( const brayns::FrameEncoding encoding )
+{
+    brayns::floats values;
+    for( size_t i = 0; i < 1000; ++i )
+        values.push_back( -70.f + 100.f * std::sin( float( i )));
+    const float minValue = *std::min_element( values.begin(), values.end( ));
+    const float maxValue = *std::max_element( values.begin(), values.end( ));
+
+    brayns::uint8_ts data;
+    brayns::SimulationDescriptor::encodeFrame( values, encoding, data );
+    BOOST_REQUIRE_EQUAL( data.size(),
+        brayns::SimulationDescriptor::getFrameBytes( values.size(), encoding ));
+    BOOST_CHECK_EQUAL( data.size() % 8, 0 );
+
+    // Rounding to the nearest level is off by at most half a level
+    const float step = ( maxValue - minValue ) / std::numeric_limits< T >::max();
+    const float tolerance = step * 0.5f + ( maxValue - minValue ) * 1e-5f;
+    const auto decoded = decode< T >( data.data(), values.size( ));
+    for( size_t i = 0; i < values.size(); ++i )
+        BOOST_CHECK_LE( std::abs( decoded[i] - values[i] ), tolerance );
+}
+
+void checkFrames( brayns::SimulationDescriptor& descriptor,
+                  const uint64_t firstFrame,
+                  const brayns::SimulationCells& cells )
+{
+    for( uint64_t frame = 0; frame < descriptor.getNbFrames(); ++frame )
+    {
+        const float* values = static_cast< const float* >( descriptor.getFramePointer( frame ));
+        BOOST_REQUIRE( values );
+        for( size_t i = 0; i < cells.size(); ++i )
+            for( uint64_t j = 0; j < cells[i].size; ++j )
+                BOOST_CHECK_EQUAL( values[descriptor.getCells()[i].offset + j],
+                                   frameValue( firstFrame + frame, cells[i].offset + j ));
+    }
+}
+}
+
+BOOST_AUTO_TEST_CASE( quantization_error_uint16 )
+{
+    checkQuantization< uint16_t >( brayns::FE_UINT16 );
+}
+
+BOOST_AUTO_TEST_CASE( quantization_error_uint8 )
+{
+    checkQuantization< uint8_t >( brayns::FE_UINT8 );
+}
+
+BOOST_AUTO_TEST_CASE( constant_frame_quantization )
+{
+    const brayns::floats values( 7, 3.5f );
+    brayns::uint8_ts data;
+    brayns::SimulationDescriptor::encodeFrame( values, brayns::FE_UINT8, data );
+    for( const auto value: decode< uint8_t >( data.data(), values.size( )))
+        BOOST_CHECK_EQUAL( value, 3.5f );
+}
+
+BOOST_AUTO_TEST_CASE( header_round_trip )
+{
+    const std::string filename = tempFile();
+    writeCache( filename, brayns::FE_UINT16 );
+
+    {
+        brayns::SimulationDescriptor descriptor;
+        BOOST_REQUIRE( descriptor.attachSimulationToCacheFile( filename ));
+        BOOST_CHECK_EQUAL( descriptor.getNbFrames(), NB_FRAMES );
+        BOOST_CHECK_EQUAL( descriptor.getFrameSize( 0 ), FRAME_SIZE );
+        BOOST_CHECK_EQUAL( descriptor.getFrameEncoding(), brayns::FE_UINT16 );
+        BOOST_CHECK_EQUAL( descriptor.getStartTime(), START_TIME );
+        BOOST_CHECK_EQUAL( descriptor.getTimestep(), TIMESTEP );
+        BOOST_CHECK_EQUAL( descriptor.getFrameBytes(),
+            brayns::SimulationDescriptor::getFrameBytes( FRAME_SIZE, brayns::FE_UINT16 ));
+
+        const auto& cells = descriptor.getCells();
+        BOOST_REQUIRE_EQUAL( cells.size(), CELLS.size( ));
+        for( size_t i = 0; i < cells.size(); ++i )
+        {
+            BOOST_CHECK_EQUAL( cells[i].gid, CELLS[i].gid );
+            BOOST_CHECK_EQUAL( cells[i].offset, CELLS[i].offset );
+            BOOST_CHECK_EQUAL( cells[i].size, CELLS[i].size );
+        }
+
+        // Frame values span 5 units, so a 16-bit level is below 1e-4
+        for( uint64_t frame = 0; frame < NB_FRAMES; ++frame )
+        {
+            const auto* data = static_cast< const uint8_t* >( descriptor.getFramePointer( frame ));
+            BOOST_REQUIRE( data );
+            const auto values = decode< uint16_t >( data, FRAME_SIZE );
+            for( uint64_t i = 0; i < FRAME_SIZE; ++i )
+                BOOST_CHECK_SMALL( values[i] - frameValue( frame, i ), 1e-3f );
+        }
+    }
+
+    boost::filesystem::remove( filename );
+}
+
+BOOST_AUTO_TEST_CASE( truncated_cache )
+{
+    const std::string filename = tempFile();
+    writeCache( filename, brayns::FE_FLOAT32 );
+    boost::filesystem::resize_file( filename, boost::filesystem::file_size( filename ) - 1 );
+
+    {
+        brayns::SimulationDescriptor descriptor;
+        BOOST_CHECK( !descriptor.attachSimulationToCacheFile( filename ));
+        BOOST_CHECK_EQUAL( descriptor.getNbFrames(), 0 );
+        BOOST_CHECK( descriptor.getCells().empty( ));
+    }
+
+    boost::filesystem::remove( filename );
+}
+
+BOOST_AUTO_TEST_CASE( save_subset )
+{
+    const std::string filename = tempFile();
+    const std::string subsetFilename = tempFile();
+    writeCache( filename, brayns::FE_FLOAT32 );
+
+    {
+        brayns::SimulationDescriptor descriptor;
+        BOOST_REQUIRE( descriptor.attachSimulationToCacheFile( filename ));
+
+        // Frames at times 2.5, 3 and 3.5, cells 10 and 30
+        BOOST_REQUIRE( descriptor.saveSubset( subsetFilename, 2.3f, 3.6f, { 10, 30 }));
+
+        brayns::SimulationDescriptor subset;
+        BOOST_REQUIRE( subset.attachSimulationToCacheFile( subsetFilename ));
+        BOOST_CHECK_EQUAL( subset.getNbFrames(), 3 );
+        BOOST_CHECK_EQUAL( subset.getFrameSize( 0 ), 3 );
+        BOOST_CHECK_EQUAL( subset.getFrameEncoding(), brayns::FE_FLOAT32 );
+        BOOST_CHECK_EQUAL( subset.getStartTime(), 2.5f );
+        BOOST_CHECK_EQUAL( subset.getTimestep(), TIMESTEP );
+
+        // Offsets are repacked in the order of the original cache
+        const auto& cells = subset.getCells();
+        BOOST_REQUIRE_EQUAL( cells.size(), 2 );
+        BOOST_CHECK_EQUAL( cells[0].gid, 10 );
+        BOOST_CHECK_EQUAL( cells[0].offset, 0 );
+        BOOST_CHECK_EQUAL( cells[0].size, 2 );
+        BOOST_CHECK_EQUAL( cells[1].gid, 30 );
+        BOOST_CHECK_EQUAL( cells[1].offset, 2 );
+        BOOST_CHECK_EQUAL( cells[1].size, 1 );
+
+        checkFrames( subset, 1, { CELLS[0], CELLS[2] });
+    }
+
+    boost::filesystem::remove( filename );
+    boost::filesystem::remove( subsetFilename );
+}
+
+BOOST_AUTO_TEST_CASE( save_time_window )
+{
+    const std::string filename = tempFile();
+    const std::string subsetFilename = tempFile();
+    writeCache( filename, brayns::FE_FLOAT32 );
+
+    {
+        brayns::SimulationDescriptor descriptor;
+        BOOST_REQUIRE( descriptor.attachSimulationToCacheFile( filename ));
+
+        // All cells, frames from time 3 to the end of the simulation
+        BOOST_REQUIRE( descriptor.saveSubset( subsetFilename, 3.f, 100.f,
+                                              std::set< uint32_t >( )));
+
+        brayns::SimulationDescriptor subset;
+        BOOST_REQUIRE( subset.attachSimulationToCacheFile( subsetFilename ));
+        BOOST_CHECK_EQUAL( subset.getNbFrames(), 3 );
+        BOOST_CHECK_EQUAL( subset.getFrameSize( 0 ), FRAME_SIZE );
+        BOOST_CHECK_EQUAL( subset.getStartTime(), 3.f );
+        BOOST_REQUIRE_EQUAL( subset.getCells().size(), CELLS.size( ));
+
+        checkFrames( subset, 2, CELLS );
+    }
+
+    boost::filesystem::remove( filename );
+    boost::filesystem::remove( subsetFilename );
+}
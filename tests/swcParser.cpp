@@ -0,0 +1,149 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ *
+ * This file is part of Brayns <https://github.com/BlueBrain/Brayns>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include <brayns/io/SWCParser.h>
+
+#define BOOST_TEST_MODULE swcParser
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+// Soma of 3 points, one dendrite branching into two, and one axon
+const std::string BRANCHING_MORPHOLOGY =
+    "# Synthetic morphology\n"
+    "1 1 0 0 0 1.0 -1\n"
+    "2 1 0 1 0 1.0 1\n"
+    "3 1 0 -1 0 1.0 1\n"
+    "4 3 2 0 0 0.5 1\n"
+    "5 3 4 0 0 0.5 4\n"
+    "6 3 4 3 0 0.25 5\n"
+    "7 3 7 3 0 0.25 6\n"
+    "8 3 4 -3 0 0.25 5\n"
+    "9 2 -2 0 0 0.5 1\n"
+    "10 2 -6 0 0 0.5 9\n";
+
+brayns::MorphologyDataPtr parse( const std::string& content )
+{
+    return brayns::SWCParser::parse( content.data(),
+                                     content.data() + content.size( ));
+}
+}
+
+BOOST_AUTO_TEST_CASE( parse_sections )
+{
+    const auto morphology = parse( BRANCHING_MORPHOLOGY );
+    const auto& sections = morphology->sections;
+    BOOST_REQUIRE_EQUAL( sections.size(), 5 );
+
+    // Soma contour, dendrite trunk, its two branches, and axon
+    BOOST_CHECK_EQUAL( sections[0].type, 1 );
+    BOOST_CHECK_EQUAL( sections[0].nbSamples, 3 );
+    BOOST_CHECK_EQUAL( sections[1].type, 3 );
+    BOOST_CHECK_EQUAL( sections[1].nbSamples, 2 );
+    BOOST_CHECK_EQUAL( sections[2].type, 3 );
+    BOOST_CHECK_EQUAL( sections[2].nbSamples, 3 );
+    BOOST_CHECK_EQUAL( sections[3].type, 3 );
+    BOOST_CHECK_EQUAL( sections[3].nbSamples, 2 );
+    BOOST_CHECK_EQUAL( sections[4].type, 2 );
+    BOOST_CHECK_EQUAL( sections[4].nbSamples, 2 );
+    BOOST_CHECK_EQUAL( morphology->samples.size(), 12 );
+    BOOST_CHECK_EQUAL( morphology->sampleDistancesToSoma.size(), 12 );
+
+    // Branches start with the last point of the trunk
+    const auto& samples = morphology->samples;
+    BOOST_CHECK_EQUAL( samples[sections[2].firstSample].x(), 4.f );
+    BOOST_CHECK_EQUAL( samples[sections[3].firstSample].x(), 4.f );
+    BOOST_CHECK_EQUAL( samples[sections[3].firstSample + 1].y(), -3.f );
+
+    // Diameters are stored in the samples
+    BOOST_CHECK_EQUAL( samples[sections[1].firstSample].w(), 1.f );
+}
+
+BOOST_AUTO_TEST_CASE( parse_distances )
+{
+    const auto morphology = parse( BRANCHING_MORPHOLOGY );
+    const auto& sections = morphology->sections;
+    const auto& distances = morphology->sampleDistancesToSoma;
+
+    BOOST_CHECK_CLOSE( sections[1].distanceToSoma, 0.f, 1e-4f );
+    BOOST_CHECK_CLOSE( distances[sections[1].firstSample + 1], 2.f, 1e-4f );
+    BOOST_CHECK_CLOSE( sections[2].distanceToSoma, 2.f, 1e-4f );
+    BOOST_CHECK_CLOSE( distances[sections[2].firstSample + 1], 3.f, 1e-4f );
+    BOOST_CHECK_CLOSE( distances[sections[2].firstSample + 2], 6.f, 1e-4f );
+    BOOST_CHECK_CLOSE( sections[4].distanceToSoma, 0.f, 1e-4f );
+    BOOST_CHECK_CLOSE( distances[sections[4].firstSample + 1], 4.f, 1e-4f );
+}
+
+BOOST_AUTO_TEST_CASE( parse_soma )
+{
+    const auto contour = parse( BRANCHING_MORPHOLOGY );
+    BOOST_CHECK_EQUAL( contour->somaCentroid.y(), 0.f );
+    BOOST_CHECK_CLOSE( contour->somaMeanRadius, 2.f / 3.f, 1e-4f );
+
+    const auto point = parse( "1 1 1 2 3 4.5 -1\n2 3 1 2 8 1 1\n" );
+    BOOST_CHECK_EQUAL( point->somaCentroid.z(), 3.f );
+    BOOST_CHECK_EQUAL( point->somaMeanRadius, 4.5f );
+    BOOST_CHECK_EQUAL( point->sections.size(), 1 );
+}
+
+BOOST_AUTO_TEST_CASE( parse_number_formats )
+{
+    const auto morphology = parse(
+        "  # Indented comment\r\n"
+        "\n"
+        "10\t1\t0\t0\t0\t1\t-1\r\n"
+        "20 3 +1.5e1 -.25 2.50E-1 0.5 10   # trailing comment\n"
+        "30 3 16 1 0 0.5 20" );
+    BOOST_REQUIRE_EQUAL( morphology->samples.size(), 2 );
+    const auto& sample = morphology->samples[0];
+    BOOST_CHECK_CLOSE( sample.x(), 15.f, 1e-4f );
+    BOOST_CHECK_CLOSE( sample.y(), -0.25f, 1e-4f );
+    BOOST_CHECK_CLOSE( sample.z(), 0.25f, 1e-4f );
+    BOOST_CHECK_CLOSE( morphology->samples[1].x(), 16.f, 1e-4f );
+}
+
+BOOST_AUTO_TEST_CASE( parse_invalid )
+{
+    BOOST_CHECK_THROW( parse( "1 1 0 0 0 1.0\n" ), std::runtime_error );
+    BOOST_CHECK_THROW( parse( "1 1 0 x 0 1.0 -1\n" ), std::runtime_error );
+    BOOST_CHECK_THROW( brayns::SWCParser::parseFile( "/nonexistent.swc" ),
+                       std::runtime_error );
+    BOOST_CHECK( parse( "# Empty\n" )->sections.empty( ));
+}
+
+BOOST_AUTO_TEST_CASE( parse_file )
+{
+    const boost::filesystem::path filename =
+        boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path( "%%%%-%%%%.swc" );
+    {
+        std::ofstream file( filename.string( ));
+        file << BRANCHING_MORPHOLOGY;
+    }
+    const auto morphology = brayns::SWCParser::parseFile( filename.string( ));
+    boost::filesystem::remove( filename );
+    BOOST_CHECK_EQUAL( morphology->sections.size(), 5 );
+    BOOST_CHECK_EQUAL( morphology->samples.size(), 12 );
+}